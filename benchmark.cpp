@@ -0,0 +1,364 @@
+#include "json/json.hpp"
+#include "import.h"
+#include "utils.h"
+#include "timetable.h"
+#include "performance.h"
+#include "counters.h"
+#include "genetic/fitness.h"
+#include "genetic/mutation.h"
+#include "genetic/crossover.h"
+
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+#include <limits>
+#include <random>
+#include <string>
+#include <vector>
+
+using json = nlohmann::json;
+
+/**
+ * A dataset to measure the kernels on: a directory with the four input files,
+ * with the students optionally replicated to make a larger synthetic problem.
+ */
+struct Dataset {
+    std::string directory;
+    int scale;
+};
+
+/**
+ * Parses "directory" or "directory:scale".
+ */
+static Dataset parse_dataset(const std::string& argument) {
+    Dataset dataset;
+    size_t colon = argument.rfind(':');
+    if (colon == std::string::npos) {
+        dataset.directory = argument;
+        dataset.scale = 1;
+    } else {
+        dataset.directory = argument.substr(0, colon);
+        dataset.scale = std::max(1, atoi(argument.substr(colon + 1).c_str()));
+    }
+    return dataset;
+}
+
+/**
+ * The student overlaps of the individual found the pairwise way, by intersecting the student sets of every two
+ * concurrent entries, which the fitness has to match.
+ */
+static int pairwise_student_overlaps(Timetable& timetable) {
+    int overlaps = 0;
+    std::vector<std::shared_ptr<TimetableEntry>>& entries = timetable.timetable_entries;
+    for (size_t a = 0; a < entries.size(); a++) {
+        for (size_t b = a + 1; b < entries.size(); b++) {
+            int overlapping_hours = entries[a]->overlapping_hours(entries[b]);
+            if (overlapping_hours > 0) {
+                overlaps += overlapping_hours * utils::count_overlaps(entries[a]->students, entries[b]->students);
+            }
+        }
+    }
+    return overlaps;
+}
+
+/**
+ * Adds scale - 1 copies of every student, with new IDs, taking the same subjects.
+ */
+static void scale_students(std::map<int, import::Student>& students, int scale) {
+    int max_id = 0;
+    for (auto& s : students) {
+        max_id = std::max(max_id, s.first);
+    }
+
+    std::map<int, import::Student> originals = students;
+    for (int copy = 1; copy < scale; copy++) {
+        for (auto& s : originals) {
+            long long id = s.first + (long long) copy * max_id;
+            if (id > std::numeric_limits<timetable_student_t>::max()) {
+                std::cerr << "Can't scale the students " << scale << " times, the IDs don't fit the student ID type. " << std::endl;
+                throw std::exception();
+            }
+
+            import::Student student = s.second;
+            student.id = (timetable_student_t) id;
+            students[(int) id] = student;
+        }
+    }
+}
+
+static json probe_to_json(PerformanceBenchmark& bench, int id) {
+    PerformanceBenchmark::ProbeSummary summary = bench.summarize(id);
+    json result;
+    result["count"] = summary.count;
+    result["min"] = summary.min;
+    result["avg"] = summary.avg;
+    result["max"] = summary.max;
+    result["p50"] = summary.p50;
+    result["p90"] = summary.p90;
+    result["p99"] = summary.p99;
+
+    PerformanceBenchmark::HardwareCounters hardware_counters = bench.get_probe_counters(id);
+    if (hardware_counters.measurements > 0) {
+        for (int event = 0; event < counters::EVENTS; event++) {
+            if (hardware_counters.is_available((counters::Event) event)) {
+                result[counters::event_name((counters::Event) event)] = 1.0 * hardware_counters.values[event] / hardware_counters.measurements;
+            }
+        }
+    }
+    return result;
+}
+
+/**
+ * Measures all kernels on a dataset. Every kernel is a probe of the benchmark.
+ */
+static json run_dataset(const Dataset& dataset, int iterations, int population_size, unsigned int seed, bool occupancy_index) {
+    PerformanceBenchmark bench;
+    PerformanceBenchmark::set_current(&bench);
+    if (counters::available() != 0) {
+        bench.enable_counters();
+    }
+
+    std::string professors_file = dataset.directory + "/professors.xml";
+    std::string classrooms_file = dataset.directory + "/classrooms.xml";
+    std::string students_file = dataset.directory + "/students.xml";
+    std::string subjects_file = dataset.directory + "/subjects.xml";
+
+    std::map<int, import::Professor> professors;
+    std::map<int, import::Classroom> classrooms;
+    std::map<int, import::Student> students;
+    std::map<int, import::Subject> subjects;
+
+    // the files are small, so the import is repeated less often than the kernels
+    static const int import_probe = PerformanceBenchmark::probe("XML import");
+    for (int i = 0; i < std::max(1, iterations / 20); i++) {
+        ScopedTimer timer(import_probe);
+        professors = import::Professor::import_professors(professors_file);
+        classrooms = import::Classroom::import_classrooms(classrooms_file);
+        students = import::Student::import_students(students_file);
+        subjects = import::Subject::import_subjects(subjects_file);
+    }
+    if (students.empty() || subjects.empty()) {
+        std::cerr << "Could not import the dataset in " << dataset.directory << ". " << std::endl;
+        throw std::exception();
+    }
+    scale_students(students, dataset.scale);
+
+    // the same setup as the genetic algorithm
+    utils::set_random_seed(seed);
+    std::vector<import::Subject> subject_list = utils::map_to_vector<std::map<int, import::Subject>, import::Subject>(subjects);
+    TimetableGenerator generator(professors, classrooms, students, subjects);
+    MutationCore mutation(EARLIEST_HOUR, LATEST_HOUR, 0, ActiveTimetableConfig::days - 1, subject_list);
+    CrossoverCore crossover(subject_list);
+    FitnessCore fitness(professors, classrooms, students, subjects);
+    mutation.set_subject_conflicts(fitness.get_subject_conflicts());
+    mutation.set_classrooms(classrooms);
+    if (occupancy_index) {
+        fitness.enable_occupancy_index();
+    }
+    std::mt19937 rand(seed);
+
+    std::vector<std::shared_ptr<Timetable>> population;
+    unsigned long entries = 0;
+    for (int i = 0; i < population_size; i++) {
+        population.push_back(generator.generate());
+        entries += population.back()->timetable_entries.size();
+    }
+
+    // sorted (and indexed) up front without a benchmark, so the sort's probe only measures the shuffled copies below
+    // and the operators measure their incremental index updates
+    PerformanceBenchmark::set_current(nullptr);
+    for (auto& individual : population) {
+        individual->sort();
+        if (occupancy_index) {
+            fitness.calculate_fitness(individual);
+        }
+    }
+
+    // the student overlaps of the fitness (partly read from the subject conflict matrix) are checked against
+    // the pairwise count, also on copies where a student of a lecture is replaced by one who doesn't take
+    // the subject, so the lecture's student count still equals the enrollment
+    int overlap_mismatches = 0;
+    for (auto& individual : population) {
+        std::shared_ptr<Timetable> copies[2] = {individual->clone(), individual->clone()};
+        for (auto& entry : copies[1]->timetable_entries) {
+            if (!entry->lectures || entry->students.empty()) {
+                continue;
+            }
+            for (auto& s : students) {
+                timetable_student_t id = (timetable_student_t) s.first;
+                if (entry->students.count(id) == 0) {
+                    entry->students.erase(entry->students.begin());
+                    entry->students.insert(id);
+                    break;
+                }
+            }
+            break;
+        }
+        for (auto& copy : copies) {
+            int expected = pairwise_student_overlaps(*copy);
+            int overlaps = fitness.calculate_fitness(copy).student_overlap;
+            if (overlaps != expected) {
+                std::cerr << "Student overlaps of the fitness (" << overlaps << ") differ from the pairwise count (" << expected << "). " << std::endl;
+                overlap_mismatches++;
+            }
+        }
+    }
+    PerformanceBenchmark::set_current(&bench);
+
+    // results are summed up so the compiler can't drop the calls
+    long long checksum = 0;
+
+    // measured by the kernel's own probe, the cached fitness of the previous evaluation is dropped first
+    for (int i = 0; i < iterations; i++) {
+        population[i % population_size]->fitness_terms = nullptr;
+        checksum += (long long) fitness.calculate_fitness(population[i % population_size]).fitness;
+    }
+
+    static const int clone_probe = PerformanceBenchmark::probe("Timetable clone");
+    for (int i = 0; i < iterations; i++) {
+        std::shared_ptr<Timetable> copy;
+        {
+            ScopedTimer timer(clone_probe);
+            copy = population[i % population_size]->clone();
+        }
+        checksum += copy->timetable_entries.size();
+    }
+
+    // sorted from a random order, measured by the sort's own probe
+    for (int i = 0; i < iterations; i++) {
+        std::shared_ptr<Timetable> copy = population[i % population_size]->clone();
+        std::shuffle(copy->timetable_entries.begin(), copy->timetable_entries.end(), rand);
+        copy->sorted = false;
+        copy->sort();
+        checksum += copy->timetable_entries.front()->subject;
+    }
+
+    for (int type = 0; type < MutationCore::MUTATION_TYPES; type++) {
+        int probe = PerformanceBenchmark::probe(std::string("Mutation: ") + MutationCore::mutation_name(type));
+        for (int i = 0; i < iterations; i++) {
+            std::shared_ptr<Timetable> result;
+            {
+                ScopedTimer timer(probe);
+                result = mutation.perform_mutation(population[i % population_size], type);
+            }
+            checksum += result->timetable_entries.size();
+        }
+    }
+
+    for (int type = 0; type < CrossoverCore::CROSSOVER_TYPES; type++) {
+        int probe = PerformanceBenchmark::probe(std::string("Crossover: ") + CrossoverCore::crossover_name(type));
+        for (int i = 0; i < iterations; i++) {
+            std::shared_ptr<Timetable> result;
+            {
+                ScopedTimer timer(probe);
+                result = crossover.perform_crossover(population[i % population_size], population[(i + 1) % population_size], type);
+            }
+            checksum += result->timetable_entries.size();
+        }
+    }
+
+    // one entry against all entries of the timetable with sorted set intersections, the pairwise way of finding
+    // student overlaps that the fitness replaced with student timelines
+    static const int overlaps_probe = PerformanceBenchmark::probe("Student overlaps of an entry");
+    for (int i = 0; i < iterations; i++) {
+        std::vector<std::shared_ptr<TimetableEntry>>& timetable_entries = population[i % population_size]->timetable_entries;
+        std::shared_ptr<TimetableEntry>& entry = timetable_entries[rand() % timetable_entries.size()];
+
+        ScopedTimer timer(overlaps_probe);
+        for (auto& other : timetable_entries) {
+            checksum += utils::count_overlaps(entry->students, other->students);
+        }
+    }
+
+    json kernels = json::object();
+    for (int id : bench.measured_probes()) {
+        kernels[PerformanceBenchmark::probe_name(id)] = probe_to_json(bench, id);
+    }
+
+    json result;
+    result["directory"] = dataset.directory;
+    result["scale"] = dataset.scale;
+    result["occupancy_index"] = occupancy_index;
+    result["students"] = students.size();
+    result["subjects"] = subjects.size();
+    result["entries_per_individual"] = 1.0 * entries / population_size;
+    result["checksum"] = checksum;
+    result["student_overlap_mismatches"] = overlap_mismatches;
+    result["kernels"] = kernels;
+
+    PerformanceBenchmark::set_current(nullptr);
+    return result;
+}
+
+/**
+ * Measures the genetic kernels on single threads, without MPI, and writes the results as JSON.
+ * Usage: benchmark [--iterations n] [--population n] [--seed n] [--counters] [--occupancy-index] [--output file] [directory[:scale] ...]
+ * The datasets default to the handcoded and autogenerated ones, the latter also with 4 times the students.
+ */
+int main(int argc, char **argv) {
+    int iterations = 200;
+    int population_size = 20;
+    unsigned int seed = 1;
+    bool use_counters = false;
+    bool occupancy_index = false;
+    std::string output;
+    std::vector<Dataset> datasets;
+
+    for (int i = 1; i < argc; i++) {
+        std::string argument(argv[i]);
+        bool has_value = i + 1 < argc;
+        if (argument == "--iterations" && has_value) {
+            iterations = std::max(1, atoi(argv[++i]));
+        } else if (argument == "--population" && has_value) {
+            population_size = std::max(2, atoi(argv[++i]));
+        } else if (argument == "--seed" && has_value) {
+            seed = (unsigned int) std::max(1, atoi(argv[++i]));
+        } else if (argument == "--counters") {
+            use_counters = true;
+        } else if (argument == "--occupancy-index") {
+            occupancy_index = true;
+        } else if (argument == "--output" && has_value) {
+            output = argv[++i];
+        } else {
+            datasets.push_back(parse_dataset(argument));
+        }
+    }
+    if (datasets.empty()) {
+        datasets.push_back(parse_dataset("../xml/handcoded"));
+        datasets.push_back(parse_dataset("../xml/autogenerated"));
+        datasets.push_back(parse_dataset("../xml/autogenerated:4"));
+    }
+
+    if (use_counters) {
+        std::string error;
+        if (!counters::open(error)) {
+            std::cerr << "Can't use hardware counters (" << error << "), continuing without them. " << std::endl;
+        }
+    }
+
+    json results = json::array();
+    for (Dataset& dataset : datasets) {
+        std::cerr << "Measuring " << dataset.directory << " (scale " << dataset.scale << "). " << std::endl;
+        results.push_back(run_dataset(dataset, iterations, population_size, seed, occupancy_index));
+    }
+
+    json report;
+    report["iterations"] = iterations;
+    report["population"] = population_size;
+    report["seed"] = seed;
+    report["datasets"] = results;
+
+    if (output.empty()) {
+        std::cout << report.dump(4) << std::endl;
+    } else {
+        std::ofstream out(output);
+        if (!out.is_open()) {
+            std::cerr << "Could not write the results to " << output << ". " << std::endl;
+            return 1;
+        }
+        out << report.dump(4) << std::endl;
+    }
+
+    counters::close();
+    return 0;
+}
@@ -0,0 +1,89 @@
+#include "checkpoint.h"
+
+#include <boost/archive/binary_oarchive.hpp>
+#include <boost/archive/binary_iarchive.hpp>
+
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <stdexcept>
+
+std::string Checkpoint::file_path(const std::string& directory, int rank) {
+    std::stringstream ss;
+    ss << directory << "/checkpoint_" << rank << ".bin";
+    return ss.str();
+}
+
+bool Checkpoint::is_writable(const std::string& directory, int rank) {
+    std::string path = file_path(directory, rank) + ".tmp";
+    bool writable;
+    {
+        std::ofstream out_file(path, std::ios::binary);
+        writable = out_file.is_open();
+    }
+    std::remove(path.c_str());
+    return writable;
+}
+
+bool Checkpoint::save(const std::string& path, PerformanceBenchmark& bench) {
+    std::string temporary_path = path + ".tmp";
+    {
+        std::ofstream out_file(temporary_path, std::ios::binary);
+        if (!out_file.is_open()) {
+            std::cerr << "Could not write the checkpoint " << temporary_path << ", keeping the previous one. " << std::endl;
+            return false;
+        }
+
+        try {
+            boost::archive::binary_oarchive oa(out_file);
+            oa << *this;
+            oa << bench;
+            out_file.flush();
+            if (!out_file) {
+                throw std::runtime_error("output stream error");
+            }
+        } catch (std::exception& e) {
+            std::cerr << "Could not write the checkpoint " << temporary_path << ": " << e.what() << ", keeping the previous one. " << std::endl;
+            out_file.close();
+            std::remove(temporary_path.c_str());
+            return false;
+        }
+    }
+
+    if (std::rename(temporary_path.c_str(), path.c_str()) != 0) {
+        std::cerr << "Could not replace the checkpoint " << path << ". " << std::endl;
+        std::remove(temporary_path.c_str());
+        return false;
+    }
+    return true;
+}
+
+bool Checkpoint::load(const std::string& path, PerformanceBenchmark& bench) {
+    std::ifstream in_file(path, std::ios::binary);
+    if (!in_file.is_open()) {
+        return false;
+    }
+
+    try {
+        boost::archive::binary_iarchive ia(in_file);
+        ia >> *this;
+        ia >> bench;
+    } catch (std::exception& e) {
+        std::cerr << "Could not read the checkpoint " << path << ": " << e.what() << std::endl;
+        return false;
+    }
+
+    return true;
+}
+
+std::string Checkpoint::get_random_state(std::mt19937& rand) {
+    std::stringstream ss;
+    ss << rand;
+    return ss.str();
+}
+
+void Checkpoint::set_random_state(std::mt19937& rand, const std::string& state) {
+    std::stringstream ss(state);
+    ss >> rand;
+}
@@ -0,0 +1,97 @@
+#ifndef INCLUDE_CHECKPOINT_H
+#define INCLUDE_CHECKPOINT_H
+
+#include "timetable.h"
+#include "performance.h"
+
+#include <boost/serialization/access.hpp>
+#include <boost/serialization/string.hpp>
+#include <boost/serialization/vector.hpp>
+#include <boost/serialization/shared_ptr.hpp>
+
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+
+/**
+ * The state of a single process between two generations, used to resume an interrupted run.
+ * Every process writes its own checkpoint file in the Boost binary archive format,
+ * together with its performance benchmark history.
+ */
+class Checkpoint {
+private:
+    friend class boost::serialization::access;
+
+    template<class Archive>
+    void serialize(Archive& ar, const unsigned int version) {
+        ar & this->round;
+        ar & this->processes;
+        ar & this->process_population_size;
+        ar & this->process_individual_start_index;
+        ar & this->max_process_population;
+        ar & this->window_processing_time_sum;
+        ar & this->first_feasible_round;
+        ar & this->first_feasible_time;
+        ar & this->elapsed_time;
+        ar & this->main_random_state;
+        ar & this->mutation_random_state;
+        ar & this->crossover_random_state;
+        ar & this->selection_random_state;
+        ar & this->population;
+    }
+
+public:
+    // the round the resumed run starts with
+    int round;
+    int processes;
+
+    // dynamic workload state
+    int process_population_size;
+    int process_individual_start_index;
+    int max_process_population;
+    double window_processing_time_sum;
+
+    int first_feasible_round;
+    double first_feasible_time;
+
+    // the elapsed time of the run when the checkpoint was written, the resumed run continues from it
+    double elapsed_time;
+
+    // random engine states, in their textual representation
+    std::string main_random_state;
+    std::string mutation_random_state;
+    std::string crossover_random_state;
+    std::string selection_random_state;
+
+    // the (not yet evaluated) population of the process
+    std::vector<std::shared_ptr<Timetable>> population;
+
+    /**
+     * The checkpoint file of a process.
+     */
+    static std::string file_path(const std::string& directory, int rank);
+
+    /**
+     * Whether the process can create its checkpoint file in the directory.
+     */
+    static bool is_writable(const std::string& directory, int rank);
+
+    /**
+     * Writes the checkpoint and the benchmark history. The previous checkpoint is replaced only once
+     * the new one has been completely written, so a failure while writing never loses the last checkpoint.
+     * Returns false (after printing a warning) if the checkpoint could not be written, the run can carry on.
+     */
+    bool save(const std::string& path, PerformanceBenchmark& bench);
+
+    /**
+     * Reads the checkpoint and restores the benchmark history (except the program start).
+     * Returns false if the file can't be read.
+     */
+    bool load(const std::string& path, PerformanceBenchmark& bench);
+
+    static std::string get_random_state(std::mt19937& rand);
+    static void set_random_state(std::mt19937& rand, const std::string& state);
+};
+
+#endif //INCLUDE_CHECKPOINT_H
@@ -0,0 +1,82 @@
+#include "communicator.h"
+
+// the phase communication is attributed to, per thread as every thread is a process in the threads-only build
+static thread_local int thread_phase = -1;
+
+comm::Phase::Phase(int phase) {
+    this->previous = thread_phase;
+    thread_phase = phase;
+}
+
+comm::Phase::~Phase() {
+    thread_phase = this->previous;
+}
+
+int comm::current_phase() {
+    if (thread_phase < 0) {
+        static const int other = PerformanceBenchmark::probe("Other communication");
+        return other;
+    }
+    return thread_phase;
+}
+
+void comm::record_traffic(const PerformanceBenchmark::Traffic& traffic) {
+    PerformanceBenchmark *bench = PerformanceBenchmark::current();
+    if (bench != nullptr) {
+        bench->record_traffic(current_phase(), traffic);
+    }
+}
+
+#if THREADS_ONLY
+
+#include <cstdlib>
+#include <iostream>
+
+ThreadGroup::ThreadGroup(int size) : size(size) {
+    this->waiting = 0;
+    this->barrier_generation = 0;
+    this->slots = std::vector<const void*>((unsigned long) size, nullptr);
+}
+
+void ThreadGroup::barrier() {
+    std::unique_lock<std::mutex> lock(this->mutex);
+    unsigned long generation = this->barrier_generation;
+
+    this->waiting++;
+    if (this->waiting == this->size) {
+        // the last one in releases everyone else
+        this->waiting = 0;
+        this->barrier_generation++;
+        this->condition.notify_all();
+    } else {
+        this->condition.wait(lock, [this, generation]() { return this->barrier_generation != generation; });
+    }
+}
+
+Communicator::Communicator(std::shared_ptr<ThreadGroup> group, int rank) {
+    this->group = group;
+    this->process_rank = rank;
+}
+
+int Communicator::rank() const {
+    return this->process_rank;
+}
+
+int Communicator::size() const {
+    return this->group->size;
+}
+
+void Communicator::barrier() const {
+    this->group->barrier();
+}
+
+void Communicator::abort(int errcode) const {
+    std::cerr << "Process " << this->process_rank << " aborted with code " << errcode << ". " << std::endl;
+    std::_Exit(errcode);
+}
+
+ThreadGroup& Communicator::shared() const {
+    return *this->group;
+}
+
+#endif
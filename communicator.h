@@ -0,0 +1,400 @@
+#ifndef INCLUDE_COMMUNICATOR_H
+#define INCLUDE_COMMUNICATOR_H
+
+// the threads-only build runs every process as a thread of a single program instead of an MPI process
+// it is selected by setting this as a compiler option (see the main_threads target in CMakeLists.txt)
+#ifndef THREADS_ONLY
+#define THREADS_ONLY 0
+#endif
+
+#if THREADS_ONLY
+#include <condition_variable>
+#include <mutex>
+#else
+#include <boost/mpi.hpp>
+#include <boost/mpi/communicator.hpp>
+#include <boost/mpi/collectives.hpp>
+#endif
+
+#include "performance.h"
+
+#include <cstdint>
+#include <memory>
+#include <type_traits>
+#include <vector>
+
+#if THREADS_ONLY
+
+/**
+ * The state shared between all threads of a threads-only run.
+ * Collectives exchange pointers to the participants' values through the slots, bracketed by barriers.
+ */
+class ThreadGroup {
+private:
+    std::mutex mutex;
+    std::condition_variable condition;
+    int waiting;
+    unsigned long barrier_generation;
+
+public:
+    const int size;
+
+    // one slot per rank, valid only between the barriers of a single collective
+    std::vector<const void*> slots;
+
+    ThreadGroup(int size);
+
+    /**
+     * Blocks until all threads of the group have called it.
+     */
+    void barrier();
+};
+
+/**
+ * A communicator between the threads of a ThreadGroup.
+ * Implements the subset of boost::mpi::communicator the program uses, so the same code runs on both.
+ */
+class Communicator {
+private:
+    std::shared_ptr<ThreadGroup> group;
+    int process_rank;
+
+public:
+    Communicator(std::shared_ptr<ThreadGroup> group, int rank);
+
+    int rank() const;
+    int size() const;
+    void barrier() const;
+
+    /**
+     * Terminates the whole program, like MPI_Abort terminates all processes.
+     */
+    void abort(int errcode) const;
+
+    ThreadGroup& shared() const;
+};
+
+#else
+
+typedef boost::mpi::communicator Communicator;
+
+#endif
+
+/**
+ * Collective operations, with the same semantics as their Boost.MPI counterparts.
+ * In the threads-only build values are copied directly from the root's (or each rank's) memory.
+ * Timetables are shared by pointer as they are never modified after their fitness has been computed.
+ * Every call is measured (and traced) as a probe of the calling thread's benchmark,
+ * and its duration is counted as time the process was blocked, whether waiting for the others or transferring.
+ * The traffic of every call is counted in the current communication phase of the thread.
+ * Types without an MPI datatype are packed here rather than by Boost.MPI, so the serialization can be measured.
+ */
+namespace comm {
+    /**
+     * Attributes the communication in its scope to a phase, named by a probe.
+     * Communication outside of any phase is attributed to "Other communication".
+     */
+    class Phase {
+    private:
+        int previous;
+
+    public:
+        explicit Phase(int phase);
+        ~Phase();
+
+        Phase(const Phase&) = delete;
+        Phase& operator=(const Phase&) = delete;
+    };
+
+    int current_phase();
+
+    /**
+     * Counts communication in the current phase of the calling thread's benchmark, if it has one.
+     */
+    void record_traffic(const PerformanceBenchmark::Traffic& traffic);
+
+#if THREADS_ONLY
+    /**
+     * Values are copied, so only the size of trivially copyable values is known.
+     */
+    template <typename T>
+    uint64_t copied_bytes(unsigned long values) {
+        return std::is_trivially_copyable<T>::value ? values * sizeof(T) : 0;
+    }
+
+    template <typename T>
+    void broadcast(const Communicator& comm, T& value, int root) {
+        static const int probe = PerformanceBenchmark::probe("Broadcast");
+        ScopedTimer timer(probe, true);
+
+        ThreadGroup& group = comm.shared();
+        if (comm.rank() == root) {
+            group.slots[root] = &value;
+        }
+        comm.barrier();
+        if (comm.rank() != root) {
+            value = *static_cast<const T*>(group.slots[root]);
+        }
+        comm.barrier();
+
+        PerformanceBenchmark::Traffic traffic;
+        traffic.messages = 1;
+        traffic.bytes = copied_bytes<T>(1);
+        record_traffic(traffic);
+    }
+
+    template <typename T>
+    void gather(const Communicator& comm, const T& in_value, std::vector<T>& out_values, int root) {
+        static const int probe = PerformanceBenchmark::probe("Gather");
+        ScopedTimer timer(probe, true);
+
+        ThreadGroup& group = comm.shared();
+        group.slots[comm.rank()] = &in_value;
+        comm.barrier();
+        if (comm.rank() == root) {
+            out_values.clear();
+            for (int r = 0; r < comm.size(); r++) {
+                out_values.push_back(*static_cast<const T*>(group.slots[r]));
+            }
+        }
+        comm.barrier();
+
+        PerformanceBenchmark::Traffic traffic;
+        traffic.messages = 1;
+        traffic.bytes = copied_bytes<T>(comm.rank() == root ? (unsigned long) comm.size() - 1 : 1);
+        record_traffic(traffic);
+    }
+
+    template <typename T>
+    void gather(const Communicator& comm, const T* in_values, int n, std::vector<T>& out_values, int root) {
+        static const int probe = PerformanceBenchmark::probe("Gather");
+        ScopedTimer timer(probe, true);
+
+        ThreadGroup& group = comm.shared();
+        group.slots[comm.rank()] = in_values;
+        comm.barrier();
+        if (comm.rank() == root) {
+            out_values.clear();
+            for (int r = 0; r < comm.size(); r++) {
+                const T* values = static_cast<const T*>(group.slots[r]);
+                out_values.insert(out_values.end(), values, values + n);
+            }
+        }
+        comm.barrier();
+
+        PerformanceBenchmark::Traffic traffic;
+        traffic.messages = 1;
+        traffic.bytes = copied_bytes<T>((unsigned long) n * (comm.rank() == root ? comm.size() - 1 : 1));
+        record_traffic(traffic);
+    }
+
+    /**
+     * Sends the value to the partner rank and receives its value, like MPI_Sendrecv, -1 for no partner.
+     * The partners must name each other. As values are copied between barriers here, every thread of the group has
+     * to call it, with or without a partner.
+     */
+    template <typename T>
+    void exchange(const Communicator& comm, const T& out_value, T& in_value, int partner) {
+        static const int probe = PerformanceBenchmark::probe("Exchange");
+        ScopedTimer timer(probe, true);
+
+        ThreadGroup& group = comm.shared();
+        group.slots[comm.rank()] = &out_value;
+        comm.barrier();
+        if (partner >= 0) {
+            in_value = *static_cast<const T*>(group.slots[partner]);
+        }
+        comm.barrier();
+
+        PerformanceBenchmark::Traffic traffic;
+        traffic.messages = partner >= 0 ? 1 : 0;
+        traffic.bytes = copied_bytes<T>(partner >= 0 ? 1 : 0);
+        record_traffic(traffic);
+    }
+#else
+    namespace detail {
+        inline uint64_t elapsed_nanoseconds(hirez_time_t start) {
+            return (uint64_t) std::chrono::duration_cast<std::chrono::nanoseconds>(hirez_clock_t::now() - start).count();
+        }
+
+        template <typename T>
+        void broadcast(const Communicator& comm, T& value, int root, PerformanceBenchmark::Traffic& traffic, boost::mpl::true_) {
+            boost::mpi::broadcast(comm, value, root);
+            traffic.messages = 1;
+            traffic.bytes = sizeof(T);
+        }
+
+        template <typename T>
+        void broadcast(const Communicator& comm, T& value, int root, PerformanceBenchmark::Traffic& traffic, boost::mpl::false_) {
+            // the archive's size and then its content, as Boost.MPI does
+            traffic.messages = 2;
+            if (comm.rank() == root) {
+                hirez_time_t start = hirez_clock_t::now();
+                boost::mpi::packed_oarchive oa(comm);
+                oa << value;
+                traffic.serialization_time = elapsed_nanoseconds(start);
+
+                boost::mpi::broadcast(comm, oa, root);
+                traffic.serialized_bytes = oa.size();
+            } else {
+                boost::mpi::packed_iarchive ia(comm);
+                boost::mpi::broadcast(comm, ia, root);
+                traffic.serialized_bytes = ia.size();
+
+                hirez_time_t start = hirez_clock_t::now();
+                ia >> value;
+                traffic.serialization_time = elapsed_nanoseconds(start);
+            }
+            traffic.bytes = traffic.serialized_bytes + sizeof(std::size_t);
+        }
+
+        template <typename T>
+        void gather(const Communicator& comm, const T* in_values, int n, std::vector<T>& out_values, int root,
+                    PerformanceBenchmark::Traffic& traffic, boost::mpl::true_) {
+            boost::mpi::gather(comm, in_values, n, out_values, root);
+            traffic.messages = 1;
+            traffic.bytes = (uint64_t) n * sizeof(T) * (comm.rank() == root ? comm.size() - 1 : 1);
+        }
+
+        template <typename T>
+        void gather(const Communicator& comm, const T* in_values, int n, std::vector<T>& out_values, int root,
+                    PerformanceBenchmark::Traffic& traffic, boost::mpl::false_) {
+            bool is_root = comm.rank() == root;
+
+            hirez_time_t start = hirez_clock_t::now();
+            boost::mpi::packed_oarchive oa(comm);
+            if (!is_root) {
+                for (int i = 0; i < n; i++) {
+                    oa << in_values[i];
+                }
+            }
+            traffic.serialization_time = elapsed_nanoseconds(start);
+
+            // the archives differ in size, so their sizes are gathered first
+            int size = (int) oa.size();
+            std::vector<int> sizes;
+            boost::mpi::gather(comm, size, sizes, root);
+
+            std::vector<int> offsets;
+            int total = 0;
+            if (is_root) {
+                for (int s : sizes) {
+                    offsets.push_back(total);
+                    total += s;
+                }
+            }
+            boost::mpi::packed_iarchive::buffer_type buffer((unsigned long) total);
+            BOOST_MPI_CHECK_RESULT(MPI_Gatherv,
+                                   (const_cast<void*>(oa.address()), size, MPI_PACKED,
+                                    buffer.data(), sizes.data(), offsets.data(), MPI_PACKED, root, MPI_Comm(comm)));
+            traffic.messages = 2;
+            traffic.serialized_bytes = is_root ? (uint64_t) total : (uint64_t) size;
+            traffic.bytes = traffic.serialized_bytes + sizeof(int) * (is_root ? comm.size() - 1 : 1);
+
+            if (is_root) {
+                start = hirez_clock_t::now();
+                out_values.clear();
+                out_values.reserve((unsigned long) n * comm.size());
+                for (int process = 0; process < comm.size(); process++) {
+                    if (process == root) {
+                        out_values.insert(out_values.end(), in_values, in_values + n);
+                        continue;
+                    }
+
+                    boost::mpi::packed_iarchive ia(comm, buffer, boost::archive::no_header, offsets[process]);
+                    for (int i = 0; i < n; i++) {
+                        T value;
+                        ia >> value;
+                        out_values.push_back(value);
+                    }
+                }
+                traffic.serialization_time += elapsed_nanoseconds(start);
+            }
+        }
+
+        template <typename T>
+        void exchange(const Communicator& comm, const T& out_value, T& in_value, int partner,
+                      PerformanceBenchmark::Traffic& traffic, boost::mpl::true_) {
+            comm.sendrecv(partner, 0, out_value, partner, 0, in_value);
+            traffic.messages = 1;
+            traffic.bytes = sizeof(T);
+        }
+
+        template <typename T>
+        void exchange(const Communicator& comm, const T& out_value, T& in_value, int partner,
+                      PerformanceBenchmark::Traffic& traffic, boost::mpl::false_) {
+            hirez_time_t start = hirez_clock_t::now();
+            boost::mpi::packed_oarchive oa(comm);
+            oa << out_value;
+            traffic.serialization_time = elapsed_nanoseconds(start);
+
+            // the archive's size and then its content
+            int size = (int) oa.size();
+            int in_size;
+            comm.sendrecv(partner, 0, size, partner, 0, in_size);
+            boost::mpi::packed_iarchive::buffer_type buffer((unsigned long) in_size);
+            BOOST_MPI_CHECK_RESULT(MPI_Sendrecv,
+                                   (const_cast<void*>(oa.address()), size, MPI_PACKED, partner, 0,
+                                    buffer.data(), in_size, MPI_PACKED, partner, 0, MPI_Comm(comm), MPI_STATUS_IGNORE));
+            traffic.messages = 2;
+            traffic.serialized_bytes = (uint64_t) size;
+            traffic.bytes = traffic.serialized_bytes + sizeof(int);
+
+            start = hirez_clock_t::now();
+            boost::mpi::packed_iarchive ia(comm, buffer, boost::archive::no_header, 0);
+            ia >> in_value;
+            traffic.serialization_time += elapsed_nanoseconds(start);
+        }
+    }
+
+    template <typename T>
+    void broadcast(const Communicator& comm, T& value, int root) {
+        static const int probe = PerformanceBenchmark::probe("Broadcast");
+        ScopedTimer timer(probe, true);
+
+        PerformanceBenchmark::Traffic traffic;
+        detail::broadcast(comm, value, root, traffic, boost::mpi::is_mpi_datatype<T>());
+        record_traffic(traffic);
+    }
+
+    template <typename T>
+    void gather(const Communicator& comm, const T& in_value, std::vector<T>& out_values, int root) {
+        static const int probe = PerformanceBenchmark::probe("Gather");
+        ScopedTimer timer(probe, true);
+
+        PerformanceBenchmark::Traffic traffic;
+        detail::gather(comm, &in_value, 1, out_values, root, traffic, boost::mpi::is_mpi_datatype<T>());
+        record_traffic(traffic);
+    }
+
+    template <typename T>
+    void gather(const Communicator& comm, const T* in_values, int n, std::vector<T>& out_values, int root) {
+        static const int probe = PerformanceBenchmark::probe("Gather");
+        ScopedTimer timer(probe, true);
+
+        PerformanceBenchmark::Traffic traffic;
+        detail::gather(comm, in_values, n, out_values, root, traffic, boost::mpi::is_mpi_datatype<T>());
+        record_traffic(traffic);
+    }
+
+    /**
+     * Sends the value to the partner rank and receives its value, like MPI_Sendrecv, -1 for no partner.
+     * The partners must name each other, ranks without a partner may skip the call (unlike the threads-only build).
+     */
+    template <typename T>
+    void exchange(const Communicator& comm, const T& out_value, T& in_value, int partner) {
+        if (partner < 0) {
+            return;
+        }
+
+        static const int probe = PerformanceBenchmark::probe("Exchange");
+        ScopedTimer timer(probe, true);
+
+        PerformanceBenchmark::Traffic traffic;
+        detail::exchange(comm, out_value, in_value, partner, traffic, boost::mpi::is_mpi_datatype<T>());
+        record_traffic(traffic);
+    }
+#endif
+}
+
+#endif //INCLUDE_COMMUNICATOR_H
@@ -0,0 +1,126 @@
+#include "counters.h"
+
+#include <cerrno>
+#include <cstring>
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+// the descriptors of the calling thread's counters, -1 for the ones that aren't open
+static thread_local int descriptors[counters::EVENTS] = {-1, -1, -1, -1, -1};
+
+const char* counters::event_name(Event event) {
+    switch (event) {
+        case CYCLES:
+            return "cycles";
+        case INSTRUCTIONS:
+            return "instructions";
+        case L1D_MISSES:
+            return "l1d_misses";
+        case LLC_MISSES:
+            return "llc_misses";
+        case BRANCH_MISSES:
+            return "branch_misses";
+        default:
+            return "unknown";
+    }
+}
+
+#ifdef __linux__
+
+static int open_event(uint32_t type, uint64_t config) {
+    struct perf_event_attr attr;
+    memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.type = type;
+    attr.config = config;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    // the times are used to scale the values if the counters are multiplexed
+    attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+
+    // the calling thread, on any CPU
+    return (int) syscall(__NR_perf_event_open, &attr, 0, -1, -1, 0);
+}
+
+bool counters::open(std::string& error) {
+    close();
+
+    const uint64_t l1d_read_misses = PERF_COUNT_HW_CACHE_L1D
+                                     | (PERF_COUNT_HW_CACHE_OP_READ << 8)
+                                     | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+
+    // the events are opened on their own rather than as a group, so a missing one doesn't disable the others
+    descriptors[CYCLES] = open_event(PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES);
+    descriptors[INSTRUCTIONS] = open_event(PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS);
+    descriptors[L1D_MISSES] = open_event(PERF_TYPE_HW_CACHE, l1d_read_misses);
+    descriptors[LLC_MISSES] = open_event(PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES);
+    descriptors[BRANCH_MISSES] = open_event(PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES);
+
+    if (available() == 0) {
+        error = std::strerror(errno);
+        return false;
+    }
+    return true;
+}
+
+void counters::close() {
+    for (int& fd : descriptors) {
+        if (fd >= 0) {
+            ::close(fd);
+            fd = -1;
+        }
+    }
+}
+
+bool counters::read(Reading& reading) {
+    bool any = false;
+    for (int event = 0; event < EVENTS; event++) {
+        reading.values[event] = 0;
+        if (descriptors[event] < 0) {
+            continue;
+        }
+
+        // the value, the time the event was enabled and the time it was actually counted
+        uint64_t data[3];
+        if (::read(descriptors[event], data, sizeof(data)) != (ssize_t) sizeof(data)) {
+            continue;
+        }
+        if (data[2] > 0 && data[2] < data[1]) {
+            reading.values[event] = (uint64_t) ((double) data[0] * data[1] / data[2]);
+        } else {
+            reading.values[event] = data[0];
+        }
+        any = true;
+    }
+    return any;
+}
+
+#else
+
+bool counters::open(std::string& error) {
+    error = "perf_event_open is only available on Linux";
+    return false;
+}
+
+void counters::close() {
+}
+
+bool counters::read(Reading& reading) {
+    return false;
+}
+
+#endif
+
+unsigned int counters::available() {
+    unsigned int mask = 0;
+    for (int event = 0; event < EVENTS; event++) {
+        if (descriptors[event] >= 0) {
+            mask |= 1u << event;
+        }
+    }
+    return mask;
+}
@@ -0,0 +1,51 @@
+#ifndef INCLUDE_COUNTERS_H
+#define INCLUDE_COUNTERS_H
+
+#include <cstdint>
+#include <string>
+
+/**
+ * Hardware performance counters of the calling thread, read with perf_event_open on Linux.
+ * Counters are opened per thread, as every process is a thread in the threads-only build, and only count user space.
+ * Events the kernel or the hardware doesn't provide (e.g. in virtual machines or with a restrictive
+ * perf_event_paranoid setting) are unavailable, and if none is available reading the counters fails.
+ */
+namespace counters {
+    enum Event {
+        CYCLES = 0,
+        INSTRUCTIONS = 1,
+        L1D_MISSES = 2,
+        LLC_MISSES = 3,
+        BRANCH_MISSES = 4,
+        EVENTS = 5
+    };
+
+    const char* event_name(Event event);
+
+    /**
+     * The values of the counters at some point, scaled up if the kernel had to multiplex them.
+     */
+    struct Reading {
+        uint64_t values[EVENTS];
+    };
+
+    /**
+     * Opens the counters of the calling thread.
+     * Returns false and describes the reason if none is available.
+     */
+    bool open(std::string& error);
+
+    void close();
+
+    /**
+     * Gets a bit mask (by event) of the counters the calling thread has open.
+     */
+    unsigned int available();
+
+    /**
+     * Reads the counters of the calling thread, false if none is open.
+     */
+    bool read(Reading& reading);
+}
+
+#endif //INCLUDE_COUNTERS_H
@@ -1,6 +1,6 @@
 #include "custom_mpi.h"
 
-void custom_all_gather(boost::mpi::communicator& comm,
+void custom_all_gather(Communicator& comm,
                        std::vector<std::shared_ptr<Timetable>>& input_values,
                        std::vector<std::shared_ptr<Timetable>>& destination_values) {
     int rank = comm.rank();
@@ -13,7 +13,7 @@ void custom_all_gather(boost::mpi::communicator& comm,
             transfer_buffer.insert(transfer_buffer.end(), input_values.begin(), input_values.end());
         }
 
-        boost::mpi::broadcast(comm, transfer_buffer, i);
+        comm::broadcast(comm, transfer_buffer, i);
         destination_values.insert(destination_values.end(), transfer_buffer.begin(), transfer_buffer.end());
     }
 }
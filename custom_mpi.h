@@ -2,14 +2,14 @@
 #define INCLUDE_CUSTOM_MPI_H
 
 #include "timetable.h"
-#include <boost/mpi.hpp>
+#include "communicator.h"
 #include <vector>
 
 /**
  * A custom implementation of the Boost MPI_Allgather function.
  * Makes everyone have all data, regardless of the input sizes - even different across processors.
  */
-void custom_all_gather(boost::mpi::communicator& comm,
+void custom_all_gather(Communicator& comm,
                        std::vector<std::shared_ptr<Timetable>>& input_values,
                        std::vector<std::shared_ptr<Timetable>>& destination_values);
 
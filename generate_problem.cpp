@@ -0,0 +1,89 @@
+#include "problem_generator.h"
+
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+
+static void print_usage() {
+    std::cerr << "Usage: generate_problem [--students n] [--subjects n] [--classrooms n] [--subjects-per-student n] "
+              << "[--assistants n] [--assistants-per-subject n] [--assistant-hours n] [--tutorial-size n] "
+              << "[--overlap-density x] [--capacity-tightness x] [--seed n] [--xml directory] [--binary file]" << std::endl;
+}
+
+/**
+ * Generates a synthetic problem (see ProblemGenerator) and writes it as the four XML input files, in the binary
+ * format (see the problem_file setting) or both. The same parameters and seed always give the same problem.
+ */
+int main(int argc, char **argv) {
+    ProblemParameters parameters;
+    std::string xml_directory;
+    std::string binary_file;
+
+    for (int i = 1; i < argc; i++) {
+        std::string argument(argv[i]);
+        if (i + 1 >= argc) {
+            print_usage();
+            return 1;
+        }
+        const char *value = argv[++i];
+
+        if (argument == "--students") {
+            parameters.students = atoi(value);
+        } else if (argument == "--subjects") {
+            parameters.subjects = atoi(value);
+        } else if (argument == "--classrooms") {
+            parameters.classrooms = atoi(value);
+        } else if (argument == "--subjects-per-student") {
+            parameters.subjects_per_student = atoi(value);
+        } else if (argument == "--assistants") {
+            parameters.assistants = atoi(value);
+        } else if (argument == "--assistants-per-subject") {
+            parameters.assistants_per_subject = atoi(value);
+        } else if (argument == "--assistant-hours") {
+            parameters.assistant_hours = atoi(value);
+        } else if (argument == "--tutorial-size") {
+            parameters.tutorial_size = atoi(value);
+        } else if (argument == "--overlap-density") {
+            parameters.overlap_density = atof(value);
+        } else if (argument == "--capacity-tightness") {
+            parameters.capacity_tightness = atof(value);
+        } else if (argument == "--seed") {
+            parameters.seed = (unsigned int) atol(value);
+        } else if (argument == "--xml") {
+            xml_directory = value;
+        } else if (argument == "--binary") {
+            binary_file = value;
+        } else {
+            print_usage();
+            return 1;
+        }
+    }
+    if (xml_directory.empty() && binary_file.empty()) {
+        print_usage();
+        return 1;
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    import::Problem problem;
+    try {
+        ProblemGenerator generator(parameters);
+        problem = generator.generate();
+
+        if (!xml_directory.empty()) {
+            problem.export_xml(xml_directory);
+        }
+        if (!binary_file.empty()) {
+            problem.export_binary(binary_file);
+        }
+    } catch (std::exception& e) {
+        // the reason has already been printed
+        return 1;
+    }
+
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    std::cerr << "Generated " << problem.students.size() << " students, " << problem.subjects.size() << " subjects, "
+              << problem.classrooms.size() << " classrooms and " << problem.professors.size()
+              << " professors and TAs in " << seconds << " s. " << std::endl;
+    return 0;
+}
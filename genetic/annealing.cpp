@@ -0,0 +1,140 @@
+#include "annealing.h"
+#include "../performance.h"
+
+#include <algorithm>
+#include <cmath>
+
+// the soft constraints of a candidate are skipped if its additional hard violations alone make its acceptance
+// less likely than exp(-ACCEPTANCE_EXPONENT_LIMIT)
+static const double ACCEPTANCE_EXPONENT_LIMIT = 20;
+
+SimulatedAnnealing::SimulatedAnnealing(MutationCore& mutation, std::shared_ptr<FitnessCore>& fitness_core,
+                                       const Schedule& schedule) : mutation(mutation) {
+    this->fitness_core = fitness_core;
+    this->schedule = schedule;
+    this->zero_one_distribution = std::uniform_real_distribution<double>(0, 1);
+}
+
+const SimulatedAnnealing::Counts& SimulatedAnnealing::get_counts() const {
+    return this->counts;
+}
+
+SimulatedAnnealing::placement_t SimulatedAnnealing::placement_of(const TimetableEntry& entry) {
+    return std::make_tuple((int) entry.subject, entry.lectures, (int) entry.day, (int) entry.hour, (int) entry.classroom);
+}
+
+bool SimulatedAnnealing::is_tabu(const placement_t& placement) const {
+    return std::find(this->tabu_placements.begin(), this->tabu_placements.end(), placement) != this->tabu_placements.end();
+}
+
+void SimulatedAnnealing::update_best() {
+    if (!(this->best_fitness < this->current_fitness)) {
+        return;
+    }
+
+    this->best = this->current;
+    this->best_fitness = this->current_fitness;
+    this->counts.improvements++;
+    if (this->counts.first_feasible_iteration == -1 && this->best_fitness.hard_violations() == 0) {
+        this->counts.first_feasible_iteration = (int) this->counts.moves;
+        this->counts.first_feasible_time = std::chrono::duration<double>(std::chrono::steady_clock::now() - this->start_time).count();
+    }
+}
+
+void SimulatedAnnealing::start(std::shared_ptr<Timetable>& individual) {
+    this->counts = Counts();
+    this->tabu_placements.clear();
+    this->start_time = std::chrono::steady_clock::now();
+
+    this->current = individual;
+    this->current_fitness = this->fitness_core->calculate_fitness(individual);
+    this->best = this->current;
+    this->best_fitness = this->current_fitness;
+    if (this->best_fitness.hard_violations() == 0) {
+        this->counts.first_feasible_iteration = 0;
+        this->counts.first_feasible_time = 0;
+    }
+}
+
+void SimulatedAnnealing::move(double temperature) {
+    std::mt19937& rand = this->mutation.get_random_engine();
+    int entry_index;
+    std::shared_ptr<Timetable> candidate = this->mutation.perform_mutation(this->current, this->mutation.random_mutation_type(), entry_index);
+    placement_t previous_placement = placement_of(*this->current->timetable_entries[entry_index]);
+    placement_t new_placement = placement_of(*candidate->timetable_entries[entry_index]);
+    this->counts.moves++;
+
+    int hard_allowance = (int) std::min(1e6, temperature * ACCEPTANCE_EXPONENT_LIMIT / -PROHIBITIVE_SCORE);
+    fitness_t candidate_fitness = this->fitness_core->calculate_fitness(candidate, this->current_fitness.hard_violations() + hard_allowance);
+    if (!candidate_fitness.complete) {
+        return;
+    }
+
+    // a tabu move is only allowed if it leads to a new best individual (aspiration)
+    if (new_placement != previous_placement && is_tabu(new_placement) && !(this->best_fitness < candidate_fitness)) {
+        this->counts.tabu_rejected++;
+        return;
+    }
+
+    double delta = candidate_fitness.fitness - this->current_fitness.fitness;
+    if (delta < 0 && (temperature <= 0 || this->zero_one_distribution(rand) >= std::exp(delta / temperature))) {
+        return;
+    }
+
+    this->current = candidate;
+    this->current_fitness = candidate_fitness;
+    this->counts.accepted++;
+    if (this->schedule.tabu_tenure > 0 && new_placement != previous_placement) {
+        this->tabu_placements.push_back(previous_placement);
+        if ((int) this->tabu_placements.size() > this->schedule.tabu_tenure) {
+            this->tabu_placements.pop_front();
+        }
+    }
+    update_best();
+}
+
+void SimulatedAnnealing::advance(int moves, double temperature) {
+    static const int probe = PerformanceBenchmark::probe("Simulated annealing", false);
+    ScopedTimer timer(probe);
+
+    for (int i = 0; i < moves; i++) {
+        move(temperature);
+    }
+}
+
+std::shared_ptr<Timetable> SimulatedAnnealing::run(std::shared_ptr<Timetable>& start) {
+    static const int probe = PerformanceBenchmark::probe("Simulated annealing", false);
+    ScopedTimer timer(probe);
+
+    this->start(start);
+
+    double cooling = this->schedule.iterations > 0 && this->schedule.initial_temperature > 0
+                   ? std::pow(this->schedule.final_temperature / this->schedule.initial_temperature, 1.0 / this->schedule.iterations)
+                   : 1;
+    double temperature = this->schedule.initial_temperature;
+    for (int i = 0; i < this->schedule.iterations; i++, temperature *= cooling) {
+        move(temperature);
+    }
+
+    return this->best;
+}
+
+std::shared_ptr<Timetable>& SimulatedAnnealing::get_current() {
+    return this->current;
+}
+
+const fitness_t& SimulatedAnnealing::get_current_fitness() const {
+    return this->current_fitness;
+}
+
+void SimulatedAnnealing::replace_current(std::shared_ptr<Timetable>& individual) {
+    // the tabu placements were left by the previous state
+    this->tabu_placements.clear();
+    this->current = individual;
+    this->current_fitness = this->fitness_core->calculate_fitness(individual);
+    update_best();
+}
+
+std::shared_ptr<Timetable>& SimulatedAnnealing::get_best() {
+    return this->best;
+}
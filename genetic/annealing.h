@@ -0,0 +1,112 @@
+#ifndef INCLUDE_ANNEALING_H
+#define INCLUDE_ANNEALING_H
+
+#include "../timetable.h"
+#include "fitness.h"
+#include "mutation.h"
+
+#include <chrono>
+#include <deque>
+#include <memory>
+#include <random>
+#include <tuple>
+
+/**
+ * A single-trajectory alternative to the genetic algorithm: a simulated annealing chain over the mutation moves
+ * (picked by the mutation weights), with an optional tabu list.
+ * Every move is a mutation of the current individual, evaluated incrementally like the moves of the local search
+ * (occupancy index and cached local fitness terms). A move is accepted if it doesn't decrease the fitness,
+ * otherwise with the probability exp(delta / temperature), where the temperature falls geometrically from the initial
+ * to the final one over the iterations. As hard violations are penalized by the prohibitive score, a move that adds
+ * them is only accepted while the temperature is of that magnitude, the soft constraints of candidates that
+ * couldn't be accepted anyway are not evaluated.
+ * With a tabu tenure, moving a block back to a placement (day, hour and classroom) it left in the last tenure
+ * accepted moves is rejected, unless the move improves on the best individual of the chain.
+ * The chain can also be advanced at a fixed temperature and its state replaced, for parallel tempering.
+ * The random state is the mutation's.
+ */
+class SimulatedAnnealing {
+public:
+    struct Schedule {
+        int iterations;
+        double initial_temperature;
+        double final_temperature;
+        int tabu_tenure; // 0 to disable the tabu list
+    };
+
+    struct Counts {
+        long moves = 0;
+        long accepted = 0;
+        long tabu_rejected = 0;
+        long improvements = 0; // of the best individual of the chain
+        int first_feasible_iteration = -1;
+        double first_feasible_time = -1; // seconds since the start of the chain
+    };
+
+private:
+    MutationCore& mutation;
+    std::shared_ptr<FitnessCore> fitness_core;
+    Schedule schedule;
+    std::uniform_real_distribution<double> zero_one_distribution;
+    Counts counts;
+    std::chrono::steady_clock::time_point start_time;
+
+    std::shared_ptr<Timetable> current;
+    fitness_t current_fitness;
+    std::shared_ptr<Timetable> best;
+    fitness_t best_fitness;
+
+    // as <subject, lectures, day, hour, classroom>, the most recent at the back
+    typedef std::tuple<int, bool, int, int, int> placement_t;
+    std::deque<placement_t> tabu_placements;
+
+    static placement_t placement_of(const TimetableEntry& entry);
+
+    bool is_tabu(const placement_t& placement) const;
+
+    void update_best();
+
+    /**
+     * Tries a single move at the temperature.
+     */
+    void move(double temperature);
+
+public:
+    SimulatedAnnealing(MutationCore& mutation, std::shared_ptr<FitnessCore>& fitness_core, const Schedule& schedule);
+
+    /**
+     * Runs the chain from the individual and returns the best individual it found.
+     * Like the other operators, this doesn't change the individual.
+     */
+    std::shared_ptr<Timetable> run(std::shared_ptr<Timetable>& start);
+
+    /**
+     * Starts a chain from the individual, without moving.
+     */
+    void start(std::shared_ptr<Timetable>& individual);
+
+    /**
+     * Continues the chain started by start with the given number of moves at a fixed temperature.
+     */
+    void advance(int moves, double temperature);
+
+    std::shared_ptr<Timetable>& get_current();
+    const fitness_t& get_current_fitness() const;
+
+    /**
+     * Continues the chain from another individual, e.g. the state of another chain. Clears the tabu list.
+     */
+    void replace_current(std::shared_ptr<Timetable>& individual);
+
+    /**
+     * The best individual since the chain was started.
+     */
+    std::shared_ptr<Timetable>& get_best();
+
+    /**
+     * The counts since the chain was started.
+     */
+    const Counts& get_counts() const;
+};
+
+#endif //INCLUDE_ANNEALING_H
@@ -1,19 +1,56 @@
 #include "crossover.h"
 #include "../utils.h"
+#include "../performance.h"
+
+#include <iostream>
 
 CrossoverCore::CrossoverCore(std::vector<import::Subject>& imported_subjects) {
-    this->imported_subjects = std::shared_ptr<std::vector<import::Subject>>(&imported_subjects);
+    this->imported_subjects = std::shared_ptr<std::vector<import::Subject>>(new std::vector<import::Subject>(imported_subjects));
 
     this->rand = std::mt19937(utils::get_random_seed());
-    this->mutation_point_distribution = std::uniform_int_distribution<int>(0, 3);
+    this->mutation_point_distribution = std::uniform_int_distribution<int>(0, CROSSOVER_TYPES - 1);
     this->zero_one_distribution = std::uniform_real_distribution<double>(0, 1);
 }
 
+std::mt19937& CrossoverCore::get_random_engine() {
+    return this->rand;
+}
+
+const int CrossoverCore::CROSSOVER_TYPES;
+
+const char* CrossoverCore::crossover_name(int crossover_type) {
+    static const char* names[CROSSOVER_TYPES] = {
+            "whole subjects", "students", "TAs", "classrooms"
+    };
+    return crossover_type >= 0 && crossover_type < CROSSOVER_TYPES ? names[crossover_type] : "unknown";
+}
+
 std::shared_ptr<Timetable> CrossoverCore::perform_crossover(std::shared_ptr<Timetable>& left,
                                                             std::shared_ptr<Timetable>& right) {
+    return perform_crossover(left, right, mutation_point_distribution(rand));
+}
+
+std::shared_ptr<Timetable> CrossoverCore::perform_crossover(std::shared_ptr<Timetable>& left,
+                                                            std::shared_ptr<Timetable>& right, int crossover_type) {
+    static const int probe = PerformanceBenchmark::probe("Crossover", false);
+    ScopedTimer timer(probe);
+
     std::shared_ptr<Timetable> result(new Timetable());
 
-    int crossover_type = mutation_point_distribution(rand);
+    // the index of an indexed left parent is updated for every subject that isn't placed like in the left parent
+    if (left->occupancy != nullptr) {
+        result->occupancy = std::shared_ptr<OccupancyIndex>(new OccupancyIndex(*left->occupancy));
+    }
+
+    // the local fitness terms of the subjects that are copied from an evaluated parent unchanged are taken with them
+    std::shared_ptr<FitnessTerms> left_terms = left->fitness_terms;
+    std::shared_ptr<FitnessTerms> right_terms = right->fitness_terms;
+    if (left_terms != nullptr || right_terms != nullptr) {
+        size_t subject_slots = (left_terms != nullptr ? left_terms : right_terms)->subject_terms.size();
+        result->fitness_terms = std::shared_ptr<FitnessTerms>(new FitnessTerms(subject_slots));
+    }
+    bool all_from_left = true;
+    bool all_from_right = true;
 
     // shared preprocessing
     switch (crossover_type) {
@@ -49,6 +86,10 @@ std::shared_ptr<Timetable> CrossoverCore::perform_crossover(std::shared_ptr<Time
             std::cerr << "subject id mismatch (current " << current_subject << " vs imported " << (*this->imported_subjects)[i].id << " vs right " << (*right_global_it)->subject << ")" << std::endl;
         }
 
+        std::vector<std::shared_ptr<TimetableEntry>>::iterator left_subject_begin = left_global_it;
+        std::vector<std::shared_ptr<TimetableEntry>>::iterator right_subject_begin = right_global_it;
+        size_t result_subject_begin = result->timetable_entries.size();
+
         switch (crossover_type) {
             case 0: { // combine subjects as a whole
                 if (pick_left) {
@@ -99,7 +140,7 @@ std::shared_ptr<Timetable> CrossoverCore::perform_crossover(std::shared_ptr<Time
 
                             // this is what changes depending on the crossover type
                             if (crossover_type == 1) {
-                                clone->students = std::set<timetable_student_t>((*right_segment_it)->students);
+                                clone->students = timetable_student_set_t((*right_segment_it)->students);
                             } else if (crossover_type == 2) {
                                 clone->professors = std::set<timetable_professor_t>((*right_segment_it)->professors);
                             } else if (crossover_type == 3) {
@@ -114,7 +155,7 @@ std::shared_ptr<Timetable> CrossoverCore::perform_crossover(std::shared_ptr<Time
 
                             // this is what changes depending on the crossover type
                             if (crossover_type == 1) {
-                                clone->students = std::set<timetable_student_t>((*left_segment_it)->students);
+                                clone->students = timetable_student_set_t((*left_segment_it)->students);
                             } else if (crossover_type == 2) {
                                 clone->professors = std::set<timetable_professor_t>((*left_segment_it)->professors);
                             } else if (crossover_type == 3) {
@@ -142,6 +183,49 @@ std::shared_ptr<Timetable> CrossoverCore::perform_crossover(std::shared_ptr<Time
             default:
                 break;
         }
+
+        // subjects as a whole, or from one side if the segments couldn't be aligned
+        bool same_segment_lengths = left_global_it - left_subject_begin == right_global_it - right_subject_begin;
+        bool copied_whole = crossover_type == 0 || !same_segment_lengths;
+        all_from_left = all_from_left && copied_whole && pick_left;
+        all_from_right = all_from_right && copied_whole && !pick_left;
+
+        if (result->fitness_terms != nullptr && copied_whole && current_subject >= 0
+                && (size_t) current_subject < result->fitness_terms->subject_terms.size()) {
+            std::shared_ptr<FitnessTerms>& parent_terms = pick_left ? left_terms : right_terms;
+            if (parent_terms != nullptr && parent_terms->subject_terms.size() == result->fitness_terms->subject_terms.size()
+                    && parent_terms->known_subjects[current_subject]) {
+                result->fitness_terms->subject_terms[current_subject] = parent_terms->subject_terms[current_subject];
+                result->fitness_terms->known_subjects[current_subject] = true;
+            }
+        }
+
+        if (result->occupancy != nullptr) {
+            // the left subject was taken as it is, or with the students of the right one
+            bool placed_like_left = pick_left && (crossover_type <= 1 || !same_segment_lengths);
+            if (!placed_like_left) {
+                for (auto it = left_subject_begin; it != left_global_it; it++) {
+                    result->occupancy->remove(**it);
+                }
+                for (size_t j = result_subject_begin; j < result->timetable_entries.size(); j++) {
+                    result->occupancy->add(*result->timetable_entries[j]);
+                }
+            }
+        }
+    }
+
+    // a child that is a copy of an evaluated parent has its fitness, if no entries were left over
+    std::shared_ptr<FitnessTerms>& parent_terms = all_from_left ? left_terms : right_terms;
+    bool all_traversed = left_global_it == left_global_end && right_global_it == right_global_end;
+    if ((all_from_left || all_from_right) && all_traversed && parent_terms != nullptr && parent_terms->has_fitness
+            && result->fitness_terms != nullptr) {
+        result->fitness_terms->fitness = parent_terms->fitness;
+        result->fitness_terms->has_fitness = true;
+
+        // its entries are copies of the sorted parent's in the same order, and as its fitness won't be calculated,
+        // it wouldn't be sorted before it is shared with the other processes
+        result->sorted = true;
+        return result;
     }
 
     result->sorted = false;
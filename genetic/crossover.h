@@ -13,6 +13,8 @@ private:
     std::uniform_real_distribution<double> zero_one_distribution;
 
 public:
+    static const int CROSSOVER_TYPES = 4;
+
     CrossoverCore(std::vector<import::Subject>& imported_subjects);
 
     /**
@@ -21,9 +23,26 @@ public:
      *
      * NOTE: Crossover requires the two timetables to be aligned. Subjects with differing amounts of entries
      * are handled, but the sorting function must sort so lectures and pairs of tutorials are aligned.
+     * If the left timetable is indexed, the result gets a copy of its occupancy index, updated for the subjects
+     * that were placed differently.
+     * The child takes the cached local fitness terms of the subjects it copies unchanged from an evaluated parent,
+     * and the parent's fitness if it is a copy of it (see FitnessTerms).
      */
     std::shared_ptr<Timetable> perform_crossover(std::shared_ptr<Timetable>& left,
                                                  std::shared_ptr<Timetable>& right);
+
+    /**
+     * Performs a crossover of the given type (between 0 and CROSSOVER_TYPES - 1), e.g. to measure it on its own.
+     */
+    std::shared_ptr<Timetable> perform_crossover(std::shared_ptr<Timetable>& left,
+                                                 std::shared_ptr<Timetable>& right, int crossover_type);
+
+    static const char* crossover_name(int crossover_type);
+
+    /**
+     * The random state, exposed for checkpointing.
+     */
+    std::mt19937& get_random_engine();
 };
 
 #endif //INCLUDE_CROSSOVER_H
@@ -1,17 +1,69 @@
 #include "fitness.h"
 #include "../utils.h"
+#include "../performance.h"
+
+#include <algorithm>
+#include <iostream>
+#include <cmath>
+#include <limits>
+
+const int FitnessCore::TIMELINE_WORDS;
 
 inline void fitness_t::operator+=(double what) {
     this->fitness += what;
 }
 
+void fitness_t::operator+=(const fitness_t& other) {
+    this->fitness += other.fitness;
+    this->start_too_early += other.start_too_early;
+    this->end_too_late += other.end_too_late;
+    this->end_too_late_soft += other.end_too_late_soft;
+    this->classroom_over_capacity += other.classroom_over_capacity;
+    this->timetable_entry_overlap += other.timetable_entry_overlap;
+    this->professor_overlap += other.professor_overlap;
+    this->student_overlap += other.student_overlap;
+    this->subject_lecture_tutorials_overlap += other.subject_lecture_tutorials_overlap;
+    this->subject_lecture_overlap += other.subject_lecture_overlap;
+    this->professor_over_load += other.professor_over_load;
+    this->student_preferred_start += other.student_preferred_start;
+    this->student_preferred_end += other.student_preferred_end;
+    this->lectures_merged += other.lectures_merged;
+    this->tutorials_after_lectures += other.tutorials_after_lectures;
+    this->student_entry_grouping_variance_smaller += other.student_entry_grouping_variance_smaller;
+    this->student_entry_grouping_variance_larger += other.student_entry_grouping_variance_larger;
+    this->reference_deviation += other.reference_deviation;
+}
+
+int fitness_t::hard_violations() const {
+    return this->start_too_early
+         + this->end_too_late
+         + this->classroom_over_capacity
+         + this->timetable_entry_overlap
+         + this->professor_overlap
+         + this->subject_lecture_tutorials_overlap
+         + this->subject_lecture_overlap
+         + this->professor_over_load;
+}
+
+double fitness_t::soft_fitness() const {
+    if (!this->complete) {
+        return std::numeric_limits<double>::lowest();
+    }
+    // every hard violation is penalized by the prohibitive score
+    return this->fitness - (double) this->hard_violations() * PROHIBITIVE_SCORE;
+}
+
 bool fitness_t::operator<(const fitness_t& other) const {
-    return this->fitness < other.fitness;
+    int hard = this->hard_violations();
+    int other_hard = other.hard_violations();
+    if (hard != other_hard) {
+        return hard > other_hard;
+    }
+    return this->soft_fitness() < other.soft_fitness();
 }
 
 void fitness_t::print_details() {
     std::cout << "Individual fitness: " << this->fitness << std::endl;
-    std::cout << "\t" << "non-attached lectures: " << this->non_attached_lecture << std::endl;
     std::cout << "\t" << "too early start: " << this->start_too_early << std::endl;
     std::cout << "\t" << "too late end: " << this->end_too_late << std::endl;
     std::cout << "\t" << "too late end (soft): " << this->end_too_late_soft << std::endl;
@@ -21,7 +73,6 @@ void fitness_t::print_details() {
     std::cout << "\t" << "student overlap: " << this->student_overlap << std::endl;
     std::cout << "\t" << "subject lecture tutorials overlap: " << this->subject_lecture_tutorials_overlap << std::endl;
     std::cout << "\t" << "subject lectures overlap: " << this->subject_lecture_overlap << std::endl;
-    std::cout << "\t" << "tutorials not double cycle: " << this->tutorials_double_cycle << std::endl;
     std::cout << "\t" << "professor over load: " << this->professor_over_load << std::endl;
     std::cout << "\t" << "student preferred start bonuses: " << this->student_preferred_start << std::endl;
     std::cout << "\t" << "student preferred end bonuses: " << this->student_preferred_end << std::endl;
@@ -29,6 +80,23 @@ void fitness_t::print_details() {
     std::cout << "\t" << "number of tutorials after lectures: " << this->tutorials_after_lectures << std::endl;
     std::cout << "\t" << "student entry grouping variance smaller: " << this->student_entry_grouping_variance_smaller << std::endl;
     std::cout << "\t" << "student entry grouping variance larger: " << this->student_entry_grouping_variance_larger << std::endl;
+    std::cout << "\t" << "reference timetable deviations: " << this->reference_deviation << std::endl;
+}
+
+FitnessTerms::FitnessTerms(size_t subject_slots) {
+    this->subject_terms = terms_t(subject_slots);
+    this->known_subjects = known_t(subject_slots, false);
+    this->has_fitness = false;
+}
+
+void* FitnessTerms::operator new(std::size_t size) {
+    memory::count_allocation(memory::FITNESS_TERMS, size);
+    return ::operator new(size);
+}
+
+void FitnessTerms::operator delete(void *p, std::size_t size) {
+    memory::count_deallocation(memory::FITNESS_TERMS, size);
+    ::operator delete(p);
 }
 
 FitnessCore::FitnessCore(std::map<int, import::Professor>& professors,
@@ -46,180 +114,325 @@ FitnessCore::FitnessCore(std::map<int, import::Professor>& professors,
         this->subject_lecture_ends[i.first] = std::make_pair((timetable_day_t) 0, (timetable_hour_t) 0);
     }
 
-    this->tutorial_has_pair = std::set<int>();
+    // a student is in a lecture block and a tutorial group of each subject, the counters have room for twice that
+    int max_student_id = -1;
+    unsigned int max_student_entries = 1;
+    for (auto& s : this->students) {
+        max_student_id = std::max(max_student_id, s.first);
+        max_student_entries = std::max(max_student_entries, (unsigned int) (2 * s.second.subjects.size()));
+    }
+    this->timeline_planes = 1;
+    while ((1u << this->timeline_planes) <= 2 * max_student_entries) {
+        this->timeline_planes++;
+    }
 
-    this->student_start_limit_conformities = std::map<timetable_student_t, bool>();
-    this->student_end_limit_conformities = std::map<timetable_student_t, bool>();
+    this->student_indices = std::vector<int>((unsigned long) (max_student_id + 1), -1);
+    int student_count = 0;
+    for (auto& s : this->students) {
+        this->student_indices[s.first] = student_count++;
+    }
+    this->student_timelines = std::vector<uint64_t>((unsigned long) student_count * this->timeline_planes * TIMELINE_WORDS, 0);
+    this->student_hours = std::vector<int>((unsigned long) student_count, 0);
+    this->student_time_sums = std::vector<long long>((unsigned long) student_count, 0);
+    this->student_time_square_sums = std::vector<long long>((unsigned long) student_count, 0);
+
+    this->student_subject_offsets = std::vector<int>();
+    this->student_subjects = std::vector<timetable_subject_t>();
+    for (auto& s : this->students) {
+        this->student_subject_offsets.push_back((int) this->student_subjects.size());
+        this->student_subjects.insert(this->student_subjects.end(), s.second.subjects.begin(), s.second.subjects.end());
+    }
+    this->student_subject_offsets.push_back((int) this->student_subjects.size());
 
-    this->student_entry_times = std::map<timetable_student_t, std::vector<int>>();
-    for (auto s : this->students) {
-        this->student_entry_times[s.first] = std::vector<int>();
+    this->subject_conflicts = import::SubjectConflicts(students, subjects);
+    int max_subject_id = -1;
+    for (auto& i : this->subjects) {
+        max_subject_id = std::max(max_subject_id, i.first);
+    }
+    this->subject_lectures = std::vector<std::vector<int>>((unsigned long) (max_subject_id + 1));
+    this->subject_students = std::vector<std::vector<timetable_student_t>>((unsigned long) (max_subject_id + 1));
+    for (auto& s : this->students) {
+        for (int subject : s.second.subjects) {
+            if (subject >= 0 && subject <= max_subject_id) {
+                this->subject_students[subject].push_back((timetable_student_t) s.first);
+            }
+        }
     }
+    this->subject_slots = (size_t) (max_subject_id + 1);
+    this->matrix_lectures = std::vector<int>();
+    this->matrix_lecture_blocks = std::vector<TimelineBlock>();
+
+    this->reference_placements = std::set<std::tuple<int, bool, int, int, int>>();
+    this->reference_deviation_penalty = 0;
 
     this->reset_utilities();
 }
 
+void FitnessCore::set_reference(std::shared_ptr<Timetable>& reference, double penalty) {
+    this->reference_placements.clear();
+    for (std::shared_ptr<TimetableEntry>& te : reference->timetable_entries) {
+        for (int hour = te->hour; hour < te->end_hour(); hour++) {
+            this->reference_placements.insert(std::make_tuple((int) te->subject, te->lectures, (int) te->day, hour, (int) te->classroom));
+        }
+    }
+    this->reference_deviation_penalty = penalty;
+}
+
+FitnessCore::CacheCounts FitnessCore::take_cache_counts() {
+    CacheCounts result = this->cache_counts;
+    this->cache_counts = CacheCounts();
+    return result;
+}
+
+const import::SubjectConflicts& FitnessCore::get_subject_conflicts() const {
+    return this->subject_conflicts;
+}
+
+void FitnessCore::enable_occupancy_index() {
+    this->occupancy_layout = std::make_shared<const OccupancyLayout>(this->professors, this->classrooms, this->subjects);
+}
+
 void FitnessCore::reset_utilities() {
     for (auto i : this->professors) {
         this->professor_loads[i.first] = 0;
     }
-    for (auto i : this->students) {
-        this->student_start_limit_conformities[i.first] = true;
-        this->student_end_limit_conformities[i.first] = true;
-        this->student_entry_times.clear();
-    }
+    std::fill(this->student_timelines.begin(), this->student_timelines.end(), 0);
+    std::fill(this->student_hours.begin(), this->student_hours.end(), 0);
+    std::fill(this->student_time_sums.begin(), this->student_time_sums.end(), 0);
+    std::fill(this->student_time_square_sums.begin(), this->student_time_square_sums.end(), 0);
     for (auto i : this->subjects) {
         this->subject_lecture_ends[i.first].first = 0;
         this->subject_lecture_ends[i.first].second = 0;
     }
-    this->tutorial_has_pair.clear();
+}
+
+bool FitnessCore::fits_timelines(const TimetableEntry& entry) {
+    return entry.day < ActiveTimetableConfig::days && entry.end_hour() <= 32;
+}
+
+FitnessCore::BlockMoments FitnessCore::block_moments(const TimetableEntry& entry) {
+    // the contiguous slot time representation of each hour for variance calculation
+    BlockMoments result = {0, 0, 0};
+    for (int hour = entry.hour; hour < entry.end_hour(); hour++) {
+        long long time = utils::get_packed_slot_time(entry.day, hour, EARLIEST_HOUR, LATEST_HOUR);
+        result.hours++;
+        result.time_sum += time;
+        result.time_square_sum += time * time;
+    }
+    return result;
+}
+
+inline int FitnessCore::add_to_timeline(int index, int word, uint64_t block, const BlockMoments& moments, bool count_overlaps) {
+    // a student shouldn't be in two places at the same time: every hour of the block overlaps with
+    // as many entries as the student already has in it, then the block is added to the counter
+    uint64_t* planes = &this->student_timelines[((size_t) index * this->timeline_planes) * TIMELINE_WORDS + word];
+    int overlaps = 0;
+    uint64_t carry = block;
+    for (int j = 0; j < this->timeline_planes; j++) {
+        uint64_t& plane = planes[j * TIMELINE_WORDS];
+        if (count_overlaps) {
+            overlaps += __builtin_popcountll(plane & block) << j;
+        }
+        uint64_t next_carry = plane & carry;
+        plane ^= carry;
+        carry = next_carry;
+    }
+    if (carry != 0) {
+        // more entries than the counter can hold (not possible with valid tutorial groups), it saturates
+        for (int j = 0; j < this->timeline_planes; j++) {
+            planes[j * TIMELINE_WORDS] |= carry;
+        }
+    }
+
+    this->student_hours[index] += moments.hours;
+    this->student_time_sums[index] += moments.time_sum;
+    this->student_time_square_sums[index] += moments.time_square_sum;
+    return overlaps;
+}
+
+int FitnessCore::add_to_timelines(const TimetableEntry& entry) {
+    if (!fits_timelines(entry)) {
+        return 0;
+    }
+
+    BlockMoments moments = block_moments(entry);
+    int word = entry.day / 2;
+    uint64_t block = timeline_block(entry.day, entry.hour, entry.end_hour());
+    int overlaps = 0;
+    for (timetable_student_t s : entry.students) {
+        int index = s < this->student_indices.size() ? this->student_indices[s] : -1;
+        if (index >= 0) {
+            overlaps += add_to_timeline(index, word, block, moments, true);
+        }
+    }
+    return overlaps;
+}
+
+bool FitnessCore::takes_whole_enrollment(const TimetableEntry& entry) const {
+    if (entry.subject >= this->subject_students.size()) {
+        return false;
+    }
+    const std::vector<timetable_student_t>& enrolled = this->subject_students[entry.subject];
+    return entry.students.size() == enrolled.size() && std::equal(entry.students.begin(), entry.students.end(), enrolled.begin());
 }
 
 fitness_t FitnessCore::calculate_fitness(std::shared_ptr<Timetable>& timetable) {
+    return calculate_fitness(timetable, std::numeric_limits<int>::max());
+}
+
+fitness_t FitnessCore::calculate_fitness(std::shared_ptr<Timetable>& timetable, int max_hard_violations) {
+    static const int probe = PerformanceBenchmark::probe("Individual fitness", false);
+    ScopedTimer timer(probe);
+
+    // the individual was evaluated before, or is identical to an evaluated parent
+    // it is still sorted like every evaluated individual, so operators never sort one after it is shared
+    std::shared_ptr<FitnessTerms> terms = timetable->fitness_terms;
+    if (terms != nullptr && terms->has_fitness) {
+        timetable->sort();
+        this->cache_counts.inherited_fitnesses++;
+        return terms->fitness;
+    }
+    if (terms == nullptr || terms->subject_terms.size() != this->subject_slots) {
+        terms = std::shared_ptr<FitnessTerms>(new FitnessTerms(this->subject_slots));
+    }
+    for (size_t i = 0; i < this->subject_slots; i++) {
+        if (!terms->known_subjects[i]) {
+            terms->subject_terms[i] = fitness_t();
+        }
+    }
+
     reset_utilities();
     fitness_t result = fitness_t();
 
     // calculating fitness requires the timetable to be sorted
     timetable->sort();
 
-    int outer_counter = 0;
-    std::shared_ptr<TimetableEntry> saved_entry = timetable->timetable_entries.front();
-    for (auto outer = timetable->timetable_entries.begin(); outer != timetable->timetable_entries.end(); outer++, outer_counter++) {
-        std::shared_ptr<TimetableEntry>& e1 = *outer;
+    // the clashes that are indexed don't need to be found by comparing entries
+    if (this->occupancy_layout != nullptr && timetable->occupancy == nullptr) {
+        timetable->index_occupancy(this->occupancy_layout);
+    }
+    bool indexed = timetable->occupancy != nullptr;
+    if (indexed) {
+        const OccupancyIndex& occupancy = *timetable->occupancy;
+        result += occupancy.get_classroom_clashes() * TIMETABLE_ENTRY_OVERLAP_SCORE;
+        result.timetable_entry_overlap += occupancy.get_classroom_clashes();
+        result += occupancy.get_professor_clashes() * PROFESSOR_OVERLAP_SCORE;
+        result.professor_overlap += occupancy.get_professor_clashes();
+        result += occupancy.get_lecture_tutorial_clashes() * SUBJECT_LECTURE_TUTORIALS_OVERLAP_SCORE;
+        result.subject_lecture_tutorials_overlap += occupancy.get_lecture_tutorial_clashes();
+        result += occupancy.get_lecture_clashes() * SUBJECT_LECTURE_OVERLAP_SCORE;
+        result.subject_lecture_overlap += occupancy.get_lecture_clashes();
+    }
 
-        // start and end times
-        if (e1->hour < EARLIEST_HOUR) {
-            result += START_TOO_EARLY_SCORE;
-            result.start_too_early++;
-        }
-        if (e1->hour > LATEST_HOUR) {
-            result += END_TOO_LATE_SCORE;
-            result.end_too_late++;
-        } else if (e1->hour > SOFT_LATEST_HOUR) {
-            result += SOFT_LATEST_HOUR_SCORE;
-            result.end_too_late_soft++;
-        }
+    for (auto outer = timetable->timetable_entries.begin(); outer != timetable->timetable_entries.end(); outer++) {
+        std::shared_ptr<TimetableEntry>& e1 = *outer;
+        int last_hour = e1->end_hour() - 1;
 
         // professor loads (only for tutorials, lectures do not count
         for (int p : e1->professors) {
             if (!e1->lectures) {
-                this->professor_loads[p]++;
+                this->professor_loads[p] += e1->duration;
             }
         }
 
-        // classroom capacity check
-        if ((e1->lectures && e1->students.size() > this->classrooms[e1->classroom].lecture_capacity)
-                || (!e1->lectures && e1->students.size() > this->classrooms[e1->classroom].tutorial_capacity)) {
-            result += CLASSROOM_OVER_CAPACITY_SCORE;
-            result.classroom_over_capacity++;
-        }
+        // the local terms of the entry's subject, unless they were taken from a parent
+        bool has_terms = e1->subject < this->subject_slots;
+        if (!has_terms || !terms->known_subjects[e1->subject]) {
+            fitness_t& local = has_terms ? terms->subject_terms[e1->subject] : result;
 
-        // lecture and tutorial linear checks
-        if (e1->lectures) {
-            // if the lectures are of the same subject on the same day, and also are apart more than an hour (non-sequential),
-            // apply a penalty (this works because we always compare two time-sequential lectures
-            if (e1->subject == saved_entry->subject && e1->day == saved_entry->day && e1->hour - saved_entry->hour > 1) {
-                result += NON_ATTACHED_LECTURE_SCORE;
-                result.non_attached_lecture++;
+            // start and end times, for each hour of the block
+            if (e1->hour < EARLIEST_HOUR) {
+                int hours = std::min(EARLIEST_HOUR, e1->end_hour()) - e1->hour;
+                local += hours * START_TOO_EARLY_SCORE;
+                local.start_too_early += hours;
+            }
+            for (int hour = e1->hour; hour <= last_hour; hour++) {
+                if (hour > LATEST_HOUR) {
+                    local += END_TOO_LATE_SCORE;
+                    local.end_too_late++;
+                } else if (hour > SOFT_LATEST_HOUR) {
+                    local += SOFT_LATEST_HOUR_SCORE;
+                    local.end_too_late_soft++;
+                }
             }
 
-            saved_entry = e1;
-        }
+            // classroom capacity check
+            if ((e1->lectures && e1->students.size() > this->classrooms[e1->classroom].lecture_capacity)
+                    || (!e1->lectures && e1->students.size() > this->classrooms[e1->classroom].tutorial_capacity)) {
+                local += e1->duration * CLASSROOM_OVER_CAPACITY_SCORE;
+                local.classroom_over_capacity += e1->duration;
+            }
 
-        // tutorials after lectures bonus
-        if (e1->day > this->subject_lecture_ends[e1->subject].first ||
-            (e1->day == this->subject_lecture_ends[e1->subject].first && e1->hour > this->subject_lecture_ends[e1->subject].second)) {
+            // bonus points for each pair of neighbouring lecture hours, which are always merged in a block
+            if (e1->lectures) {
+                local += (e1->duration - 1) * LECTURES_MERGED_BONUS;
+                local.lectures_merged += e1->duration - 1;
+            }
+
+            // tutorials after lectures bonus
+            std::pair<timetable_day_t, timetable_hour_t>& lecture_end = this->subject_lecture_ends[e1->subject];
             if (e1->lectures) {
                 // store the latest lecture time for the subject so we can compute bonuses for tutorials being after lectures
-                this->subject_lecture_ends[e1->subject].first = e1->day;
-                this->subject_lecture_ends[e1->subject].second = e1->hour;
+                if (e1->day > lecture_end.first || (e1->day == lecture_end.first && last_hour > lecture_end.second)) {
+                    lecture_end.first = e1->day;
+                    lecture_end.second = (timetable_hour_t) last_hour;
+                }
             } else {
-                // compare the time if this tutorial to the latest lecture
+                // compare the time of each hour of this tutorial to the latest lecture
                 // this works because the vector is sorted so all lectures appear before tutorials within the same subject
-                result += TUTORIALS_AFTER_LECTURES_BONUS;
-                result.tutorials_after_lectures++;
+                int hours_after = e1->day > lecture_end.first ? e1->duration
+                                : e1->day < lecture_end.first ? 0
+                                : std::max(0, e1->end_hour() - std::max((int) e1->hour, lecture_end.second + 1));
+                local += hours_after * TUTORIALS_AFTER_LECTURES_BONUS;
+                local.tutorials_after_lectures += hours_after;
             }
-        }
-
-        // calculate the contiguous slot time representation for variance calculation
-        int packed_variance_time = utils::get_packed_slot_time(e1->day, e1->hour, EARLIEST_HOUR, LATEST_HOUR);
 
-        // student operations
-        for (int s : e1->students) {
-            // check start and end conformities: bonus points for students always starting after or always ending before a specified hour
-            if (e1->hour < STUDENT_PREFERRED_START) {
-                this->student_start_limit_conformities[s] = false;
-            }
-            if (e1->hour > STUDENT_PREFERRED_END) {
-                this->student_end_limit_conformities[s] = false;
+            // deviation from the published timetable
+            if (!this->reference_placements.empty()) {
+                for (int hour = e1->hour; hour <= last_hour; hour++) {
+                    if (this->reference_placements.count(std::make_tuple((int) e1->subject, e1->lectures, (int) e1->day, hour, (int) e1->classroom)) == 0) {
+                        local += -this->reference_deviation_penalty;
+                        local.reference_deviation++;
+                    }
+                }
             }
-
-            this->student_entry_times[s].push_back(packed_variance_time);
         }
 
-        // only tutorials have this
-        bool found_tutorial_match = e1->lectures;
-
-        // can compare each pair
+        // the remaining clashes are read from the occupancy index if there is one, otherwise each pair is compared
+        if (indexed) {
+            continue;
+        }
         auto inner = outer;
-        int inner_counter = outer_counter + 1;
-        for (inner++; inner != timetable->timetable_entries.end(); inner++, inner_counter++) {
+        for (inner++; inner != timetable->timetable_entries.end(); inner++) {
             std::shared_ptr<TimetableEntry>& e2 = *inner;
 
-            // entries occur at the same time
-            if (e1->day == e2->day && e1->hour == e2->hour) {
+            // entries occur at the same time, every overlapping hour counts
+            int overlapping_hours = e1->overlapping_hours(e2);
+            if (overlapping_hours > 0) {
                 // you can't have two entries in the same classroom
                 if (e1->classroom == e2->classroom) {
-                    result += TIMETABLE_ENTRY_OVERLAP_SCORE;
-                    result.timetable_entry_overlap++;
+                    result += overlapping_hours * TIMETABLE_ENTRY_OVERLAP_SCORE;
+                    result.timetable_entry_overlap += overlapping_hours;
                 }
 
-                int overlapping_professors = utils::count_overlaps(e1->professors, e2->professors);
-                if (overlapping_professors > 0) {
-                    result += PROFESSOR_OVERLAP_SCORE;
-                    result.professor_overlap++;
-                }
-
-                // a student shouldn't be in two places at the same time
-                int student_overlaps = utils::count_overlaps(e1->students, e2->students);
-                result += student_overlaps * STUDENT_OVERLAP_SCORE;
-                result.student_overlap += student_overlaps;
+                // nor a professor in two places
+                int professor_overlaps = overlapping_hours * utils::count_overlaps(e1->professors, e2->professors);
+                result += professor_overlaps * PROFESSOR_OVERLAP_SCORE;
+                result.professor_overlap += professor_overlaps;
 
                 // the same subject can't have tutorials and lectures at the same time
                 if (e1->subject == e2->subject) {
                     if (e1->lectures && !e2->lectures) {
-                        result += SUBJECT_LECTURE_TUTORIALS_OVERLAP_SCORE;
-                        result.subject_lecture_tutorials_overlap++;
+                        result += overlapping_hours * SUBJECT_LECTURE_TUTORIALS_OVERLAP_SCORE;
+                        result.subject_lecture_tutorials_overlap += overlapping_hours;
                     }
 
                     if (e1->lectures && e2->lectures) {
-                        result += SUBJECT_LECTURE_OVERLAP_SCORE;
-                        result.subject_lecture_overlap++;
+                        result += overlapping_hours * SUBJECT_LECTURE_OVERLAP_SCORE;
+                        result.subject_lecture_overlap += overlapping_hours;
                     }
                 }
             }
-
-            // see the tutorial_has_pair initialization for reasoning
-            // we only check outer_counter because it is the element being checked
-            // and we have already (probably) found its pair before
-            if (!found_tutorial_match && (e1->is_matching_tutorial(e2) || this->tutorial_has_pair.count(outer_counter) == 1)) {
-                found_tutorial_match = true;
-                this->tutorial_has_pair.insert(inner_counter);
-                this->tutorial_has_pair.insert(outer_counter);
-            }
-
-            // bonus points for each matching lecture pair (enforces them to be merged)
-            if (e1->is_matching_lecture_strict(e2)) {
-                result += LECTURES_MERGED_BONUS;
-                result.lectures_merged++;
-            }
-        }
-
-        // if two tutorials aren't grouped together, apply a penalty
-        // lectures are handled at the found_tutorial_match definition
-        if (!found_tutorial_match) {
-            result += TUTORIALS_NOT_DOUBLE_CYCLE_SCORE;
-            result.tutorials_double_cycle++;
         }
     }
 
@@ -231,44 +444,125 @@ fitness_t FitnessCore::calculate_fitness(std::shared_ptr<Timetable>& timetable)
         }
     }
 
-    // student preferred times post-processing
-    for (auto i : this->student_start_limit_conformities) {
-        if (i.second) {
-            result += STUDENT_PREFERRED_START_BONUS;
-            result.student_preferred_start++;
+    // the local terms of every subject, which are cached on the timetable
+    for (size_t i = 0; i < this->subject_slots; i++) {
+        result += terms->subject_terms[i];
+        if (this->subjects.count((int) i) == 1) {
+            if (terms->known_subjects[i]) {
+                this->cache_counts.reused_subjects++;
+            } else {
+                this->cache_counts.computed_subjects++;
+            }
         }
+        terms->known_subjects[i] = true;
     }
-    for (auto i : this->student_end_limit_conformities) {
-        if (i.second) {
-            result += STUDENT_PREFERRED_END_BONUS;
-            result.student_preferred_end++;
+    timetable->fitness_terms = terms;
+
+    // every hard constraint is known at this point, the soft constraints of the students are the bulk of the work
+    if (result.hard_violations() > max_hard_violations) {
+        result.complete = false;
+        this->cache_counts.early_exits++;
+        return result;
+    }
+
+    // student timelines: lectures are added before tutorials, so the overlaps of every tutorial include all lectures
+    // a lecture taken by exactly its subject's students (as generated and repaired) is added through the subject lists
+    // of the students, without walking its student set, and its overlaps with other such lectures are the hours they
+    // share times the subjects' shared enrollment; other lectures are counted on the timelines like tutorials
+    std::vector<std::shared_ptr<TimetableEntry>>& entries = timetable->timetable_entries;
+    int student_overlaps = 0;
+    this->matrix_lectures.clear();
+    this->matrix_lecture_blocks.clear();
+    for (std::vector<int>& lectures : this->subject_lectures) {
+        lectures.clear();
+    }
+    for (int i = 0; i < (int) entries.size(); i++) {
+        TimetableEntry& entry = *entries[i];
+        if (entry.lectures && fits_timelines(entry) && takes_whole_enrollment(entry)) {
+            TimelineBlock lecture_block = {entry.day / 2, timeline_block(entry.day, entry.hour, entry.end_hour()), block_moments(entry)};
+            this->subject_lectures[entry.subject].push_back((int) this->matrix_lecture_blocks.size());
+            this->matrix_lecture_blocks.push_back(lecture_block);
+            this->matrix_lectures.push_back(i);
         }
     }
 
-    // variance (student entry grouping) post-processing
-    for (auto& i : this->student_entry_times) {
-        // calculate the variance for each student
-        // https://en.wikipedia.org/wiki/Algorithms_for_calculating_variance#Online_algorithm
-        int n = 0;
-        double mean = 0.0;
-        double variance = 0.0;
+    for (int index = 0; index < (int) this->student_hours.size(); index++) {
+        for (int k = this->student_subject_offsets[index]; k < this->student_subject_offsets[index + 1]; k++) {
+            timetable_subject_t subject = this->student_subjects[k];
+            if (subject >= this->subject_lectures.size()) {
+                continue;
+            }
+            for (int i : this->subject_lectures[subject]) {
+                const TimelineBlock& lecture_block = this->matrix_lecture_blocks[i];
+                add_to_timeline(index, lecture_block.word, lecture_block.block, lecture_block.moments, false);
+            }
+        }
+    }
 
-        for (int time : i.second) {
-            n++;
-            double delta = time - mean;
-            mean += delta / n;
-            variance += delta * (time - mean);
+    for (unsigned int a = 0; a < this->matrix_lectures.size(); a++) {
+        std::shared_ptr<TimetableEntry>& e1 = entries[this->matrix_lectures[a]];
+        for (unsigned int b = a + 1; b < this->matrix_lectures.size(); b++) {
+            std::shared_ptr<TimetableEntry>& e2 = entries[this->matrix_lectures[b]];
+            int overlapping_hours = e1->overlapping_hours(e2);
+            if (overlapping_hours > 0) {
+                student_overlaps += overlapping_hours * this->subject_conflicts.shared(e1->subject, e2->subject);
+            }
         }
+    }
 
-        if (n < 2) {
-            variance = 0;
+    unsigned int next_matrix_lecture = 0;
+    for (int i = 0; i < (int) entries.size(); i++) {
+        if (next_matrix_lecture < this->matrix_lectures.size() && this->matrix_lectures[next_matrix_lecture] == i) {
+            next_matrix_lecture++;
         } else {
-            variance /= n;
+            student_overlaps += add_to_timelines(*entries[i]);
+        }
+    }
+    result += student_overlaps * STUDENT_OVERLAP_SCORE;
+    result.student_overlap += student_overlaps;
+
+    // student post-processing, over the contiguous timelines
+    // the hours before the preferred start and after the preferred end in every day lane of a word
+    uint64_t early_lanes = ((1ull << STUDENT_PREFERRED_START) - 1) * (1ull | (1ull << 32));
+    uint64_t late_lanes = (0xFFFFFFFFull & ~((1ull << (STUDENT_PREFERRED_END + 1)) - 1)) * (1ull | (1ull << 32));
+
+    // take the variance of an uniform distribution as the "maximum"
+    double uniform_variance = pow(utils::get_packed_slot_time(ActiveTimetableConfig::days - 1, LATEST_HOUR, EARLIEST_HOUR, LATEST_HOUR), 2) / 12;
+
+    int student_count = (int) this->student_hours.size();
+    for (int index = 0; index < student_count; index++) {
+        // student preferred times: bonus points for students always starting after or always ending before a specified hour
+        const uint64_t* planes = &this->student_timelines[((size_t) index * this->timeline_planes) * TIMELINE_WORDS];
+        uint64_t early = 0;
+        uint64_t late = 0;
+        for (int word = 0; word < TIMELINE_WORDS; word++) {
+            uint64_t occupied = 0;
+            for (int j = 0; j < this->timeline_planes; j++) {
+                occupied |= planes[j * TIMELINE_WORDS + word];
+            }
+            early |= occupied & early_lanes;
+            late |= occupied & late_lanes;
+        }
+        if (early == 0) {
+            result += STUDENT_PREFERRED_START_BONUS;
+            result.student_preferred_start++;
+        }
+        if (late == 0) {
+            result += STUDENT_PREFERRED_END_BONUS;
+            result.student_preferred_end++;
         }
 
-        // now evaluate the variance
-        // take the variance of an uniform distribution as the "maximum"
-        double uniform_variance = pow(utils::get_packed_slot_time(4, LATEST_HOUR, EARLIEST_HOUR, LATEST_HOUR), 2) / 12;
+        // variance (student entry grouping) of the students that have entries
+        int n = this->student_hours[index];
+        if (n == 0) {
+            continue;
+        }
+        double variance = 0;
+        if (n >= 2) {
+            // the sums are exact, so the variance can be computed from them directly
+            double sum = (double) this->student_time_sums[index];
+            variance = (n * (double) this->student_time_square_sums[index] - sum * sum) / ((double) n * n);
+        }
 
         double variance_difference_normalized = (uniform_variance - variance) / uniform_variance;
 
@@ -282,15 +576,49 @@ fitness_t FitnessCore::calculate_fitness(std::shared_ptr<Timetable>& timetable)
         }
     }
 
-    // this seems to be a bug, so a workaround is needed
-    if (result.tutorials_double_cycle == 1) {
-        result.tutorials_double_cycle = 0;
-        result.fitness -= TUTORIALS_NOT_DOUBLE_CYCLE_SCORE;
-    }
+    terms->fitness = result;
+    terms->has_fitness = true;
+    this->cache_counts.evaluated_fitnesses++;
 
     return result;
 }
 
+FitnessPair::FitnessPair() {
+    this->individual_index = -1;
+    this->fitness = 0;
+    this->hard_violations = 0;
+    this->soft_fitness = 0;
+}
+
+FitnessPair::FitnessPair(int individual_index, const fitness_t& fitness) {
+    this->individual_index = individual_index;
+    this->fitness = fitness.fitness;
+    this->hard_violations = fitness.hard_violations();
+    this->soft_fitness = fitness.soft_fitness();
+}
+
+bool FitnessPair::is_complete() const {
+    return this->soft_fitness != std::numeric_limits<double>::lowest();
+}
+
 bool FitnessPair::compare_fitness(const FitnessPair& a, const FitnessPair& b) {
-    return a.fitness > b.fitness;
+    if (a.hard_violations != b.hard_violations) {
+        return a.hard_violations < b.hard_violations;
+    }
+    if (a.soft_fitness != b.soft_fitness) {
+        return a.soft_fitness > b.soft_fitness;
+    }
+    return a.individual_index < b.individual_index;
+}
+
+void FitnessPair::settle_early_exit(std::vector<FitnessPair>& fitnesses) {
+    int min_hard_violations = std::numeric_limits<int>::max();
+    for (const FitnessPair& fp : fitnesses) {
+        min_hard_violations = std::min(min_hard_violations, fp.hard_violations);
+    }
+    for (FitnessPair& fp : fitnesses) {
+        if (fp.hard_violations > min_hard_violations) {
+            fp.soft_fitness = std::numeric_limits<double>::lowest();
+        }
+    }
 }
@@ -9,13 +9,16 @@
 
 #include <memory>
 #include <set>
+#include <tuple>
+#include <vector>
 
 // forward declaration
 class Timetable;
 
 
-#define EARLIEST_HOUR      7
-#define LATEST_HOUR       19
+// the allowed hours are part of the compile-time grid configuration (see timetable_types.h)
+#define EARLIEST_HOUR     (ActiveTimetableConfig::earliest_hour)
+#define LATEST_HOUR       (ActiveTimetableConfig::latest_hour)
 #define SOFT_LATEST_HOUR  18
 #define STUDENT_PREFERRED_START  8
 #define STUDENT_PREFERRED_END   17
@@ -27,7 +30,6 @@ class Timetable;
 #define START_TOO_EARLY_SCORE                   PROHIBITIVE_SCORE
 #define END_TOO_LATE_SCORE                      PROHIBITIVE_SCORE
 #define TIMETABLE_ENTRY_OVERLAP_SCORE           PROHIBITIVE_SCORE
-#define TUTORIALS_NOT_DOUBLE_CYCLE_SCORE        PROHIBITIVE_SCORE
 #define PROFESSOR_OVERLAP_SCORE                 PROHIBITIVE_SCORE
 #define SUBJECT_LECTURE_OVERLAP_SCORE           PROHIBITIVE_SCORE
 #define SUBJECT_LECTURE_TUTORIALS_OVERLAP_SCORE PROHIBITIVE_SCORE
@@ -37,7 +39,6 @@ class Timetable;
 // negatives (would rather they don't happen)
 #define STUDENT_OVERLAP_SCORE      -30
 #define SOFT_LATEST_HOUR_SCORE     -20
-#define NON_ATTACHED_LECTURE_SCORE -50
 
 // positives (increase score if conditions are met, but these are not required)
 #define STUDENT_PREFERRED_START_BONUS 20
@@ -57,7 +58,6 @@ public:
     double fitness = 0;
 
     // counts
-    int non_attached_lecture = 0;
     int start_too_early = 0;
     int end_too_late = 0;
     int end_too_late_soft = 0;
@@ -67,7 +67,6 @@ public:
     int student_overlap = 0;
     int subject_lecture_tutorials_overlap = 0;
     int subject_lecture_overlap = 0;
-    int tutorials_double_cycle = 0;
     int professor_over_load = 0;
     int student_preferred_start = 0;
     int student_preferred_end = 0;
@@ -75,15 +74,79 @@ public:
     int tutorials_after_lectures = 0;
     int student_entry_grouping_variance_smaller = 0;
     int student_entry_grouping_variance_larger = 0;
+    int reference_deviation = 0;
+
+    // false if the evaluation stopped after the hard constraints, the soft constraints of the student timelines
+    // are then missing from the fitness (see FitnessCore::calculate_fitness)
+    bool complete = true;
 
     inline void operator+=(double what);
 
+    /**
+     * Adds the value and the counts of other, e.g. the terms of a subject to the whole fitness.
+     */
+    void operator+=(const fitness_t& other);
+
+    /**
+     * The number of prohibitive (hard) constraint violations. An individual is feasible if this is 0.
+     */
+    int hard_violations() const;
+
+    /**
+     * The fitness without the hard constraint penalties, the lowest double if the evaluation wasn't complete.
+     */
+    double soft_fitness() const;
+
+    /**
+     * Compares lexicographically: more hard violations are worse, the soft fitness decides between equal counts.
+     */
     bool operator<(const fitness_t& other) const;
 
     void print_details();
 };
 
+/**
+ * The fitness of an evaluated individual, with the local terms of each subject: the constraints that only depend on
+ * the subject's own entries (start and end times, classroom capacity, merged lectures, tutorials after lectures
+ * and deviations from the reference). The interaction terms between subjects (clashes, professor loads and every
+ * student constraint) are not kept.
+ * It is cached on the timetable, so a crossover child can take the terms of the subjects it copied from a parent
+ * unchanged and the fitness of a parent it is identical to, and a mutated copy the terms of the subjects that weren't
+ * mutated. Individuals are never changed after their evaluation, operators work on copies.
+ */
+class FitnessTerms {
+public:
+    typedef std::vector<fitness_t, memory::CountingAllocator<fitness_t, memory::FITNESS_TERMS>> terms_t;
+    typedef std::vector<bool, memory::CountingAllocator<bool, memory::FITNESS_TERMS>> known_t;
+
+    // by subject ID, the terms of a subject are only valid if it is known
+    terms_t subject_terms;
+    known_t known_subjects;
+
+    // whether fitness is the fitness of the whole individual
+    bool has_fitness;
+    fitness_t fitness;
+
+    FitnessTerms(size_t subject_slots);
+
+    // allocations are counted for memory accounting
+    static void* operator new(std::size_t size);
+    static void operator delete(void* p, std::size_t size);
+};
+
 class FitnessCore {
+public:
+    /**
+     * How often the fitness terms cached on individuals were used, and how often evaluations stopped early.
+     */
+    struct CacheCounts {
+        int inherited_fitnesses = 0;    // individuals whose fitness was taken from a parent or an earlier evaluation
+        int evaluated_fitnesses = 0;    // individuals that were evaluated
+        long reused_subjects = 0;       // subjects of evaluated individuals whose local terms were taken from a parent
+        long computed_subjects = 0;     // subjects of evaluated individuals whose local terms were computed
+        int early_exits = 0;            // evaluations that stopped after the hard constraints (not cached)
+    };
+
 private:
     std::map<int, import::Professor> professors;
     std::map<int, import::Classroom> classrooms;
@@ -96,16 +159,92 @@ private:
     // the pair is semantically <first: day, second: hour>
     std::map<int, std::pair<timetable_day_t, timetable_hour_t>> subject_lecture_ends;
 
-    // this is a helper for checking tutorial pairness
-    // the set contains a tutorial index (counter, local only) if it has a pair
-    // this is because we check each pair only once for efficiency and entries that occur later in the list
-    // do not have a pair, as we don't include any prior entries in the check
-    std::set<int> tutorial_has_pair;
+    // student timelines, contiguous over all students: the week of a student is a binary counter of its entries
+    // in each hour, stored in timeline_planes bit planes of TIMELINE_WORDS words each (see timeline_block)
+    static const int TIMELINE_WORDS = (ActiveTimetableConfig::days + 1) / 2;
+    int timeline_planes;
+    std::vector<int> student_indices; // by student ID, -1 if the ID is not a student
+    std::vector<uint64_t> student_timelines;
+
+    // the number, sum and sum of squares of the packed slot times of each student's entry hours, for the variance
+    std::vector<int> student_hours;
+    std::vector<long long> student_time_sums;
+    std::vector<long long> student_time_square_sums;
+
+    // the subjects of each student, contiguous in the order of the timelines (offsets has a sentinel at the end)
+    std::vector<int> student_subject_offsets;
+    std::vector<timetable_subject_t> student_subjects;
+
+    // the number of students each pair of subjects shares
+    // lectures taken by exactly their subject's students are indexed by subject, their overlaps are read from it
+    import::SubjectConflicts subject_conflicts;
+    std::vector<std::vector<timetable_student_t>> subject_students; // the sorted IDs of each subject's students
+    std::vector<std::vector<int>> subject_lectures; // indices into matrix_lecture_blocks
+    std::vector<int> matrix_lectures;               // indices into the timetable's entries
+
+    /**
+     * The count, sum and sum of squares of the packed slot times of a block's hours, which are added to each student.
+     */
+    struct BlockMoments {
+        int hours;
+        long long time_sum;
+        long long time_square_sum;
+    };
+
+    static BlockMoments block_moments(const TimetableEntry& entry);
 
-    std::map<timetable_student_t, bool> student_start_limit_conformities;
-    std::map<timetable_student_t, bool> student_end_limit_conformities;
+    /**
+     * A block as it is added to the timelines: its word, its mask in the word and its moments.
+     */
+    struct TimelineBlock {
+        int word;
+        uint64_t block;
+        BlockMoments moments;
+    };
 
-    std::map<timetable_student_t, std::vector<int>> student_entry_times;
+    std::vector<TimelineBlock> matrix_lecture_blocks;
+
+    /**
+     * Whether the entry's students are exactly its subject's students, so its student overlaps with other such
+     * entries can be read from the subject conflict matrix. A count alone doesn't tell.
+     */
+    bool takes_whole_enrollment(const TimetableEntry& entry) const;
+
+    /**
+     * Adds a block to the timeline of the student with the index and returns the overlaps with the entries already
+     * in it if count_overlaps is set, 0 otherwise.
+     */
+    inline int add_to_timeline(int index, int word, uint64_t block, const BlockMoments& moments, bool count_overlaps);
+
+    /**
+     * Adds the entry's block to the timelines of its students and returns the overlaps.
+     */
+    int add_to_timelines(const TimetableEntry& entry);
+
+    /**
+     * Whether the entry can be placed on the timelines (the day and hours fit them).
+     */
+    static bool fits_timelines(const TimetableEntry& entry);
+
+    /**
+     * The block's hours as a mask of its word of the timeline: days are 32-bit lanes, two in each word, and bit h
+     * of a lane is hour h of the day.
+     */
+    static inline uint64_t timeline_block(timetable_day_t day, int first_hour, int end_hour) {
+        return ((1ull << (end_hour - first_hour)) - 1) << ((day % 2) * 32 + first_hour);
+    }
+
+    // placements of a previously published timetable, as <subject, lectures, day, hour, classroom>
+    // entries that are not placed the same way are penalized to keep incremental re-scheduling stable
+    std::set<std::tuple<int, bool, int, int, int>> reference_placements;
+    double reference_deviation_penalty;
+
+    // the dimensions of the occupancy indexes, nullptr if individuals are not indexed
+    std::shared_ptr<const OccupancyLayout> occupancy_layout;
+
+    // the number of subject slots of the cached fitness terms (the largest subject ID + 1)
+    size_t subject_slots;
+    CacheCounts cache_counts;
 
     /**
      * Resets computation utilities in preparation for the next computation pass.
@@ -117,10 +256,47 @@ public:
                 std::map<int, import::Student>& students,
                 std::map<int, import::Subject>& subjects);
 
+    /**
+     * Sets the timetable deviations are measured against. Each entry of an individual that is not placed
+     * (time and classroom) like an entry of the same subject and type in the reference is penalized by the penalty.
+     * It must be set before individuals are evaluated, as cached fitnesses aren't computed again.
+     */
+    void set_reference(std::shared_ptr<Timetable>& reference, double penalty);
+
+    /**
+     * Indexes the occupancy of every individual whose fitness is calculated (unless it already is indexed),
+     * the classroom, professor and subject lecture clashes are then read from the index instead of comparing entries.
+     * Indexed individuals keep their index through mutation and crossover.
+     */
+    void enable_occupancy_index();
+
     /**
      * Calculates the fitness of the specified individual.
+     * Student constraints are evaluated on the student timelines: each entry adds its block to the timelines of its
+     * students, where the overlaps are the popcounts of the block with the counter's planes, and the preferred start
+     * and end conformities are masked tests of the occupied hours. Overlaps between lectures are looked up
+     * in the subject conflict matrix instead.
+     * Lecture blocks and double cycles are contiguous by construction, every constraint is scored
+     * for each hour of a block (or each hour two blocks overlap), as if the hours were separate entries.
+     * Professor clashes are counted for each professor the overlapping blocks share.
+     * The result is cached on the timetable (see FitnessTerms) and returned again by later calls, a crossover child
+     * only computes the interaction terms and the local terms of the subjects it didn't copy from a parent.
      */
     fitness_t calculate_fitness(std::shared_ptr<Timetable>& timetable);
+
+    /**
+     * Calculates the fitness like above, but the hard constraints are evaluated first and the evaluation stops
+     * if there are more than max_hard_violations of them. The result is then incomplete: its soft fitness is unknown,
+     * so it is worse than any individual with as many violations, and it isn't cached as the individual's fitness.
+     */
+    fitness_t calculate_fitness(std::shared_ptr<Timetable>& timetable, int max_hard_violations);
+
+    /**
+     * Returns the cache counts since the previous call and resets them.
+     */
+    CacheCounts take_cache_counts();
+
+    const import::SubjectConflicts& get_subject_conflicts() const;
 };
 
 /**
@@ -135,27 +311,53 @@ private:
     void serialize(Archive& ar, const unsigned int version) {
         ar & this->individual_index;
         ar & this->fitness;
+        ar & this->hard_violations;
+        ar & this->soft_fitness;
     }
 
 public:
     int individual_index;
     double fitness;
+    int hard_violations;
+    double soft_fitness; // the lowest double if the evaluation stopped after the hard constraints
+
+    FitnessPair();
 
     /**
-     * Sorts the objects by fitness.
+     * Stores the fitness of the individual with the index.
+     */
+    FitnessPair(int individual_index, const fitness_t& fitness);
+
+    /**
+     * Whether the soft constraints were evaluated.
+     */
+    bool is_complete() const;
+
+    /**
+     * Sorts the objects lexicographically by the number of hard violations (fewer is better), then the soft fitness.
+     * Ties are broken by the individual index, so the order does not depend on the sorting algorithm.
      * SORTS DESCENDING (best is first).
      */
     static bool compare_fitness(const FitnessPair& a, const FitnessPair& b);
+
+    /**
+     * With early exit, whether an individual with more hard violations than the best one was evaluated completely
+     * depends on the order of the evaluation. This marks all of them as incomplete, so that they are ranked
+     * by their hard violations only, whichever process evaluated them and in which order.
+     */
+    static void settle_early_exit(std::vector<FitnessPair>& fitnesses);
 };
 
 /**
  * See the similar section in import.h
  */
+#if !THREADS_ONLY
 namespace boost {
     namespace mpi {
         template <>
         struct is_mpi_datatype<FitnessPair> : boost::mpl::true_ { };
     }
 }
+#endif
 
 #endif //INCLUDE_FITNESS_H
@@ -0,0 +1,48 @@
+#include "local_search.h"
+#include "../performance.h"
+
+#include <iterator>
+
+// the mutation types of the moves: day and hour change, classroom change and TA swap
+static const int SINGLE_BLOCK_MOVES[] = {3, 0, 5};
+
+LocalSearch::LocalSearch(MutationCore& mutation, std::shared_ptr<FitnessCore>& fitness_core) : mutation(mutation) {
+    this->fitness_core = fitness_core;
+
+    // and the compound moves the mutation picks
+    this->move_mutations = std::vector<int>(std::begin(SINGLE_BLOCK_MOVES), std::end(SINGLE_BLOCK_MOVES));
+    for (int type = MutationCore::SINGLE_BLOCK_MUTATION_TYPES; type < MutationCore::MUTATION_TYPES; type++) {
+        if (mutation.get_mutation_weight(type) > 0) {
+            this->move_mutations.push_back(type);
+        }
+    }
+    this->move_distribution = std::uniform_int_distribution<int>(0, (int) this->move_mutations.size() - 1);
+}
+
+std::shared_ptr<Timetable> LocalSearch::improve(std::shared_ptr<Timetable>& individual, int moves) {
+    static const int probe = PerformanceBenchmark::probe("Local search", false);
+    ScopedTimer timer(probe);
+
+    std::shared_ptr<Timetable> current = individual;
+    fitness_t current_fitness = this->fitness_core->calculate_fitness(current);
+    for (int i = 0; i < moves; i++) {
+        int move_type = this->move_distribution(this->mutation.get_random_engine());
+        std::shared_ptr<Timetable> candidate = this->mutation.perform_mutation(current, this->move_mutations[move_type]);
+
+        // a candidate with more hard violations is worse whatever its soft constraints are
+        fitness_t candidate_fitness = this->fitness_core->calculate_fitness(candidate, current_fitness.hard_violations());
+        this->counts.moves++;
+        if (current_fitness < candidate_fitness) {
+            current = candidate;
+            current_fitness = candidate_fitness;
+            this->counts.improvements++;
+        }
+    }
+    return current;
+}
+
+LocalSearch::Counts LocalSearch::take_counts() {
+    Counts result = this->counts;
+    this->counts = Counts();
+    return result;
+}
@@ -0,0 +1,55 @@
+#ifndef INCLUDE_LOCAL_SEARCH_H
+#define INCLUDE_LOCAL_SEARCH_H
+
+#include "../timetable.h"
+#include "fitness.h"
+#include "mutation.h"
+
+#include <memory>
+#include <random>
+#include <vector>
+
+/**
+ * The memetic stage: a bounded first-improvement hill climb on an individual.
+ * The moves are the mutations that move a block to another slot, another classroom or change a TA, and the compound
+ * moves (slot swaps, Kempe chains and room swaps) that have a mutation weight. Each of them is evaluated incrementally: the mutated copy keeps
+ * the occupancy index and the local fitness terms of the other subjects, and a move that adds hard violations is rejected as soon as the hard constraints are known.
+ * The random state is the mutation's, so checkpoints cover it.
+ */
+class LocalSearch {
+public:
+    /**
+     * The number of moves tried and accepted since the previous take_counts.
+     */
+    struct Counts {
+        long moves = 0;
+        long improvements = 0;
+    };
+
+private:
+    MutationCore& mutation;
+    std::shared_ptr<FitnessCore> fitness_core;
+    std::vector<int> move_mutations;
+    std::uniform_int_distribution<int> move_distribution;
+    Counts counts;
+
+public:
+    /**
+     * The mutation's weights have to be set before, they decide which compound moves are tried.
+     */
+    LocalSearch(MutationCore& mutation, std::shared_ptr<FitnessCore>& fitness_core);
+
+    /**
+     * Tries the given number of random moves, starting from the individual and continuing from every move that
+     * improves the fitness (fitness_t ordering). Returns the last improvement, or the individual if there was none.
+     * Like the other operators, this doesn't change the individual.
+     */
+    std::shared_ptr<Timetable> improve(std::shared_ptr<Timetable>& individual, int moves);
+
+    /**
+     * Returns the counts since the previous call and resets them.
+     */
+    Counts take_counts();
+};
+
+#endif //INCLUDE_LOCAL_SEARCH_H
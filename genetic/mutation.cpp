@@ -1,5 +1,9 @@
 #include "mutation.h"
 #include "../utils.h"
+#include "../performance.h"
+
+#include <algorithm>
+#include <iostream>
 
 inline timetable_classroom_t MutationCore::get_random_lecture_classroom(timetable_subject_t subject_id) {
     return this->subject_lecture_classrooms[subject_id][this->subject_lecture_classroom_distributions[subject_id](this->rand)];
@@ -9,17 +13,22 @@ inline timetable_classroom_t MutationCore::get_random_tutorial_classroom(timetab
     return this->subject_tutorial_classrooms[subject_id][this->subject_tutorial_classroom_distributions[subject_id](this->rand)];
 }
 
+inline timetable_hour_t MutationCore::get_random_start_hour(timetable_hour_t duration) {
+    typedef std::uniform_int_distribution<timetable_hour_t>::param_type range;
+    return this->hour_distribution(this->rand, range((timetable_hour_t) this->min_hour, (timetable_hour_t) (this->max_hour - duration + 1)));
+}
+
 MutationCore::MutationCore(timetable_hour_t min_hour, timetable_hour_t max_hour, timetable_day_t min_day, timetable_day_t max_day, std::vector<import::Subject>& imported_subjects) {
     this->min_hour = min_hour;
     this->max_hour = max_hour;
     this->min_day = min_day;
     this->max_day = max_day;
-    this->imported_subjects = std::shared_ptr<std::vector<import::Subject>>(&imported_subjects);
+    this->imported_subjects = std::shared_ptr<std::vector<import::Subject>>(new std::vector<import::Subject>(imported_subjects));
     this->subject_lecture_classrooms = std::map<timetable_subject_t, std::vector<timetable_classroom_t>>();
     this->subject_tutorial_classrooms = std::map<timetable_subject_t, std::vector<timetable_classroom_t >>();
 
     this->rand = std::mt19937(utils::get_random_seed());
-    this->mutation_point_distribution = std::uniform_int_distribution<int>(0, 5);
+    set_mutation_weights(std::vector<double>());
     this->day_distribution = std::uniform_int_distribution<timetable_day_t>((timetable_day_t) this->min_day, (timetable_day_t) this->max_day);
     this->hour_distribution = std::uniform_int_distribution<timetable_hour_t>((timetable_hour_t) this->min_hour, (timetable_hour_t) this->max_hour);
     this->zero_one_distribution = std::uniform_real_distribution<double>(0, 1);
@@ -35,199 +44,202 @@ MutationCore::MutationCore(timetable_hour_t min_hour, timetable_hour_t max_hour,
     }
 }
 
+bool MutationCore::conflicting(const TimetableEntry& a, const TimetableEntry& b) const {
+    if (a.classroom == b.classroom || a.subject == b.subject || this->subject_conflicts.shared(a.subject, b.subject) > 0) {
+        return true;
+    }
+    for (timetable_professor_t professor : a.professors) {
+        if (b.professors.count(professor) > 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+bool MutationCore::suits(const TimetableEntry& entry, timetable_classroom_t classroom) {
+    std::vector<timetable_classroom_t>& classrooms = entry.lectures ? this->subject_lecture_classrooms[entry.subject]
+                                                                    : this->subject_tutorial_classrooms[entry.subject];
+    if (std::find(classrooms.begin(), classrooms.end(), classroom) == classrooms.end()) {
+        return false;
+    }
+
+    auto capacity = this->classroom_capacities.find(classroom);
+    return capacity == this->classroom_capacities.end()
+           || entry.students.size() <= (entry.lectures ? capacity->second.first : capacity->second.second);
+}
+
+void MutationCore::slot_band(Timetable& result, timetable_day_t day, timetable_day_t other_day, int start, int end, int excluded, std::vector<int> (&sides)[2]) {
+    bool widened = true;
+    while (widened) {
+        widened = false;
+        sides[0].clear();
+        sides[1].clear();
+        for (int i = 0; i < (int) result.timetable_entries.size(); i++) {
+            TimetableEntry& te = *result.timetable_entries[i];
+            if (i == excluded || (te.day != day && te.day != other_day) || te.hour >= end || te.hour + te.duration <= start) {
+                continue;
+            }
+            sides[te.day == day ? 0 : 1].push_back(i);
+            if (te.hour < start || te.hour + te.duration > end) {
+                start = std::min(start, (int) te.hour);
+                end = std::max(end, te.hour + te.duration);
+                widened = true;
+            }
+        }
+    }
+}
+
+void MutationCore::move_block(Timetable& result, int index, timetable_day_t day, std::vector<int>& moved) {
+    TimetableEntry& entry = *result.timetable_entries[index];
+    if (result.occupancy != nullptr) {
+        result.occupancy->remove(entry);
+    }
+    entry.day = day;
+    if (result.occupancy != nullptr) {
+        result.occupancy->add(entry);
+    }
+    moved.push_back(index);
+}
+
+void MutationCore::set_mutation_weights(const std::vector<double>& weights) {
+    if (weights.size() > MUTATION_TYPES) {
+        std::cerr << "Expected at most " << MUTATION_TYPES << " mutation weights, got " << weights.size() << ". " << std::endl;
+        throw std::exception();
+    }
+
+    // the types without a weight keep their default one
+    this->mutation_weights = std::vector<double>(MUTATION_TYPES, 0.0);
+    std::fill(this->mutation_weights.begin(), this->mutation_weights.begin() + SINGLE_BLOCK_MUTATION_TYPES, 1.0);
+    std::copy(weights.begin(), weights.end(), this->mutation_weights.begin());
+    this->mutation_type_distribution = std::discrete_distribution<int>(this->mutation_weights.begin(), this->mutation_weights.end());
+
+    // without weights, the types are drawn exactly as before there were compound moves, so seeded runs repeat
+    this->weighted_mutation_types = !weights.empty();
+    this->single_block_mutation_distribution = std::uniform_int_distribution<int>(0, SINGLE_BLOCK_MUTATION_TYPES - 1);
+}
+
+double MutationCore::get_mutation_weight(int mutation_type) const {
+    return this->mutation_weights[mutation_type];
+}
+
+void MutationCore::set_subject_conflicts(const import::SubjectConflicts& conflicts) {
+    this->subject_conflicts = conflicts;
+}
+
+void MutationCore::set_classrooms(std::map<int, import::Classroom>& classrooms) {
+    this->classroom_capacities.clear();
+    for (auto& c : classrooms) {
+        this->classroom_capacities[c.first] = std::make_pair(c.second.lecture_capacity, c.second.tutorial_capacity);
+    }
+}
+
+int MutationCore::random_mutation_type() {
+    return this->weighted_mutation_types ? this->mutation_type_distribution(this->rand)
+                                         : this->single_block_mutation_distribution(this->rand);
+}
+
+std::mt19937& MutationCore::get_random_engine() {
+    return this->rand;
+}
+
+const int MutationCore::MUTATION_TYPES;
+const int MutationCore::SINGLE_BLOCK_MUTATION_TYPES;
+
+const char* MutationCore::mutation_name(int mutation_type) {
+    static const char* names[MUTATION_TYPES] = {
+            "classroom change", "day change", "hour change", "day and hour change", "student shuffle", "TA swap",
+            "slot swap", "Kempe chain", "room swap"
+    };
+    return mutation_type >= 0 && mutation_type < MUTATION_TYPES ? names[mutation_type] : "unknown";
+}
+
 std::shared_ptr<Timetable> MutationCore::perform_mutation(std::shared_ptr<Timetable>& parent) {
+    return perform_mutation(parent, random_mutation_type());
+}
+
+std::shared_ptr<Timetable> MutationCore::perform_mutation(std::shared_ptr<Timetable>& parent, int mutation_type) {
+    int entry_index;
+    return perform_mutation(parent, mutation_type, entry_index);
+}
+
+std::shared_ptr<Timetable> MutationCore::perform_mutation(std::shared_ptr<Timetable>& parent, int mutation_type, int& entry_index) {
+    static const int probe = PerformanceBenchmark::probe("Mutation", false);
+    ScopedTimer timer(probe);
+
     // the initial data is a clone, then we modify it
     std::shared_ptr<Timetable> result = parent->clone();
 
     // this is supposed to be lightweight enough
-    int entry_index = std::uniform_int_distribution<int>(0, (int) (result->timetable_entries.size() - 1))(rand);
+    entry_index = std::uniform_int_distribution<int>(0, (int) (result->timetable_entries.size() - 1))(rand);
 
-    int mutation_type = mutation_point_distribution(rand);
     std::shared_ptr<TimetableEntry>& entry = result->timetable_entries[entry_index];
+
+    // the entry is taken out of the occupancy index while it changes, so it doesn't see itself as occupying its slots
+    OccupancyIndex* occupancy = result->occupancy.get();
+    if (occupancy != nullptr) {
+        occupancy->remove(*entry);
+    }
+
+    // the other blocks changed by compound moves, which keep the occupancy index up to date themselves
+    std::vector<int> moved;
+
     switch (mutation_type) {
         case 0: { // classroom change (lecture or tutorial, depending on the type)
-            // regardless of the type, all entries that match this one and are attached to it are changed
-            // as this makes the most sense domain-wise
+            // the whole block moves, as this makes the most sense domain-wise
+            // with an occupancy index, a classroom that is free during the block is preferred
+            std::vector<timetable_classroom_t>& candidates = entry->lectures ? this->subject_lecture_classrooms[entry->subject]
+                                                                            : this->subject_tutorial_classrooms[entry->subject];
+            if (occupancy != nullptr && occupancy->random_free_classroom(candidates, entry->day, entry->hour, entry->duration, rand, entry->classroom)) {
+                break;
+            }
             if (entry->lectures) {
-                timetable_classroom_t new_classroom = get_random_lecture_classroom(entry->subject);
-                for (std::shared_ptr<TimetableEntry>& e : result->timetable_entries) {
-                    // for lectures, we change all lecture entries for the same subject within 2 hours of eachother
-                    if (e->is_matching_lecture(entry)) {
-                        e->classroom = new_classroom;
-                    }
-                }
-                entry->classroom = new_classroom;
+                entry->classroom = get_random_lecture_classroom(entry->subject);
             } else {
-                timetable_classroom_t new_classroom = get_random_tutorial_classroom(entry->subject);
-                bool tutorial_found = false;
-                for (std::shared_ptr<TimetableEntry>& e : result->timetable_entries) {
-                    // for lectures, we change all lecture entries for the same subject within 2 hours of eachother
-                    if (e->is_matching_tutorial(entry)) {
-                        e->classroom = new_classroom;
-                        tutorial_found = true;
-                        break;
-                    }
-                }
-                entry->classroom = new_classroom;
-
-                if (!tutorial_found) {
-                    std::cerr << "Matching tutorial not found (classroom mutation). " << std::endl;
-                    return nullptr;
-                }
+                entry->classroom = get_random_tutorial_classroom(entry->subject);
             }
             break;
         }
         case 1: { // day change
-            // if the entry is a tutorial, also change the matching tutorial entry's time
-            // don't bother checking if the other entry's time is valid (not too soon, not too late)
-            // as this is checked by the fitness function
-            timetable_day_t new_day = day_distribution(rand);
-
-
-            // only mutate matching if it's a tutorial
-            if (!entry->lectures) {
-                bool tutorial_found = false;
-                for (std::shared_ptr<TimetableEntry>& e : result->timetable_entries) {
-                    if (e->is_matching_tutorial(entry)) {
-                        e->day = new_day;
-                        tutorial_found = true;
-                        break;
-                    }
-                }
-
-                if (!tutorial_found) {
-                    std::cerr << "Matching tutorial not found (day mutation). " << std::endl;
-                    return nullptr;
-                }
-            }
-
-            entry->day = new_day;
-
+            entry->day = day_distribution(rand);
             break;
         }
         case 2: { // hour change
-            // see day comment
-            timetable_hour_t new_hour = hour_distribution(rand);
-
-            // only mutate matching if it's a tutorial
-            if (!entry->lectures) {
-                bool tutorial_found = false;
-                for (std::shared_ptr<TimetableEntry>& e : result->timetable_entries) {
-                    if (e->is_matching_tutorial(entry)) {
-                        if (e->hour < entry->hour) {
-                            e->hour = (timetable_hour_t) (new_hour - 1);
-                        } else {
-                            e->hour = (timetable_hour_t) (new_hour + 1);
-                        }
-                        tutorial_found = true;
-                        break;
-                    }
-                }
-
-                if (!tutorial_found) {
-                    std::cerr << "Matching tutorial not found (hour mutation). " << std::endl;
-                    return nullptr;
-                }
-            }
-
-            entry->hour = new_hour;
+            // the block always ends within the day
+            entry->hour = get_random_start_hour(entry->duration);
             break;
         }
         case 3: { // day and hour change
-            // see day comment
-            timetable_day_t new_day = day_distribution(rand);
-            timetable_hour_t new_hour = hour_distribution(rand);
-
-            // only mutate matching if it's a tutorial
-            if (!entry->lectures) {
-                bool tutorial_found = false;
-                for (std::shared_ptr<TimetableEntry>& e : result->timetable_entries) {
-                    if (e->is_matching_tutorial(entry)) {
-                        e->day = new_day;
-                        if (e->hour < entry->hour) {
-                            e->hour = (timetable_hour_t) (new_hour - 1);
-                        } else {
-                            e->hour = (timetable_hour_t) (new_hour + 1);
-                        }
-                        tutorial_found = true;
-                        break;
-                    }
-                }
-
-                if (!tutorial_found) {
-                    std::cerr << "Matching tutorial not found (day and hour mutation). " << std::endl;
-                    return nullptr;
-                }
+            // with an occupancy index, a slot in which the classroom is free is preferred
+            if (occupancy != nullptr && occupancy->random_free_start(entry->classroom, entry->duration, rand, entry->day, entry->hour)) {
+                break;
             }
-
-            entry->day = new_day;
-            entry->hour = new_hour;
+            entry->day = day_distribution(rand);
+            entry->hour = get_random_start_hour(entry->duration);
             break;
         }
-        case 4: { // shuffle students of two same-subject entries
+        case 4: { // shuffle students of two same-subject tutorial groups
             // don't do anything on lectures
             if (entry->lectures) {
                 break;
             }
 
-            // check if we can even swap (if there is more than one pair of tutorials)
+            // the other groups of the subject
             std::vector<int> tutorial_indices = std::vector<int>();
             int te_index = 0;
             for (auto& te : result->timetable_entries) {
-                if (!te->lectures && te->subject == entry->subject) {
+                if (!te->lectures && te->subject == entry->subject && te_index != entry_index) {
                     tutorial_indices.push_back(te_index);
                 }
                 te_index++;
             }
 
-            // we need at least 4 tutorials (two pairs)
-            if (tutorial_indices.size() < 4) {
+            // we need at least two groups
+            if (tutorial_indices.empty()) {
                 break;
             }
 
-            // get the matching pair for the original entry
-            std::shared_ptr<TimetableEntry> entry_matching;
-            bool entry_matching_found = false;
-            for (std::shared_ptr<TimetableEntry>& e : result->timetable_entries) {
-                if (e->is_matching_tutorial(entry)) {
-                    entry_matching = e;
-                    entry_matching_found = true;
-                    break;
-                }
-            }
-            if (!entry_matching_found) {
-                std::cerr << "Matching entry not found (student mutation). " << std::endl;
-                return nullptr;
-            }
-
-            // remove the entry and its matching entry
-            // this way only valid matches are left
-            auto new_end = std::remove_if(tutorial_indices.begin(),
-                                          tutorial_indices.end(),
-                                          [&result, &entry](int idx) {
-                                              std::shared_ptr<TimetableEntry>& te = result->timetable_entries[idx];
-                                              return te->classroom == entry->classroom
-                                                  && te->students == entry->students;
-                                          }
-            );
-            tutorial_indices.erase(new_end, tutorial_indices.end());
-
-
             int other_index = tutorial_indices[std::uniform_int_distribution<int>(0, (int) (tutorial_indices.size() - 1))(rand)];
             std::shared_ptr<TimetableEntry>& other = result->timetable_entries[other_index];
-            std::shared_ptr<TimetableEntry> other_matching;
-            bool other_matching_found = false;
-            for (std::shared_ptr<TimetableEntry>& e : result->timetable_entries) {
-                if (e->is_matching_tutorial(other)) {
-                    other_matching = e;
-                    other_matching_found = true;
-                    break;
-                }
-            }
-            if (!other_matching_found) {
-                std::cerr << "Matching other entry not found (student mutation). " << std::endl;
-                return nullptr;
-            }
 
             // shuffle the students
             int entry_student_count = (int) entry->students.size();
@@ -237,15 +249,11 @@ std::shared_ptr<Timetable> MutationCore::perform_mutation(std::shared_ptr<Timeta
             std::shuffle(merged_students.begin(), merged_students.end(), rand);
 
             entry->students.clear();
-            entry_matching->students.clear();
             other->students.clear();
-            other_matching->students.clear();
 
             // redistribute with the same numbers as before
             entry->students.insert(merged_students.begin(), merged_students.begin() + entry_student_count);
-            entry_matching->students.insert(merged_students.begin(), merged_students.begin() + entry_student_count);
             other->students.insert(merged_students.begin() + entry_student_count, merged_students.end());
-            other_matching->students.insert(merged_students.begin() + entry_student_count, merged_students.end());
 
             break;
         }
@@ -291,21 +299,6 @@ std::shared_ptr<Timetable> MutationCore::perform_mutation(std::shared_ptr<Timeta
             if (entry->professors.count(new_ta) == 1) {
                 break;
             } else {
-                // get the matching entry
-                bool matching_found = false;
-                std::shared_ptr<TimetableEntry> match;
-                for (std::shared_ptr<TimetableEntry>& e : result->timetable_entries) {
-                    if (entry->is_matching_tutorial(e)) {
-                        matching_found = true;
-                        match = e;
-                        break;
-                    }
-                }
-                if (!matching_found) {
-                    std::cerr << "No matching entry found (TA mutation). " << std::endl;
-                    return nullptr;
-                }
-
                 // choose which TA to swap
                 int swap_index = std::uniform_int_distribution<int>(0, (int) (entry->professors.size() - 1))(rand);
 
@@ -317,17 +310,124 @@ std::shared_ptr<Timetable> MutationCore::perform_mutation(std::shared_ptr<Timeta
                 timetable_professor_t element = *entry_it;
 
                 entry->professors.erase(element);
-                match->professors.erase(element);
                 entry->professors.insert(new_ta);
-                match->professors.insert(new_ta);
             }
             break;
         }
+        case 6: { // slot swap
+            // the blocks of the entry's day and another day trade days in a band of hours around the entry,
+            // which is widened until no block of either day crosses its edges, so the moved blocks keep their hours
+            // and only meet each other, as before
+            timetable_day_t day = day_distribution(rand);
+            if (day == entry->day) {
+                break;
+            }
+
+            std::vector<int> sides[2];
+            slot_band(*result, entry->day, day, entry->hour, entry->hour + entry->duration, entry_index, sides);
+            for (int i : sides[0]) {
+                move_block(*result, i, day, moved);
+            }
+            for (int i : sides[1]) {
+                move_block(*result, i, entry->day, moved);
+            }
+            entry->day = day;
+            break;
+        }
+        case 7: { // Kempe chain
+            // the entry moves to another day, the blocks there that overlap and conflict with it move to its day,
+            // then the blocks of its day that overlap and conflict with those, and so on, all keeping their hours,
+            // so the chain doesn't add a conflict
+            timetable_day_t day = day_distribution(rand);
+            if (day == entry->day) {
+                break;
+            }
+
+            // the blocks of the two days that are not in the chain yet
+            std::vector<int> sides[2];
+            for (int i = 0; i < (int) result->timetable_entries.size(); i++) {
+                TimetableEntry& te = *result->timetable_entries[i];
+                if (i != entry_index && (te.day == entry->day || te.day == day)) {
+                    sides[te.day == day ? 1 : 0].push_back(i);
+                }
+            }
+
+            // breadth first, every block of the chain pulls the conflicting blocks of the other day
+            std::vector<std::pair<int, int>> chain = {std::make_pair(entry_index, 0)};
+            for (size_t c = 0; c < chain.size(); c++) {
+                const TimetableEntry& link = *result->timetable_entries[chain[c].first];
+                std::vector<int>& other_side = sides[1 - chain[c].second];
+                for (size_t i = 0; i < other_side.size(); ) {
+                    const TimetableEntry& te = *result->timetable_entries[other_side[i]];
+                    if (te.hour < link.hour + link.duration && link.hour < te.hour + te.duration && conflicting(link, te)) {
+                        chain.push_back(std::make_pair(other_side[i], 1 - chain[c].second));
+                        other_side[i] = other_side.back();
+                        other_side.pop_back();
+                    } else {
+                        i++;
+                    }
+                }
+            }
+
+            timetable_day_t entry_day = entry->day;
+            for (size_t c = 1; c < chain.size(); c++) {
+                move_block(*result, chain[c].first, chain[c].second == 0 ? day : entry_day, moved);
+            }
+            entry->day = day;
+            break;
+        }
+        case 8: { // room swap
+            // the entry trades classrooms with a block taking place at the same time, if each classroom suits
+            // the other block (and holds its students), so the occupied classrooms stay the same
+            std::vector<int> candidates;
+            for (int i = 0; i < (int) result->timetable_entries.size(); i++) {
+                TimetableEntry& te = *result->timetable_entries[i];
+                if (i != entry_index && te.day == entry->day && te.hour == entry->hour && te.duration == entry->duration
+                    && te.classroom != entry->classroom && suits(*entry, te.classroom) && suits(te, entry->classroom)) {
+                    candidates.push_back(i);
+                }
+            }
+            if (candidates.empty()) {
+                break;
+            }
+
+            int other_index = candidates[std::uniform_int_distribution<int>(0, (int) (candidates.size() - 1))(rand)];
+            TimetableEntry& other = *result->timetable_entries[other_index];
+            if (occupancy != nullptr) {
+                occupancy->remove(other);
+            }
+            std::swap(entry->classroom, other.classroom);
+            if (occupancy != nullptr) {
+                occupancy->add(other);
+            }
+            moved.push_back(other_index);
+            break;
+        }
         default:
             std::cerr << "invalid mutation type (" << mutation_type << ")" << std::endl;
             throw std::exception();
     }
 
+    if (occupancy != nullptr) {
+        occupancy->add(*entry);
+    }
+
+    // the local fitness terms of the subjects that didn't change still hold
+    if (parent->fitness_terms != nullptr) {
+        result->fitness_terms = std::shared_ptr<FitnessTerms>(new FitnessTerms(*parent->fitness_terms));
+        result->fitness_terms->has_fitness = false;
+        FitnessTerms::known_t& known_subjects = result->fitness_terms->known_subjects;
+        if (entry->subject < known_subjects.size()) {
+            known_subjects[entry->subject] = false;
+        }
+        for (int i : moved) {
+            timetable_subject_t subject = result->timetable_entries[i]->subject;
+            if (subject < known_subjects.size()) {
+                known_subjects[subject] = false;
+            }
+        }
+    }
+
     result->sorted = false;
     return result;
 }
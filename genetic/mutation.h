@@ -17,9 +17,18 @@ private:
     std::map<timetable_subject_t, std::vector<timetable_classroom_t>> subject_lecture_classrooms;
     std::map<timetable_subject_t, std::vector<timetable_classroom_t>> subject_tutorial_classrooms;
 
+    // the conflict graph of the Kempe chain moves, besides shared classrooms, subjects and professors
+    import::SubjectConflicts subject_conflicts;
+
+    // the lecture and tutorial capacity of each classroom, checked by room swaps if known
+    std::map<timetable_classroom_t, std::pair<unsigned int, unsigned int>> classroom_capacities;
+
     // utilities
     std::mt19937 rand;
-    std::uniform_int_distribution<int> mutation_point_distribution;
+    std::vector<double> mutation_weights;
+    bool weighted_mutation_types;
+    std::discrete_distribution<int> mutation_type_distribution;
+    std::uniform_int_distribution<int> single_block_mutation_distribution;
     std::uniform_int_distribution<timetable_day_t> day_distribution;
     std::uniform_int_distribution<timetable_hour_t> hour_distribution;
     std::uniform_real_distribution<double> zero_one_distribution;
@@ -35,14 +44,95 @@ private:
     inline timetable_classroom_t get_random_lecture_classroom(timetable_subject_t subject_id);
     inline timetable_classroom_t get_random_tutorial_classroom(timetable_subject_t subject_id);
 
+    /**
+     * Get a random start hour for a block of the given duration, so the block ends within the allowed hours.
+     */
+    inline timetable_hour_t get_random_start_hour(timetable_hour_t duration);
+
+    /**
+     * Whether the two blocks can't take place at the same time: they are in the same classroom, of the same subject,
+     * share a professor or their subjects share students.
+     */
+    bool conflicting(const TimetableEntry& a, const TimetableEntry& b) const;
+
+    /**
+     * Whether the classroom suits the block's subject and type, and holds its students if the capacities are known.
+     */
+    bool suits(const TimetableEntry& entry, timetable_classroom_t classroom);
+
+    /**
+     * Adds the indices of the blocks of the two days that overlap the hours from start to end (exclusive), except
+     * the excluded one, to the sides of their days. The hours are widened until no block crosses their edges.
+     */
+    static void slot_band(Timetable& result, timetable_day_t day, timetable_day_t other_day, int start, int end, int excluded, std::vector<int> (&sides)[2]);
+
+    /**
+     * Moves a block of the result to the day, keeping the occupancy index up to date, and records its index.
+     */
+    void move_block(Timetable& result, int index, timetable_day_t day, std::vector<int>& moved);
+
 public:
+    static const int MUTATION_TYPES = 9;
+
+    // the original mutation types come first, the compound moves (slot swap, Kempe chain and room swap) after them
+    static const int SINGLE_BLOCK_MUTATION_TYPES = 6;
+
     MutationCore(timetable_hour_t min_hour, timetable_hour_t max_hour, timetable_day_t min_day, timetable_day_t max_day, std::vector<import::Subject>& imported_subjects);
 
+    /**
+     * Sets the relative probabilities of the mutation types picked by perform_mutation, in the order of the types.
+     * The types without a weight keep their default: 1 for the single block types and 0 for the compound moves,
+     * so by default the compound moves are not picked and an empty vector keeps the original uniform choice.
+     */
+    void set_mutation_weights(const std::vector<double>& weights);
+
+    double get_mutation_weight(int mutation_type) const;
+
+    /**
+     * Sets the subject conflict matrix, the Kempe chains then also follow the conflicts of shared students.
+     */
+    void set_subject_conflicts(const import::SubjectConflicts& conflicts);
+
+    /**
+     * Sets the classrooms, room swaps then only move blocks to classrooms that hold their students.
+     */
+    void set_classrooms(std::map<int, import::Classroom>& classrooms);
+
+    /**
+     * A mutation type, picked by the weights.
+     */
+    int random_mutation_type();
+
     /**
      * Performs a random mutation operation and returns a new object.
-     * Will perform a mutation if no error is found. If an error is found, returns nullptr.
+     * Blocks are moved as a whole, so the result keeps every lecture block and double cycle intact.
+     * The occupancy index of an indexed parent is cloned and kept up to date, classroom changes and day and hour
+     * changes then prefer classrooms and slots that are free.
+     * The result takes the cached local fitness terms of an evaluated parent, except those of the mutated subjects.
+     * Besides the moves of a single block, there are compound moves that keep more of the timetable's structure:
+     * a slot swap exchanges the blocks of two days in a band of hours, a Kempe chain moves a block to another day along
+     * with the blocks it overlaps and conflicts with, transitively between the two days, and a room swap exchanges
+     * the classrooms of two concurrent blocks.
      */
     std::shared_ptr<Timetable> perform_mutation(std::shared_ptr<Timetable>& parent);
+
+    /**
+     * Performs a mutation of the given type (between 0 and MUTATION_TYPES - 1), e.g. to measure it on its own.
+     */
+    std::shared_ptr<Timetable> perform_mutation(std::shared_ptr<Timetable>& parent, int mutation_type);
+
+    /**
+     * Performs a mutation of the given type and stores the index of the mutated entry, which is at the same index
+     * in the parent (the entries are in the parent's order). Compound moves change other entries as well.
+     */
+    std::shared_ptr<Timetable> perform_mutation(std::shared_ptr<Timetable>& parent, int mutation_type, int& entry_index);
+
+    static const char* mutation_name(int mutation_type);
+
+    /**
+     * The random state, exposed for checkpointing.
+     */
+    std::mt19937& get_random_engine();
 };
 
 
@@ -1,11 +1,18 @@
 #include "selection.h"
 
+#include <algorithm>
+#include <iostream>
+
 TournamentSelection::TournamentSelection(int expected_survivors) {
     this->expected_survivors = expected_survivors;
 
     this->rand = std::mt19937(utils::get_random_seed());
 }
 
+std::mt19937& TournamentSelection::get_random_engine() {
+    return this->rand;
+}
+
 std::vector<int> TournamentSelection::perform_selection(std::vector<FitnessPair>& fitnesses) {
     unsigned long population_size = fitnesses.size();
 
@@ -29,9 +29,15 @@ public:
 
     /**
      * Performs selection on a map of index->fitness.
+     * Individuals are ranked lexicographically, by their hard violations and then their soft fitness.
      * Returns a vector of survivor identifiers.
      */
     std::vector<int> perform_selection(std::vector<FitnessPair>& fitnesses);
+
+    /**
+     * The random state, exposed for checkpointing.
+     */
+    std::mt19937& get_random_engine();
 };
 
 #endif //INCLUDE_SELECTION_H
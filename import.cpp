@@ -1,7 +1,26 @@
 #include "import.h"
 #include "tinyxml2/tinyxml2.h"
 
+#include <boost/archive/binary_oarchive.hpp>
+#include <boost/archive/binary_iarchive.hpp>
+
 #include <fstream>
+#include <iostream>
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+/**
+ * Converts an imported ID to the configured ID type, refusing IDs that do not fit instead of truncating them.
+ */
+template <typename T>
+static T checked_id(int id, const char *entity) {
+    if (id < 0 || (unsigned long) id > (unsigned long) std::numeric_limits<T>::max()) {
+        std::cerr << "The " << entity << " ID " << id << " does not fit the configured ID width (see TIMETABLE_WIDE_IDS). " << std::endl;
+        throw std::exception();
+    }
+    return (T) id;
+}
 
 std::map<int, import::Professor> import::Professor::import_professors(std::string& file_path) {
     std::map<int, import::Professor> result = std::map<int, import::Professor>();
@@ -13,7 +32,7 @@ std::map<int, import::Professor> import::Professor::import_professors(std::strin
 
     for (auto *professor = root->FirstChildElement(); professor; professor = professor->NextSiblingElement()) {
         import::Professor prof = import::Professor();
-        timetable_professor_t id = (timetable_professor_t) professor->IntAttribute("id");
+        timetable_professor_t id = checked_id<timetable_professor_t>(professor->IntAttribute("id"), "professor");
         prof.id = id;
 
         auto *name = professor->FirstChildElement();
@@ -38,7 +57,7 @@ std::map<int, import::Classroom> import::Classroom::import_classrooms(std::strin
 
     for (auto *classroom = root->FirstChildElement(); classroom; classroom = classroom->NextSiblingElement()) {
         import::Classroom clrm = import::Classroom();
-        timetable_classroom_t id = (timetable_classroom_t) classroom->IntAttribute("id");
+        timetable_classroom_t id = checked_id<timetable_classroom_t>(classroom->IntAttribute("id"), "classroom");
         clrm.id = id;
 
         auto *lecture_capacity = classroom->FirstChildElement();
@@ -63,31 +82,31 @@ std::map<int, import::Subject> import::Subject::import_subjects(std::string& fil
 
     for (auto *subject = root->FirstChildElement(); subject; subject = subject->NextSiblingElement()) {
         import::Subject subj = import::Subject();
-        timetable_subject_t id = (timetable_subject_t) subject->IntAttribute("id");
+        timetable_subject_t id = checked_id<timetable_subject_t>(subject->IntAttribute("id"), "subject");
         subj.id = id;
 
         auto *lecture_classrooms_container = subject->FirstChildElement();
         for (auto *id_container = lecture_classrooms_container->FirstChildElement(); id_container; id_container = id_container->NextSiblingElement()) {
-            timetable_classroom_t classroom_id = (timetable_classroom_t) atoi(id_container->GetText());
+            timetable_classroom_t classroom_id = checked_id<timetable_classroom_t>(atoi(id_container->GetText()), "classroom");
             subj.lecture_classrooms.push_back(classroom_id);
         }
 
         auto *tutorial_classrooms_container = lecture_classrooms_container->NextSiblingElement();
         for (auto *id_container = tutorial_classrooms_container->FirstChildElement(); id_container; id_container = id_container->NextSiblingElement()) {
-            timetable_classroom_t classroom_id = (timetable_classroom_t) atoi(id_container->GetText());
+            timetable_classroom_t classroom_id = checked_id<timetable_classroom_t>(atoi(id_container->GetText()), "classroom");
             subj.tutorial_classrooms.push_back(classroom_id);
         }
 
         auto *professors_container = tutorial_classrooms_container->NextSiblingElement();
         for (auto *id_container = professors_container->FirstChildElement(); id_container; id_container = id_container->NextSiblingElement()) {
-            timetable_professor_t professor_id = (timetable_professor_t) atoi(id_container->GetText());
+            timetable_professor_t professor_id = checked_id<timetable_professor_t>(atoi(id_container->GetText()), "professor");
             subj.professors.push_back(professor_id);
         }
 
         double weight_sum = 0;
         auto *assistants_container = professors_container->NextSiblingElement();
         for (auto *id_container = assistants_container->FirstChildElement(); id_container; id_container = id_container->NextSiblingElement()) {
-            timetable_professor_t professor_id = (timetable_professor_t) atoi(id_container->GetText());
+            timetable_professor_t professor_id = checked_id<timetable_professor_t>(atoi(id_container->GetText()), "professor");
             double weight = id_container->DoubleAttribute("weight"); // returns 0 if not found, that's okay (see below)
             subj.teaching_assistants.push_back(professor_id);
             subj.teaching_assistant_weights.push_back(weight);
@@ -132,12 +151,12 @@ std::map<int, import::Student> import::Student::import_students(std::string& fil
 
     for (auto *student = root->FirstChildElement(); student; student = student->NextSiblingElement()) {
         import::Student stud = import::Student();
-        timetable_student_t id = (timetable_student_t) student->IntAttribute("id");
+        timetable_student_t id = checked_id<timetable_student_t>(student->IntAttribute("id"), "student");
         stud.id = id;
 
         auto *subjects_container = student->FirstChildElement();
         for (auto *id_container = subjects_container->FirstChildElement(); id_container; id_container = id_container->NextSiblingElement()) {
-            timetable_subject_t subject_id = (timetable_subject_t) atoi(id_container->GetText());
+            timetable_subject_t subject_id = checked_id<timetable_subject_t>(atoi(id_container->GetText()), "subject");
             stud.subjects.push_back(subject_id);
         }
 
@@ -157,3 +176,234 @@ void import::Subject::populate_students(std::map<int, import::Student> student_m
         }
     }
 }
+
+import::SubjectConflicts::SubjectConflicts() {
+    this->subject_count = 0;
+}
+
+import::SubjectConflicts::SubjectConflicts(std::map<int, import::Student>& students, std::map<int, import::Subject>& subjects) {
+    this->subject_count = 0;
+    for (auto& s : subjects) {
+        this->subject_count = std::max(this->subject_count, s.first + 1);
+    }
+    this->shared_students = std::vector<int>((unsigned long) this->subject_count * this->subject_count, 0);
+
+    for (auto& i : students) {
+        for (timetable_subject_t a : i.second.subjects) {
+            for (timetable_subject_t b : i.second.subjects) {
+                if (a < this->subject_count && b < this->subject_count) {
+                    this->shared_students[a * this->subject_count + b]++;
+                }
+            }
+        }
+    }
+}
+
+int import::SubjectConflicts::degree(int subject) const {
+    int result = 0;
+    for (int other = 0; other < this->subject_count; other++) {
+        if (other != subject && shared(subject, other) > 0) {
+            result++;
+        }
+    }
+    return result;
+}
+
+import::Problem import::Problem::import_xml(const std::string& directory) {
+    std::string professors_file = directory + "/professors.xml";
+    std::string classrooms_file = directory + "/classrooms.xml";
+    std::string students_file = directory + "/students.xml";
+    std::string subjects_file = directory + "/subjects.xml";
+
+    Problem result;
+    result.professors = Professor::import_professors(professors_file);
+    result.classrooms = Classroom::import_classrooms(classrooms_file);
+    result.students = Student::import_students(students_file);
+    result.subjects = Subject::import_subjects(subjects_file);
+    return result;
+}
+
+/**
+ * The header of the binary problem format, written before the archive.
+ */
+struct BinaryProblemHeader {
+    uint32_t magic;
+    uint32_t version;
+    // the sizes of the ID types, in bytes
+    uint8_t subject_width;
+    uint8_t classroom_width;
+    uint8_t student_width;
+    uint8_t professor_width;
+
+    static const uint32_t MAGIC = 0x42505454; // "TTPB" in a little endian file
+    static const uint32_t VERSION = 1;
+
+    /**
+     * The header of this build.
+     */
+    static BinaryProblemHeader current() {
+        BinaryProblemHeader result;
+        result.magic = MAGIC;
+        result.version = VERSION;
+        result.subject_width = sizeof(timetable_subject_t);
+        result.classroom_width = sizeof(timetable_classroom_t);
+        result.student_width = sizeof(timetable_student_t);
+        result.professor_width = sizeof(timetable_professor_t);
+        return result;
+    }
+
+    bool same_widths(const BinaryProblemHeader& other) const {
+        return this->subject_width == other.subject_width && this->classroom_width == other.classroom_width
+               && this->student_width == other.student_width && this->professor_width == other.professor_width;
+    }
+
+    void write(std::ostream& out) const {
+        out.write((const char *) &this->magic, sizeof(this->magic));
+        out.write((const char *) &this->version, sizeof(this->version));
+        out.write((const char *) &this->subject_width, sizeof(this->subject_width));
+        out.write((const char *) &this->classroom_width, sizeof(this->classroom_width));
+        out.write((const char *) &this->student_width, sizeof(this->student_width));
+        out.write((const char *) &this->professor_width, sizeof(this->professor_width));
+    }
+
+    /**
+     * Returns false if the stream ends before the header does.
+     */
+    bool read(std::istream& in) {
+        in.read((char *) &this->magic, sizeof(this->magic));
+        in.read((char *) &this->version, sizeof(this->version));
+        in.read((char *) &this->subject_width, sizeof(this->subject_width));
+        in.read((char *) &this->classroom_width, sizeof(this->classroom_width));
+        in.read((char *) &this->student_width, sizeof(this->student_width));
+        in.read((char *) &this->professor_width, sizeof(this->professor_width));
+        return (bool) in;
+    }
+};
+
+static std::string id_widths(const BinaryProblemHeader& header) {
+    return "subject " + std::to_string(header.subject_width * 8) + ", classroom " + std::to_string(header.classroom_width * 8)
+           + ", student " + std::to_string(header.student_width * 8) + ", professor " + std::to_string(header.professor_width * 8) + " bits";
+}
+
+import::Problem import::Problem::import_binary(const std::string& file_path) {
+    std::ifstream in_file(file_path, std::ios::binary);
+    if (!in_file.is_open()) {
+        std::cerr << "Could not open the problem " << file_path << ". " << std::endl;
+        throw std::exception();
+    }
+
+    BinaryProblemHeader header;
+    BinaryProblemHeader expected = BinaryProblemHeader::current();
+    if (!header.read(in_file) || header.magic != BinaryProblemHeader::MAGIC) {
+        std::cerr << "The file " << file_path << " is not a problem in the binary format (or was written before it had a header). " << std::endl;
+        throw std::exception();
+    }
+    if (header.version != BinaryProblemHeader::VERSION) {
+        std::cerr << "The problem " << file_path << " is in version " << header.version << " of the binary format, this build reads version "
+                  << BinaryProblemHeader::VERSION << ". " << std::endl;
+        throw std::exception();
+    }
+    if (!header.same_widths(expected)) {
+        std::cerr << "The problem " << file_path << " was written with other ID widths (" << id_widths(header) << ") than this build uses ("
+                  << id_widths(expected) << "), build with the same TIMETABLE_WIDE_IDS. " << std::endl;
+        throw std::exception();
+    }
+
+    Problem result;
+    try {
+        boost::archive::binary_iarchive ia(in_file);
+        ia >> result;
+    } catch (std::exception& e) {
+        std::cerr << "Could not read the problem " << file_path << ": " << e.what() << std::endl;
+        throw;
+    }
+    return result;
+}
+
+/**
+ * Opens an XML file for writing and writes the root element's start tag, with the same namespaces as the schemas.
+ */
+static void open_xml(std::ofstream& out, const std::string& file_path, const std::string& root) {
+    out.open(file_path);
+    if (!out.is_open()) {
+        std::cerr << "Could not write " << file_path << ". " << std::endl;
+        throw std::exception();
+    }
+
+    out << "<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n"
+        << "<" << root << " xmlns=\"http://stanovnik.net/ParallelTimetables\" "
+        << "xmlns:xsi=\"http://www.w3.org/2001/XMLSchema-instance\" "
+        << "xsi:schemaLocation=\"http://stanovnik.net/ParallelTimetables " << root << ".xsd\">\n";
+}
+
+template <typename T>
+static void write_ids(std::ofstream& out, const char *container, const std::vector<T>& ids) {
+    out << "        <" << container << ">\n";
+    for (T id : ids) {
+        out << "            <id>" << (long long) id << "</id>\n";
+    }
+    out << "        </" << container << ">\n";
+}
+
+void import::Problem::export_xml(const std::string& directory) const {
+    // written directly, as building a document of a large problem takes far longer than the problem itself
+    std::ofstream out;
+    open_xml(out, directory + "/professors.xml", "professors");
+    for (auto& p : this->professors) {
+        out << "    <professor id=\"" << (long long) p.second.id << "\">\n"
+            << "        <name>" << p.second.name << "</name>\n"
+            << "        <available_hours>" << p.second.available_hours << "</available_hours>\n"
+            << "    </professor>\n";
+    }
+    out << "</professors>\n";
+    out.close();
+
+    open_xml(out, directory + "/classrooms.xml", "classrooms");
+    for (auto& c : this->classrooms) {
+        out << "    <classroom id=\"" << (long long) c.second.id << "\">\n"
+            << "        <lecture_capacity>" << c.second.lecture_capacity << "</lecture_capacity>\n"
+            << "        <tutorial_capacity>" << c.second.tutorial_capacity << "</tutorial_capacity>\n"
+            << "    </classroom>\n";
+    }
+    out << "</classrooms>\n";
+    out.close();
+
+    open_xml(out, directory + "/students.xml", "students");
+    for (auto& s : this->students) {
+        out << "    <student id=\"" << (long long) s.second.id << "\">\n";
+        write_ids(out, "subjects", s.second.subjects);
+        out << "    </student>\n";
+    }
+    out << "</students>\n";
+    out.close();
+
+    open_xml(out, directory + "/subjects.xml", "subjects");
+    for (auto& s : this->subjects) {
+        const Subject& subject = s.second;
+        out << "    <subject id=\"" << (long long) subject.id << "\">\n";
+        write_ids(out, "lecture_classrooms", subject.lecture_classrooms);
+        write_ids(out, "tutorial_classrooms", subject.tutorial_classrooms);
+        write_ids(out, "professors", subject.professors);
+        out << "        <assistants>\n";
+        for (size_t i = 0; i < subject.teaching_assistants.size(); i++) {
+            out << "            <id weight=\"" << subject.teaching_assistant_weights[i] << "\">"
+                << (long long) subject.teaching_assistants[i] << "</id>\n";
+        }
+        out << "        </assistants>\n"
+            << "    </subject>\n";
+    }
+    out << "</subjects>\n";
+    out.close();
+}
+
+void import::Problem::export_binary(const std::string& file_path) const {
+    std::ofstream out_file(file_path, std::ios::binary);
+    if (!out_file.is_open()) {
+        std::cerr << "Could not write the problem " << file_path << ". " << std::endl;
+        throw std::exception();
+    }
+
+    BinaryProblemHeader::current().write(out_file);
+    boost::archive::binary_oarchive oa(out_file);
+    oa << *this;
+}
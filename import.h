@@ -5,8 +5,11 @@
 
 #include <boost/serialization/string.hpp>
 #include <boost/serialization/access.hpp>
+#include <boost/serialization/map.hpp>
 #include <boost/serialization/vector.hpp>
+#if !THREADS_ONLY
 #include <boost/mpi/datatype.hpp>
+#endif
 #include <boost/mpl/bool.hpp>
 
 #include <map>
@@ -166,12 +169,89 @@ namespace import {
          */
         void populate_students(std::map<int, Student> student_map);
     };
+
+
+    /**
+     * The subject conflict matrix: the number of students two subjects share, for every pair of subjects
+     * (the diagonal holds the enrollments). Subjects are indexed by ID, so it takes (largest ID + 1)^2 integers.
+     * Computed once from the students' subjects, in O(students * subjects per student ^ 2).
+     */
+    class SubjectConflicts {
+    private:
+        int subject_count;
+        std::vector<int> shared_students;
+
+    public:
+        SubjectConflicts();
+        SubjectConflicts(std::map<int, Student>& students, std::map<int, Subject>& subjects);
+
+        /**
+         * The number of students taking both subjects, 0 for IDs outside the matrix.
+         */
+        inline int shared(int a, int b) const {
+            if (a < 0 || b < 0 || a >= this->subject_count || b >= this->subject_count) {
+                return 0;
+            }
+            return this->shared_students[a * this->subject_count + b];
+        }
+
+        inline int enrollment(int subject) const {
+            return shared(subject, subject);
+        }
+
+        /**
+         * The number of other subjects that share at least one student with the subject (its conflict graph degree).
+         */
+        int degree(int subject) const;
+    };
+
+
+    /**
+     * A whole problem: the contents of the four input files.
+     * Besides the XML files, it can be stored in a binary format (a Boost binary archive),
+     * which is much faster to read for large generated problems. The archive follows a header with
+     * a magic number, the format version and the widths of the ID types, as the archive can only be read
+     * by a build with the same widths (see TIMETABLE_WIDE_IDS).
+     */
+    class Problem {
+    private:
+        friend class boost::serialization::access;
+
+        template<class Archive>
+        void serialize(Archive& ar, const unsigned int version) {
+            ar & this->professors;
+            ar & this->classrooms;
+            ar & this->students;
+            ar & this->subjects;
+        }
+
+    public:
+        std::map<int, Professor> professors;
+        std::map<int, Classroom> classrooms;
+        std::map<int, Student> students;
+        std::map<int, Subject> subjects;
+
+        /**
+         * Imports the professors.xml, classrooms.xml, students.xml and subjects.xml files of a directory.
+         */
+        static Problem import_xml(const std::string& directory);
+
+        static Problem import_binary(const std::string& file_path);
+
+        /**
+         * Writes the four XML files into a directory, in the format of the schemas.
+         */
+        void export_xml(const std::string& directory) const;
+
+        void export_binary(const std::string& file_path) const;
+    };
 }
 
 
 /**
  * These are Boost's way of optimizing fixed structures. They must be placed outside of namespace import because C++.
  */
+#if !THREADS_ONLY
 namespace boost {
     namespace mpi {
         template <>
@@ -181,5 +261,6 @@ namespace boost {
         struct is_mpi_datatype<import::Classroom> : boost::mpl::true_ { };
     }
 }
+#endif
 
 #endif //INCLUDE_IMPORT_H
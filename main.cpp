@@ -2,18 +2,24 @@
 #include "utils.h"
 #include "genetic/mutation.h"
 #include "genetic/selection.h"
+#include "genetic/annealing.h"
 #include "genetic/crossover.h"
+#include "genetic/local_search.h"
+#include "communicator.h"
+#include "counters.h"
 #include "custom_mpi.h"
 #include "performance.h"
 #include "settings.h"
+#include "checkpoint.h"
+#include "metrics.h"
+#include "trace.h"
 
 #include <boost/math/common_factor.hpp>
 #include <boost/math/special_functions/round.hpp>
-#include <boost/mpi.hpp>
-#include <boost/mpi/environment.hpp>
-#include <boost/mpi/communicator.hpp>
-#include <boost/mpi/collectives.hpp>
 #include <boost/serialization/map.hpp>
+#if !THREADS_ONLY
+#include <boost/mpi/environment.hpp>
+#endif
 
 #include <iostream>
 #include <fstream>
@@ -22,10 +28,14 @@
 #include <chrono>
 #include <thread>
 #include <cmath>
+#include <limits>
 
 
 #define MPI_MASTER 0
 
+// the settings are read from this file, relative to out/, unless another one is given with --settings
+#define DEFAULT_SETTINGS_FILE "../xml/settings.xml"
+
 #define TRUE 1
 #define FALSE 0
 
@@ -45,66 +55,110 @@
 #define ROUND_STATS TRUE
 #endif
 
-int main(int argc, char **argv) {
-    boost::mpi::environment environment(argc, argv);
-    boost::mpi::communicator world;
-
+/**
+ * Runs the genetic algorithm as one of the processes (or threads in the threads-only build) of the communicator.
+ */
+int run_process(Communicator& world, bool resume, const std::string& settings_file) {
     PerformanceBenchmark bench = PerformanceBenchmark();
+    PerformanceBenchmark::set_current(&bench);
     bench.measure_time(PerformanceBenchmark::PROGRAM, PerformanceBenchmark::START);
 
-    std::string processor_name = environment.processor_name();
     int size = world.size();
     int rank = world.rank();
+    utils::set_process_rank(rank);
 
     std::map<int, import::Professor> professors;
     std::map<int, import::Classroom> classrooms;
     std::map<int, import::Student> students;
     std::map<int, import::Subject> subjects;
+    std::shared_ptr<Timetable> warm_start;
 
     Settings settings;
     if (rank == MPI_MASTER) {
-        settings = Settings::import_from_file("../xml/settings.xml");
+        settings = Settings::import_from_file(settings_file);
 #if TRACE_MODE
         std::cout << "Master finished parsing settings. " << std::endl;
 #endif
 #if DEBUG_MODE
         settings.print_settings();
 #endif
-        std::string professors_file = "../gen/professors.xml";
-        std::string classrooms_file = "../gen/classrooms.xml";
-        std::string students_file = "../gen/students.xml";
-        std::string subjects_file = "../gen/subjects.xml";
-        professors = import::Professor::import_professors(professors_file);
-        classrooms = import::Classroom::import_classrooms(classrooms_file);
-        students = import::Student::import_students(students_file);
-        subjects = import::Subject::import_subjects(subjects_file);
+        import::Problem problem = settings.problem_file.empty()
+                                  ? import::Problem::import_xml("../gen")
+                                  : import::Problem::import_binary(settings.problem_file);
+        professors = problem.professors;
+        classrooms = problem.classrooms;
+        students = problem.students;
+        subjects = problem.subjects;
 #if TRACE_MODE
         std::cout << "Master finished parsing input files. " << std::endl;
 #endif
+        if (!settings.warm_start_file.empty()) {
+            warm_start = Timetable::import_json(settings.warm_start_file);
+            if (warm_start == nullptr) {
+                std::cerr << "Could not import the warm start timetable " << settings.warm_start_file << ". " << std::endl;
+                world.abort(-1);
+                throw std::exception();
+            }
+#if TRACE_MODE
+            std::cout << "Master imported " << warm_start->timetable_entries.size() << " warm start entries. " << std::endl;
+#endif
+        }
     }
 
 
     // now that everything is parsed, broadcast it to everyone
-    boost::mpi::broadcast(world, settings, MPI_MASTER);
+    static const int input_broadcast = PerformanceBenchmark::probe("Input broadcast");
+    {
+        comm::Phase phase(input_broadcast);
+        comm::broadcast(world, settings, MPI_MASTER);
+    }
 #if TRACE_MODE
     std::cout << "Process " << rank << " got settings. " << std::endl;
 #endif
-    boost::mpi::broadcast(world, professors, MPI_MASTER);
+
+    // the clock offsets are measured at the start and at the end of the traced part of the run
+    ClockOffset trace_start_offset;
+    if (!settings.trace_file.empty()) {
+        bench.enable_tracing();
+        trace_start_offset = trace::estimate_clock_offset(world);
+    }
+
+    utils::set_random_seed((unsigned int) settings.random_seed);
+
+    // hardware counters are optional, the run continues without them if the system doesn't allow them
+    if (settings.hardware_counters) {
+        std::string error;
+        if (counters::open(error)) {
+            bench.enable_counters();
+        } else {
+            std::cerr << "Process " << rank << " can't use hardware counters (" << error << "), continuing without them. " << std::endl;
+        }
+    }
+    {
+        comm::Phase phase(input_broadcast);
+        comm::broadcast(world, professors, MPI_MASTER);
 #if TRACE_MODE
-    std::cout << "Process " << rank << " got " << professors.size() << " professors. " << std::endl;
+        std::cout << "Process " << rank << " got " << professors.size() << " professors. " << std::endl;
 #endif
-    boost::mpi::broadcast(world, classrooms, MPI_MASTER);
+        comm::broadcast(world, classrooms, MPI_MASTER);
 #if TRACE_MODE
-    std::cout << "Process " << rank << " got " << classrooms.size() << " classrooms. " << std::endl;
+        std::cout << "Process " << rank << " got " << classrooms.size() << " classrooms. " << std::endl;
 #endif
-    boost::mpi::broadcast(world, students, MPI_MASTER);
+        comm::broadcast(world, students, MPI_MASTER);
 #if TRACE_MODE
-    std::cout << "Process " << rank << " got " << students.size() << " students. " << std::endl;
+        std::cout << "Process " << rank << " got " << students.size() << " students. " << std::endl;
 #endif
-    boost::mpi::broadcast(world, subjects, MPI_MASTER);
+        comm::broadcast(world, subjects, MPI_MASTER);
 #if TRACE_MODE
-    std::cout << "Process " << rank << " got " << subjects.size() << " subjects. " << std::endl;
+        std::cout << "Process " << rank << " got " << subjects.size() << " subjects. " << std::endl;
 #endif
+        if (!settings.warm_start_file.empty()) {
+            comm::broadcast(world, warm_start, MPI_MASTER);
+#if TRACE_MODE
+            std::cout << "Process " << rank << " got the warm start timetable. " << std::endl;
+#endif
+        }
+    }
 
     std::vector<import::Subject> subject_list = utils::map_to_vector<std::map<int, import::Subject>, import::Subject>(subjects);
 #if TRACE_MODE
@@ -137,51 +191,98 @@ int main(int argc, char **argv) {
 
 
 
+    // a checkpoint directory that can't be written would only show at the first checkpoint
+    if (settings.checkpoint_interval > 0 && !Checkpoint::is_writable(settings.checkpoint_directory, rank)) {
+        std::cerr << "Process " << rank << " can't write checkpoints into " << settings.checkpoint_directory << ". " << std::endl;
+        world.abort(-1);
+        throw std::exception();
+    }
+
+    // when resuming, each process restores its own state from its checkpoint
+    Checkpoint checkpoint;
+    if (resume) {
+        std::string checkpoint_path = Checkpoint::file_path(settings.checkpoint_directory, rank);
+        if (!checkpoint.load(checkpoint_path, bench)) {
+            std::cerr << "Process " << rank << " could not load the checkpoint " << checkpoint_path << ". " << std::endl;
+            world.abort(-1);
+            throw std::exception();
+        }
+
+        // all checkpoints must be from the same round and the same number of processes
+        std::vector<int> checkpoint_rounds;
+        comm::gather(world, checkpoint.round, checkpoint_rounds, MPI_MASTER);
+        if (rank == MPI_MASTER) {
+            for (int r : checkpoint_rounds) {
+                if (r != checkpoint.round || checkpoint.processes != size) {
+                    std::cerr << "Checkpoints are inconsistent (rounds " << checkpoint.round << " and " << r
+                              << ", " << checkpoint.processes << " processes saved, " << size << " running). " << std::endl;
+                    world.abort(-1);
+                    throw std::exception();
+                }
+            }
+            std::cout << "Resuming from round " << checkpoint.round << ". " << std::endl;
+        }
+    }
+
 #if TRACE_MODE
     std::cout << "Process " << rank << " started initial generation. " << std::endl;
 #endif
     bench.measure_time(PerformanceBenchmark::INITIAL_GENERATION, PerformanceBenchmark::START);
 
     TimetableGenerator timetable_generator(professors, classrooms, students, subjects);
+    MutationCore mut = MutationCore(EARLIEST_HOUR, LATEST_HOUR, 0, ActiveTimetableConfig::days - 1, subject_list);
+    std::shared_ptr<FitnessCore> fitness_core(new FitnessCore(professors, classrooms, students, subjects));
+    mut.set_mutation_weights(settings.mutation_weights);
+    mut.set_subject_conflicts(fitness_core->get_subject_conflicts());
+    mut.set_classrooms(classrooms);
     std::vector<std::shared_ptr<Timetable>> process_population = std::vector<std::shared_ptr<Timetable>>();
-    for (int i = 0; i < process_population_size; i++) {
-        std::shared_ptr<Timetable> gend = timetable_generator.generate();
-        process_population.push_back(gend);
-        std::shared_ptr<Timetable>& timetable = process_population.back();
-
-        // check students validity
-        timetable_student_t possible_offender = gend->validate_students((timetable_student_t) (students.size() - 1));
-        if (possible_offender != 0) {
-            std::cerr << "Process " << rank << " generated an invalid timetable due to at least one invalid student (" << possible_offender << "). " << std::endl;
-            environment.abort(-1);
-            throw std::exception();
-        }
 
-        // debugging tool: check each timetable
-        // each lectures entry must have its matching pair
-        for (std::shared_ptr<TimetableEntry>& te : timetable->timetable_entries) {
-            if (te->lectures) {
-                continue;
-            }
-
-            bool found = false;
-            for (std::shared_ptr<TimetableEntry>& te2 : timetable->timetable_entries) {
-                if (te->is_matching_tutorial(te2)) {
-                    found = true;
-                    break;
+    if (resume) {
+        // the population is restored from the checkpoint instead
+        process_population = checkpoint.population;
+    } else {
+        // when warm starting, a part of the population consists of perturbations of the repaired previous timetable
+        // the first of them is left as-is so the previous solution is never lost
+        int warm_start_count = 0;
+        if (warm_start != nullptr) {
+            warm_start_count = (int) boost::math::round(process_population_size * settings.warm_start_ratio);
+
+            std::shared_ptr<Timetable> repaired = timetable_generator.repair(warm_start);
+            std::mt19937 perturbation_rand = std::mt19937(utils::get_random_seed());
+            std::uniform_int_distribution<int> perturbation_distribution(1, std::max(1, settings.warm_start_mutations));
+            for (int i = 0; i < warm_start_count; i++) {
+                std::shared_ptr<Timetable> perturbed = repaired->clone();
+                int mutations = i == 0 ? 0 : perturbation_distribution(perturbation_rand);
+                for (int m = 0; m < mutations; m++) {
+                    perturbed = mut.perform_mutation(perturbed);
                 }
+                process_population.push_back(perturbed);
             }
+        }
 
-            if (!found) {
-                std::cerr << "Process " << rank << ": matching tutorial not found (post-generation check). " << std::endl;
-                te->print();
-                timetable->print();
-                environment.abort(-1);
+        // a part of the remaining population is seeded with constructive (hard-feasible) individuals, the rest is random
+        int constructive_count = (int) boost::math::round((process_population_size - warm_start_count) * settings.constructive_ratio);
+        for (int i = warm_start_count; i < process_population_size; i++) {
+            std::shared_ptr<Timetable> gend = i - warm_start_count < constructive_count ? timetable_generator.generate_constructive() : timetable_generator.generate();
+            process_population.push_back(gend);
+
+            // check students validity
+            timetable_student_t possible_offender = gend->validate_students((timetable_student_t) (students.size() - 1));
+            if (possible_offender != 0) {
+                std::cerr << "Process " << rank << " generated an invalid timetable due to at least one invalid student (" << possible_offender << "). " << std::endl;
+                world.abort(-1);
                 throw std::exception();
             }
         }
     }
 
+    if (warm_start != nullptr && settings.deviation_penalty > 0) {
+        fitness_core->set_reference(warm_start, settings.deviation_penalty);
+    }
+    if (settings.occupancy_index) {
+        fitness_core->enable_occupancy_index();
+    }
+
     bench.measure_time(PerformanceBenchmark::INITIAL_GENERATION, PerformanceBenchmark::END);
 
 #if TRACE_MODE
@@ -195,16 +296,16 @@ int main(int argc, char **argv) {
     std::mt19937 rand = std::mt19937(utils::get_random_seed());
     std::uniform_int_distribution<int> survivor_selector(0, real_survivor_count - 1);
     std::uniform_real_distribution<double> zero_one_distribution(0, 1);
-    MutationCore mut = MutationCore(EARLIEST_HOUR, LATEST_HOUR, 0, 4, subject_list);
     CrossoverCore cross = CrossoverCore(subject_list);
-    std::shared_ptr<FitnessCore> fitness_core(new FitnessCore(professors, classrooms, students, subjects));
     TournamentSelection ts = TournamentSelection(real_survivor_count);
+    LocalSearch local_search = LocalSearch(mut, fitness_core);
 
     std::vector<FitnessPair> process_population_fitnesses = std::vector<FitnessPair>((unsigned long) process_population_size);
     std::vector<FitnessPair> global_population_fitnesses = std::vector<FitnessPair>((unsigned long) real_population_size);
     std::vector<std::shared_ptr<Timetable>> global_survivors = std::vector<std::shared_ptr<Timetable>>();
 
     // dynamic workload management benchmarking
+    // the sum of the times spent computing (not blocked in collectives) in the current window
     int dynamic_workload_window_size = 3;
     double window_processing_time_sum = 0;
     std::vector<double> window_time_sums = std::vector<double>();
@@ -216,28 +317,185 @@ int main(int argc, char **argv) {
     // this is used to pad when sending fitnesses
     int max_process_population = process_population_size;
 
+    // the first round in which a feasible individual (no prohibitive violations) was found, and when
+    int first_feasible_round = -1;
+    double first_feasible_time = -1;
+
+    if (resume) {
+        round = checkpoint.round;
+        process_population_size = checkpoint.process_population_size;
+        process_individual_start_index = checkpoint.process_individual_start_index;
+        process_individual_end_index = process_individual_start_index + process_population_size;
+        max_process_population = checkpoint.max_process_population;
+        window_processing_time_sum = checkpoint.window_processing_time_sum;
+        first_feasible_round = checkpoint.first_feasible_round;
+        first_feasible_time = checkpoint.first_feasible_time;
+        bench.set_elapsed_time_offset(checkpoint.elapsed_time);
+
+        Checkpoint::set_random_state(rand, checkpoint.main_random_state);
+        Checkpoint::set_random_state(mut.get_random_engine(), checkpoint.mutation_random_state);
+        Checkpoint::set_random_state(cross.get_random_engine(), checkpoint.crossover_random_state);
+        Checkpoint::set_random_state(ts.get_random_engine(), checkpoint.selection_random_state);
+
+        // the checkpoint is no longer needed, don't keep a second reference to the population
+        checkpoint.population.clear();
+    }
+
+    MetricsStream metrics(settings.metrics_directory, rank, resume);
+    GenerationMetrics generation_metrics;
+
     bench.measure_time(PerformanceBenchmark::PREREQ_INIT, PerformanceBenchmark::END);
 
-    do {
+    if (settings.engine != "genetic" && settings.engine != "annealing" && settings.engine != "tempering") {
+        std::cerr << "Unknown engine \"" << settings.engine << "\", use genetic, annealing or tempering. " << std::endl;
+        world.abort(-1);
+        throw std::exception();
+    }
+
+    // the alternative engines: a simulated annealing chain on each process, from the best individual of its
+    // initial population, the best individuals of the chains are then exported like those of the genetic algorithm
+    bool genetic_engine = settings.engine == "genetic";
+    if (!genetic_engine) {
+        SimulatedAnnealing::Schedule schedule;
+        schedule.iterations = settings.annealing_iterations;
+        schedule.initial_temperature = settings.annealing_initial_temperature;
+        schedule.final_temperature = settings.annealing_final_temperature;
+        schedule.tabu_tenure = settings.tabu_tenure;
+        SimulatedAnnealing annealing(mut, fitness_core, schedule);
+
+        std::shared_ptr<Timetable> start = process_population.front();
+        fitness_t start_fitness = fitness_core->calculate_fitness(start);
+        for (auto& i : process_population) {
+            fitness_t fitness = fitness_core->calculate_fitness(i);
+            if (start_fitness < fitness) {
+                start_fitness = fitness;
+                start = i;
+            }
+        }
+
+        double chain_start_time = bench.get_elapsed_time();
+        if (settings.engine == "annealing") {
+            process_population.assign(1, annealing.run(start));
+        } else {
+            // parallel tempering: the chains run at fixed temperatures on a geometric ladder from the final temperature
+            // (rank 0) to the initial one (the last rank). After every exchange interval, neighbouring chains (the even
+            // and the odd pairs alternately) decide on swapping their states from their fitness values alone,
+            // the current individuals are only sent if the swap is accepted
+            if (settings.annealing_final_temperature <= 0 || settings.annealing_initial_temperature <= 0) {
+                std::cerr << "Parallel tempering needs positive temperatures. " << std::endl;
+                world.abort(-1);
+            }
+            double ladder_ratio = world.size() > 1
+                                ? std::pow(settings.annealing_initial_temperature / settings.annealing_final_temperature, 1.0 / (world.size() - 1))
+                                : 1;
+            auto temperature_of = [&](int r) { return settings.annealing_final_temperature * std::pow(ladder_ratio, r); };
+            double temperature = temperature_of(rank);
+
+            // both partners draw the acceptance from the same generator, seeded by the exchange and the pair
+            unsigned int exchange_seed = rank == MPI_MASTER ? utils::get_random_seed() : 0;
+            comm::broadcast(world, exchange_seed, MPI_MASTER);
+
+            static const int tempering_exchange = PerformanceBenchmark::probe("Tempering exchange");
+            annealing.start(start);
+            int interval = std::max(1, settings.tempering_exchange_interval);
+            long swaps_attempted = 0;
+            long swaps_accepted = 0;
+            for (int moves = 0, exchange = 0; ; exchange++) {
+                int segment = std::min(interval, settings.annealing_iterations - moves);
+                annealing.advance(segment, temperature);
+                moves += segment;
+                if (moves >= settings.annealing_iterations) {
+                    break;
+                }
+
+                int lower = rank % 2 == exchange % 2 ? rank : rank - 1;
+                int partner = lower == rank ? rank + 1 : lower;
+                if (lower < 0 || lower + 1 >= world.size()) {
+                    partner = -1;
+                }
+
+                comm::Phase phase(tempering_exchange);
+                double fitness = annealing.get_current_fitness().fitness;
+                double partner_fitness = 0;
+                comm::exchange(world, fitness, partner_fitness, partner);
+
+                bool swap = false;
+                if (partner != -1) {
+                    double lower_fitness = partner == lower ? partner_fitness : fitness;
+                    double upper_fitness = partner == lower ? fitness : partner_fitness;
+                    double exponent = (upper_fitness - lower_fitness) * (1 / temperature_of(lower) - 1 / temperature_of(lower + 1));
+                    std::mt19937 pair_rand(exchange_seed + (unsigned int) (exchange * world.size() + lower));
+                    swap = exponent >= 0 || std::uniform_real_distribution<double>(0, 1)(pair_rand) < std::exp(exponent);
+                    swaps_attempted++;
+                    swaps_accepted += swap;
+                }
+
+                std::shared_ptr<Timetable> received;
+                comm::exchange(world, annealing.get_current(), received, swap ? partner : -1);
+                if (swap) {
+                    annealing.replace_current(received);
+                }
+            }
+            process_population.assign(1, annealing.get_best());
+
+            std::cout << "Process " << rank << " at temperature " << temperature << " accepted " << swaps_accepted
+                      << " of " << swaps_attempted << " swaps. " << std::endl;
+        }
+
+        const SimulatedAnnealing::Counts& counts = annealing.get_counts();
+        std::cout << "Process " << rank << " finished annealing: " << counts.moves << " moves, " << counts.accepted
+                  << " accepted, " << counts.tabu_rejected << " rejected as tabu, " << counts.improvements << " improvements. " << std::endl;
+
+        // the first feasible individual of all chains, the round is the iteration of the chain
+        std::vector<double> feasible_times;
+        std::vector<int> feasible_iterations;
+        comm::gather(world, counts.first_feasible_iteration == -1 ? -1 : chain_start_time + counts.first_feasible_time, feasible_times, MPI_MASTER);
+        comm::gather(world, counts.first_feasible_iteration, feasible_iterations, MPI_MASTER);
+        for (size_t i = 0; i < feasible_times.size(); i++) {
+            if (feasible_iterations[i] != -1 && (first_feasible_time < 0 || feasible_times[i] < first_feasible_time)) {
+                first_feasible_time = feasible_times[i];
+                first_feasible_round = feasible_iterations[i];
+            }
+        }
+    }
+
+    while (genetic_engine) {
         if (rank == MPI_MASTER) {
             std::cout << std::setprecision(5) << "GENERATION " << round << " (" << bench.get_latest_generation_time() << " s)" << std::endl;
         }
 
         bench.measure_time(PerformanceBenchmark::GENERATION, PerformanceBenchmark::START);
+        bench.take_blocked_time();
         bench.measure_time(PerformanceBenchmark::FITNESS_COMPUTATION, PerformanceBenchmark::START);
 
         // compute the fitnesses of each individual in each process, storing them in a vector of pairs
         process_population_fitnesses.clear();
+        // with early exits, an individual with more hard violations than the best one of the process so far
+        // only has its hard constraints evaluated, it can't be ranked above that one anyway
         int individual_index = process_individual_start_index;
+        int max_hard_violations = std::numeric_limits<int>::max();
         for (auto& i : process_population) {
-            fitness_t fitness = fitness_core->calculate_fitness(i);
-            FitnessPair fp;
-            fp.individual_index = individual_index;
-            fp.fitness = fitness.fitness;
-            process_population_fitnesses.push_back(fp);
+            fitness_t fitness = fitness_core->calculate_fitness(i, max_hard_violations);
+            if (settings.early_exit_fitness && fitness.complete) {
+                max_hard_violations = std::min(max_hard_violations, fitness.hard_violations());
+            }
+            process_population_fitnesses.push_back(FitnessPair(individual_index, fitness));
 
             individual_index++;
         }
+        // the others of the process that were complete only because they came early are ranked like the rest
+        if (settings.early_exit_fitness) {
+            FitnessPair::settle_early_exit(process_population_fitnesses);
+        }
+
+        if (metrics.is_enabled()) {
+            generation_metrics = GenerationMetrics();
+            generation_metrics.round = round;
+            generation_metrics.population_size = process_population_size;
+            generation_metrics.elapsed_time = bench.get_elapsed_time();
+            generation_metrics.set_process_fitnesses(process_population_fitnesses);
+            generation_metrics.fitness_cache = fitness_core->take_cache_counts();
+        }
 
 #if DEBUG_MODE
         std::cout << "Pre-padding process " << rank << " population fitnesses size: " << process_population_fitnesses.size() << std::endl;
@@ -263,7 +521,10 @@ int main(int argc, char **argv) {
         if (rank == MPI_MASTER) {
             global_population_fitnesses.clear();
         }
-        boost::mpi::gather(world, &process_population_fitnesses.front(), max_process_population, global_population_fitnesses, MPI_MASTER);
+        {
+            comm::Phase phase(PerformanceBenchmark::POPULATION_FITNESS_SENDING);
+            comm::gather(world, &process_population_fitnesses.front(), max_process_population, global_population_fitnesses, MPI_MASTER);
+        }
 
         bench.measure_time(PerformanceBenchmark::POPULATION_FITNESS_SENDING, PerformanceBenchmark::END);
 
@@ -287,10 +548,30 @@ int main(int argc, char **argv) {
                                           [](FitnessPair& fp) { return fp.individual_index == -1; }
                            );
             global_population_fitnesses.erase(new_end, global_population_fitnesses.end());
+            // each process stopped at its own best, the ranking uses the best of the whole population
+            if (settings.early_exit_fitness) {
+                FitnessPair::settle_early_exit(global_population_fitnesses);
+            }
 #if DEBUG_MODE
             std::cout << "Master removing paddings - after: " << global_population_fitnesses.size()
                       << " (should be " << real_population_size << ")" << std::endl;
 #endif
+
+            if (first_feasible_round == -1) {
+                for (FitnessPair& fp : global_population_fitnesses) {
+                    if (fp.hard_violations == 0) {
+                        first_feasible_round = round;
+                        first_feasible_time = bench.get_elapsed_time();
+                        std::cout << std::setprecision(5) << "FIRST FEASIBLE " << round << " (" << first_feasible_time << " s)" << std::endl;
+                        break;
+                    }
+                }
+            }
+
+            if (metrics.is_enabled()) {
+                generation_metrics.population_statistics = utils::PopulationStatistics::compute(global_population_fitnesses, fitness_core);
+                generation_metrics.has_population_statistics = true;
+            }
         }
 
 
@@ -343,7 +624,10 @@ int main(int argc, char **argv) {
         bench.measure_time(PerformanceBenchmark::SURVIVOR_INDICES_BROADCAST, PerformanceBenchmark::START);
 
         // the survivors are broadcast to everyone
-        boost::mpi::broadcast(world, survivor_indices, MPI_MASTER);
+        {
+            comm::Phase phase(PerformanceBenchmark::SURVIVOR_INDICES_BROADCAST);
+            comm::broadcast(world, survivor_indices, MPI_MASTER);
+        }
 
         bench.measure_time(PerformanceBenchmark::SURVIVOR_INDICES_BROADCAST, PerformanceBenchmark::END);
 
@@ -395,7 +679,10 @@ int main(int argc, char **argv) {
 
         // process_population variables now hold only survivors, but we must share them around
         // so all processes have all survivors
-        custom_all_gather(world, process_population, global_survivors);
+        {
+            comm::Phase phase(PerformanceBenchmark::SURVIVOR_ALLGATHER);
+            custom_all_gather(world, process_population, global_survivors);
+        }
 
         bench.measure_time(PerformanceBenchmark::SURVIVOR_ALLGATHER, PerformanceBenchmark::END);
 #if DEBUG_MODE
@@ -404,23 +691,32 @@ int main(int argc, char **argv) {
 
         bench.measure_time(PerformanceBenchmark::POPULATION_ADJUSTMENT, PerformanceBenchmark::START);
 
-        // at the end of the round, measure performance so we can adjust it dynamically
-        if (round != 0) {
-            window_processing_time_sum += bench.get_latest_round_processing_time();
-        }
-
         // adjust performance every n rounds
         // round -1 and round > 1 to delay one round at the beginning
         if ((round - 1) % dynamic_workload_window_size == 0 && round > 1) {
+            comm::Phase phase(PerformanceBenchmark::POPULATION_ADJUSTMENT);
+
             // send everything to master
-            boost::mpi::gather(world, window_processing_time_sum, window_time_sums, MPI_MASTER);
+            comm::gather(world, window_processing_time_sum, window_time_sums, MPI_MASTER);
+            window_processing_time_sum = 0;
 
             // master should now calculate the new counts
             if (rank == MPI_MASTER) {
                 double time_sum = 0;
+                double max_time = 0;
                 for (double t : window_time_sums) {
                     time_sum += t;
+                    if (t > max_time) max_time = t;
+                }
+
+                // everyone waits for the slowest process, the difference is idle time
+                double idle_time = 0;
+                for (double t : window_time_sums) {
+                    idle_time += max_time - t;
                 }
+                std::cout << std::setprecision(5) << "Workload imbalance of the last " << dynamic_workload_window_size
+                          << " rounds: max/mean compute time " << (max_time * window_time_sums.size() / time_sum)
+                          << ", " << idle_time << " s idle" << std::endl;
 
                 double avg_time_ratio = 0;
                 for (unsigned int process = 0; process < window_time_sums.size(); process++) {
@@ -479,7 +775,7 @@ int main(int argc, char **argv) {
             }
 
             // scatter new process sizes
-            boost::mpi::broadcast(world, process_adjusted_population_counts, MPI_MASTER);
+            comm::broadcast(world, process_adjusted_population_counts, MPI_MASTER);
 
             // set the new max process population on each process
             max_process_population = 0;
@@ -530,25 +826,99 @@ int main(int argc, char **argv) {
                 process_population.push_back(tt);
             } else {
                 std::shared_ptr<Timetable> tt = mut.perform_mutation(selected_survivor);
+                process_population.push_back(tt);
+            }
+        }
 
-                // WORKAROUND: if there's an error (matching entry not found), skip and try again
-                if (tt == nullptr) {
-                    continue;
+        // memetic stage: the best offspring of the process are improved by a hill climb
+        // they are evaluated here (like in the fitness computation), the next generation reads the cached fitnesses
+        if (settings.local_search_individuals > 0 && settings.local_search_moves > 0) {
+            // the pairs hold the position in the process population as their index
+            std::vector<FitnessPair> offspring_fitnesses;
+            int max_hard_violations = std::numeric_limits<int>::max();
+            for (int i = 0; i < (int) process_population.size(); i++) {
+                fitness_t fitness = fitness_core->calculate_fitness(process_population[i], max_hard_violations);
+                if (settings.early_exit_fitness && fitness.complete) {
+                    max_hard_violations = std::min(max_hard_violations, fitness.hard_violations());
                 }
-                process_population.push_back(tt);
+                offspring_fitnesses.push_back(FitnessPair(i, fitness));
+            }
+            if (settings.early_exit_fitness) {
+                FitnessPair::settle_early_exit(offspring_fitnesses);
+            }
+
+            // best first
+            int improved_count = std::min(settings.local_search_individuals, (int) offspring_fitnesses.size());
+            std::partial_sort(offspring_fitnesses.begin(), offspring_fitnesses.begin() + improved_count, offspring_fitnesses.end(),
+                              FitnessPair::compare_fitness);
+            for (int i = 0; i < improved_count; i++) {
+                std::shared_ptr<Timetable>& individual = process_population[offspring_fitnesses[i].individual_index];
+                individual = local_search.improve(individual, settings.local_search_moves);
             }
         }
 
         bench.measure_time(PerformanceBenchmark::REPOPULATION, PerformanceBenchmark::END);
         bench.measure_time(PerformanceBenchmark::GENERATION, PerformanceBenchmark::END);
 
-    } while (++round < settings.rounds);
+        bench.sample_memory();
+
+        // the time the process did not spend blocked in collectives is its share of the work,
+        // which is what the dynamic workload adjustment balances
+        double blocked_time = bench.take_blocked_time();
+        double compute_time = bench.get_latest_generation_time() - blocked_time;
+        if (round != 0) {
+            window_processing_time_sum += compute_time;
+        }
+
+        if (metrics.is_enabled()) {
+            generation_metrics.compute_time = compute_time;
+            generation_metrics.blocked_time = blocked_time;
+
+            std::vector<double> compute_times;
+            comm::gather(world, compute_time, compute_times, MPI_MASTER);
+            if (rank == MPI_MASTER) {
+                generation_metrics.set_imbalance(compute_times);
+            }
+            generation_metrics.traffic = bench.take_generation_traffic();
+            generation_metrics.hardware_counters = bench.take_generation_counters();
+            generation_metrics.local_search = local_search.take_counts();
+        }
+        metrics.write_generation(generation_metrics, bench);
+
+        // every few rounds, save the state of the process so an interrupted run can be resumed
+        if (settings.checkpoint_interval > 0 && (round + 1) % settings.checkpoint_interval == 0 && round + 1 < settings.rounds) {
+            bench.measure_time(PerformanceBenchmark::CHECKPOINT, PerformanceBenchmark::START);
+
+            Checkpoint cp;
+            cp.round = round + 1;
+            cp.processes = size;
+            cp.process_population_size = process_population_size;
+            cp.process_individual_start_index = process_individual_start_index;
+            cp.max_process_population = max_process_population;
+            cp.window_processing_time_sum = window_processing_time_sum;
+            cp.first_feasible_round = first_feasible_round;
+            cp.first_feasible_time = first_feasible_time;
+            cp.elapsed_time = bench.get_elapsed_time();
+            cp.main_random_state = Checkpoint::get_random_state(rand);
+            cp.mutation_random_state = Checkpoint::get_random_state(mut.get_random_engine());
+            cp.crossover_random_state = Checkpoint::get_random_state(cross.get_random_engine());
+            cp.selection_random_state = Checkpoint::get_random_state(ts.get_random_engine());
+            cp.population = process_population;
+            cp.save(Checkpoint::file_path(settings.checkpoint_directory, rank), bench);
+
+            bench.measure_time(PerformanceBenchmark::CHECKPOINT, PerformanceBenchmark::END);
+        }
+
+        if (++round >= settings.rounds) {
+            break;
+        }
+    }
 
     bench.measure_time(PerformanceBenchmark::PROGRAM, PerformanceBenchmark::END);
 
     // print stats in order with a bit of wait time so it's not jumbled up
-    // this is to enable easier output parsing
-    for (int i = 0; i < size; i++) {
+    // this is to enable easier output parsing, with the metrics stream the stats are in its summary instead
+    for (int i = 0; i < size && !metrics.is_enabled(); i++) {
         if (i == rank) {
             std::cout << "Process " << rank << ": Genetic algorithm finished!" << std::endl;
             bench.print_stats();
@@ -564,15 +934,16 @@ int main(int argc, char **argv) {
     // each process gets the best timetable and then sends it to the master
     std::cout << "Process " << rank << " starting timetable export. " << std::endl;
     std::shared_ptr<Timetable> best = process_population.front();
-    double best_fitness = fitness_core->calculate_fitness(process_population.front()).fitness;
+    fitness_t best_result = fitness_core->calculate_fitness(process_population.front());
     for (auto& i : process_population) {
         fitness_t fitness = fitness_core->calculate_fitness(i);
 
-        if (fitness.fitness > best_fitness) {
-            best_fitness = fitness.fitness;
+        if (best_result < fitness) {
+            best_result = fitness;
             best = i;
         }
     }
+    double best_fitness = best_result.fitness;
 
 #if DEBUG_MODE
     std::cout << "Process " << rank << "'s best timetable has fitness " << best_fitness << std::endl;
@@ -580,20 +951,25 @@ int main(int argc, char **argv) {
 
     // send
     std::vector<std::shared_ptr<Timetable>> best_timetables = std::vector<std::shared_ptr<Timetable>>();
-    boost::mpi::gather(world, best, best_timetables, MPI_MASTER);
+    {
+        static const int best_gather = PerformanceBenchmark::probe("Best timetable gather");
+        comm::Phase phase(best_gather);
+        comm::gather(world, best, best_timetables, MPI_MASTER);
+    }
 
     // the master then gets the absolute best and serializes it
     if (rank == MPI_MASTER) {
         best = best_timetables.front();
-        best_fitness = fitness_core->calculate_fitness(best_timetables.front()).fitness;
+        best_result = fitness_core->calculate_fitness(best_timetables.front());
         for (auto& te : best_timetables) {
             fitness_t fitness = fitness_core->calculate_fitness(te);
 
-            if (fitness.fitness > best_fitness) {
-                best_fitness = fitness.fitness;
+            if (best_result < fitness) {
+                best_result = fitness;
                 best = te;
             }
         }
+        best_fitness = best_result.fitness;
 
 #if TRACE_MODE
         std::cout << "Master now exporting json timetable. " << std::endl;
@@ -602,8 +978,86 @@ int main(int argc, char **argv) {
         best->export_json("timetable.json");
     }
 
+    // the master merges the benchmarks of all processes into the metrics summary
+    if (metrics.is_enabled()) {
+        std::vector<PerformanceBenchmark> benches;
+        std::vector<double> total_times;
+        comm::gather(world, bench, benches, MPI_MASTER);
+        // like the elapsed times, the total time of a resumed run includes the runs before it
+        comm::gather(world, bench.get_elapsed_time_offset() + bench.get_latest_time(PerformanceBenchmark::PROGRAM), total_times, MPI_MASTER);
+
+        if (rank == MPI_MASTER) {
+            // the chain engines report their iterations as rounds, like their first feasible round
+            int rounds = genetic_engine ? settings.rounds : settings.annealing_iterations;
+            metrics.write_summary(benches, total_times, settings.engine, rounds, first_feasible_round, first_feasible_time, best_fitness);
+            std::cout << "Metrics written to " << settings.metrics_directory << ". " << std::endl;
+        }
+    }
+
+    if (bench.is_tracing()) {
+        ClockOffset trace_end_offset = trace::estimate_clock_offset(world);
+        trace::export_trace(world, bench, trace_start_offset, trace_end_offset, settings.trace_file);
+    }
+
+    counters::close();
+
     // a final sync so everyone exits at the same time
     world.barrier();
 
     return 0;
 }
+
+#if THREADS_ONLY
+/**
+ * Runs all processes as threads of this program. The number of threads is the first non-option argument,
+ * all hardware threads are used if it is omitted.
+ */
+int main(int argc, char **argv) {
+    int size = (int) std::thread::hardware_concurrency();
+    bool resume = false;
+    std::string settings_file = DEFAULT_SETTINGS_FILE;
+    for (int i = 1; i < argc; i++) {
+        if (std::string(argv[i]) == "--resume") {
+            resume = true;
+        } else if (std::string(argv[i]) == "--settings" && i + 1 < argc) {
+            settings_file = argv[++i];
+        } else {
+            size = atoi(argv[i]);
+        }
+    }
+    if (size < 1) {
+        size = 1;
+    }
+
+    std::shared_ptr<ThreadGroup> group(new ThreadGroup(size));
+    std::vector<std::thread> threads;
+    for (int rank = 0; rank < size; rank++) {
+        threads.push_back(std::thread([group, rank, resume, settings_file]() {
+            Communicator world(group, rank);
+            run_process(world, resume, settings_file);
+        }));
+    }
+    for (std::thread& t : threads) {
+        t.join();
+    }
+
+    return 0;
+}
+#else
+int main(int argc, char **argv) {
+    boost::mpi::environment environment(argc, argv);
+    boost::mpi::communicator world;
+
+    bool resume = false;
+    std::string settings_file = DEFAULT_SETTINGS_FILE;
+    for (int i = 1; i < argc; i++) {
+        if (std::string(argv[i]) == "--resume") {
+            resume = true;
+        } else if (std::string(argv[i]) == "--settings" && i + 1 < argc) {
+            settings_file = argv[++i];
+        }
+    }
+
+    return run_process(world, resume, settings_file);
+}
+#endif
@@ -0,0 +1,66 @@
+#include "memory.h"
+
+#include <atomic>
+#include <fstream>
+#include <sys/resource.h>
+#include <unistd.h>
+
+static std::atomic<long long> category_bytes[memory::CATEGORIES];
+static std::atomic<long long> category_allocations[memory::CATEGORIES];
+
+const char* memory::category_name(Category category) {
+    switch (category) {
+        case TIMETABLES:
+            return "timetables";
+        case ENTRIES:
+            return "entries";
+        case STUDENT_SETS:
+            return "student_sets";
+        case OCCUPANCY:
+            return "occupancy";
+        case FITNESS_TERMS:
+            return "fitness_terms";
+        default:
+            return "unknown";
+    }
+}
+
+void memory::count_allocation(Category category, std::size_t bytes) {
+    // only the totals matter, the order of the updates doesn't
+    category_bytes[category].fetch_add((long long) bytes, std::memory_order_relaxed);
+    category_allocations[category].fetch_add(1, std::memory_order_relaxed);
+}
+
+void memory::count_deallocation(Category category, std::size_t bytes) {
+    category_bytes[category].fetch_sub((long long) bytes, std::memory_order_relaxed);
+    category_allocations[category].fetch_sub(1, std::memory_order_relaxed);
+}
+
+long long memory::live_bytes(Category category) {
+    return category_bytes[category].load(std::memory_order_relaxed);
+}
+
+long long memory::live_allocations(Category category) {
+    return category_allocations[category].load(std::memory_order_relaxed);
+}
+
+long long memory::resident_set_size() {
+    // the second value is the number of resident pages
+    std::ifstream statm("/proc/self/statm");
+    long long total_pages = 0;
+    long long resident_pages = 0;
+    if (!(statm >> total_pages >> resident_pages)) {
+        return 0;
+    }
+    return resident_pages * sysconf(_SC_PAGESIZE);
+}
+
+long long memory::peak_resident_set_size() {
+    struct rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) != 0) {
+        return 0;
+    }
+
+    // reported in kilobytes on Linux
+    return (long long) usage.ru_maxrss * 1024;
+}
@@ -0,0 +1,88 @@
+#ifndef INCLUDE_MEMORY_H
+#define INCLUDE_MEMORY_H
+
+#include <cstddef>
+#include <memory>
+
+/**
+ * Memory accounting: the resident set size of the process and the bytes held by the structures
+ * that make up the population, counted by allocation hooks.
+ * The counters are shared by all threads of the process, as individuals are shared between them in the threads-only build.
+ */
+namespace memory {
+    enum Category {
+        TIMETABLES = 0,
+        ENTRIES = 1,
+        STUDENT_SETS = 2,
+        OCCUPANCY = 3,
+        FITNESS_TERMS = 4,
+        CATEGORIES = 5
+    };
+
+    const char* category_name(Category category);
+
+    void count_allocation(Category category, std::size_t bytes);
+    void count_deallocation(Category category, std::size_t bytes);
+
+    /**
+     * Gets the bytes currently allocated in a category.
+     */
+    long long live_bytes(Category category);
+
+    /**
+     * Gets the number of allocations in a category that have not been freed yet.
+     */
+    long long live_allocations(Category category);
+
+    /**
+     * Gets the resident set size of the process in bytes, 0 if it can't be read.
+     */
+    long long resident_set_size();
+
+    /**
+     * Gets the peak resident set size of the process in bytes, 0 if it can't be read.
+     */
+    long long peak_resident_set_size();
+
+    /**
+     * A standard allocator that counts the bytes it allocates in a category.
+     * Used for the containers inside individuals, whose elements are allocated one by one.
+     */
+    template <typename T, Category C>
+    class CountingAllocator {
+    public:
+        typedef T value_type;
+
+        template <typename U>
+        struct rebind {
+            typedef CountingAllocator<U, C> other;
+        };
+
+        CountingAllocator() {}
+
+        template <typename U>
+        CountingAllocator(const CountingAllocator<U, C>&) {}
+
+        T* allocate(std::size_t n) {
+            count_allocation(C, n * sizeof(T));
+            return std::allocator<T>().allocate(n);
+        }
+
+        void deallocate(T* p, std::size_t n) {
+            count_deallocation(C, n * sizeof(T));
+            std::allocator<T>().deallocate(p, n);
+        }
+
+        template <typename U>
+        bool operator==(const CountingAllocator<U, C>&) const {
+            return true;
+        }
+
+        template <typename U>
+        bool operator!=(const CountingAllocator<U, C>&) const {
+            return false;
+        }
+    };
+}
+
+#endif //INCLUDE_MEMORY_H
@@ -0,0 +1,300 @@
+#include "json/json.hpp"
+#include "metrics.h"
+
+#include <iostream>
+
+using json = nlohmann::json;
+
+GenerationMetrics::GenerationMetrics() {
+    this->round = 0;
+    this->population_size = 0;
+    this->elapsed_time = 0;
+    this->fitness_min = 0;
+    this->fitness_max = 0;
+    this->fitness_mean = 0;
+    this->feasible_individuals = 0;
+    this->has_population_statistics = false;
+    this->compute_time = 0;
+    this->blocked_time = 0;
+    this->has_imbalance = false;
+    this->imbalance = 0;
+    this->idle_time = 0;
+}
+
+void GenerationMetrics::set_process_fitnesses(const std::vector<FitnessPair>& fitnesses) {
+    this->feasible_individuals = 0;
+    if (fitnesses.empty()) {
+        return;
+    }
+
+    // the scalar fitness of an incomplete evaluation lacks the soft constraints
+    double sum = 0;
+    int complete = 0;
+    for (const FitnessPair& fp : fitnesses) {
+        if (fp.hard_violations == 0) this->feasible_individuals++;
+        if (!fp.is_complete()) continue;
+        if (complete == 0 || fp.fitness < this->fitness_min) this->fitness_min = fp.fitness;
+        if (complete == 0 || fp.fitness > this->fitness_max) this->fitness_max = fp.fitness;
+        sum += fp.fitness;
+        complete++;
+    }
+    if (complete > 0) {
+        this->fitness_mean = sum / complete;
+    }
+}
+
+void GenerationMetrics::set_imbalance(const std::vector<double>& compute_times) {
+    double sum = 0;
+    double max = 0;
+    for (double t : compute_times) {
+        sum += t;
+        if (t > max) max = t;
+    }
+
+    this->idle_time = 0;
+    for (double t : compute_times) {
+        this->idle_time += max - t;
+    }
+    this->imbalance = sum > 0 ? max * compute_times.size() / sum : 1;
+    this->has_imbalance = true;
+}
+
+/**
+ * A probe summary as a JSON object.
+ */
+static json probe_to_json(const PerformanceBenchmark::ProbeSummary& summary) {
+    json result;
+    result["count"] = summary.count;
+    result["min"] = summary.min;
+    result["avg"] = summary.avg;
+    result["max"] = summary.max;
+    result["p50"] = summary.p50;
+    result["p90"] = summary.p90;
+    result["p99"] = summary.p99;
+    return result;
+}
+
+static json memory_to_json(const PerformanceBenchmark::MemorySample& sample) {
+    json result;
+    result["resident"] = sample.resident;
+    result["peak_resident"] = sample.peak_resident;
+    result["timetable_bytes"] = sample.timetable_bytes;
+    result["entry_bytes"] = sample.entry_bytes;
+    result["student_set_bytes"] = sample.student_set_bytes;
+    result["occupancy_bytes"] = sample.occupancy_bytes;
+    result["fitness_terms_bytes"] = sample.fitness_terms_bytes;
+    result["individuals"] = sample.individuals;
+    result["bytes_per_individual"] = sample.bytes_per_individual;
+    return result;
+}
+
+static json traffic_to_json(const PerformanceBenchmark::Traffic& traffic) {
+    json result;
+    result["messages"] = traffic.messages;
+    result["bytes"] = traffic.bytes;
+    result["serialized_bytes"] = traffic.serialized_bytes;
+    result["serialization_time"] = traffic.serialization_time / 1e9;
+    return result;
+}
+
+static json communication_to_json(const PerformanceBenchmark& bench) {
+    json result = json::object();
+    for (int phase : bench.communication_phases()) {
+        result[PerformanceBenchmark::probe_name(phase)] = traffic_to_json(bench.get_phase_traffic(phase));
+    }
+    return result;
+}
+
+/**
+ * The available hardware counters of a probe, as totals.
+ */
+static json counters_to_json(const PerformanceBenchmark::HardwareCounters& hardware_counters) {
+    json result;
+    result["measurements"] = hardware_counters.measurements;
+    for (int event = 0; event < counters::EVENTS; event++) {
+        if (hardware_counters.is_available((counters::Event) event)) {
+            result[counters::event_name((counters::Event) event)] = hardware_counters.values[event];
+        }
+    }
+    return result;
+}
+
+static json hardware_counters_to_json(const PerformanceBenchmark& bench) {
+    json result = json::object();
+    for (int id : bench.counted_probes()) {
+        result[PerformanceBenchmark::probe_name(id)] = counters_to_json(bench.get_probe_counters(id));
+    }
+    return result;
+}
+
+static json probes_to_json(PerformanceBenchmark& bench) {
+    json result = json::object();
+    for (int id : bench.measured_probes()) {
+        // the total time is reported on its own
+        if (id == PerformanceBenchmark::PROGRAM) {
+            continue;
+        }
+
+        PerformanceBenchmark::ProbeSummary summary = bench.summarize(id);
+        result[summary.name] = probe_to_json(summary);
+    }
+    return result;
+}
+
+MetricsStream::MetricsStream(const std::string& directory, int rank, bool resume) {
+    this->directory = directory;
+    this->rank = rank;
+
+    if (this->is_enabled()) {
+        this->out.open(file_path(directory, rank), resume ? std::ios::app : std::ios::trunc);
+        if (!this->out.is_open()) {
+            std::cerr << "Process " << rank << " could not open the metrics file in " << directory << ". " << std::endl;
+            throw std::exception();
+        }
+    }
+}
+
+bool MetricsStream::is_enabled() const {
+    return !this->directory.empty();
+}
+
+std::string MetricsStream::file_path(const std::string& directory, int rank) {
+    return directory + "/metrics_" + std::to_string(rank) + ".jsonl";
+}
+
+std::string MetricsStream::summary_file_path(const std::string& directory) {
+    return directory + "/metrics_summary.json";
+}
+
+void MetricsStream::write_generation(const GenerationMetrics& metrics, PerformanceBenchmark& bench) {
+    if (!this->is_enabled()) {
+        return;
+    }
+
+    json record;
+    record["rank"] = this->rank;
+    record["round"] = metrics.round;
+    record["population_size"] = metrics.population_size;
+    record["elapsed_time"] = metrics.elapsed_time;
+
+    // the phases of the generation loop, the other probes are in the summary
+    json phases = json::object();
+    for (int id = PerformanceBenchmark::GENERATION; id <= PerformanceBenchmark::POPULATION_ADJUSTMENT; id++) {
+        phases[PerformanceBenchmark::probe_name(id)] = bench.get_latest_time(id);
+    }
+    record["phases"] = phases;
+    record["memory"] = memory_to_json(bench.get_latest_memory());
+    record["compute_time"] = metrics.compute_time;
+    record["blocked_time"] = metrics.blocked_time;
+
+    json communication = json::object();
+    for (size_t phase = 0; phase < metrics.traffic.size(); phase++) {
+        if (metrics.traffic[phase].messages > 0) {
+            communication[PerformanceBenchmark::probe_name((int) phase)] = traffic_to_json(metrics.traffic[phase]);
+        }
+    }
+    record["communication"] = communication;
+
+    if (!metrics.hardware_counters.empty()) {
+        json hardware_counters = json::object();
+        for (size_t id = 0; id < metrics.hardware_counters.size(); id++) {
+            if (metrics.hardware_counters[id].measurements > 0) {
+                hardware_counters[PerformanceBenchmark::probe_name((int) id)] = counters_to_json(metrics.hardware_counters[id]);
+            }
+        }
+        record["hardware_counters"] = hardware_counters;
+    }
+
+    if (metrics.has_imbalance) {
+        json imbalance;
+        imbalance["max_over_mean"] = metrics.imbalance;
+        imbalance["idle_time"] = metrics.idle_time;
+        record["imbalance"] = imbalance;
+    }
+
+    json fitness;
+    fitness["min"] = metrics.fitness_min;
+    fitness["max"] = metrics.fitness_max;
+    fitness["mean"] = metrics.fitness_mean;
+    fitness["feasible"] = metrics.feasible_individuals;
+    fitness["early_exits"] = metrics.fitness_cache.early_exits;
+    record["fitness"] = fitness;
+
+    json fitness_cache;
+    fitness_cache["inherited_fitnesses"] = metrics.fitness_cache.inherited_fitnesses;
+    fitness_cache["evaluated_fitnesses"] = metrics.fitness_cache.evaluated_fitnesses;
+    fitness_cache["reused_subjects"] = metrics.fitness_cache.reused_subjects;
+    fitness_cache["computed_subjects"] = metrics.fitness_cache.computed_subjects;
+    record["fitness_cache"] = fitness_cache;
+
+    json local_search;
+    local_search["moves"] = metrics.local_search.moves;
+    local_search["improvements"] = metrics.local_search.improvements;
+    record["local_search"] = local_search;
+
+    if (metrics.has_population_statistics) {
+        const utils::PopulationStatistics& stats = metrics.population_statistics;
+        json population;
+        population["min"] = stats.min;
+        population["max"] = stats.max;
+        population["mean"] = stats.mean;
+        population["median"] = stats.median;
+        population["lower_quartile"] = stats.lower_quartile;
+        population["upper_quartile"] = stats.upper_quartile;
+        population["feasible"] = stats.feasible;
+        population["best_hard_violations"] = stats.best_hard_violations;
+        population["best_soft_fitness"] = stats.best_soft_fitness;
+        population["incomplete"] = stats.incomplete;
+        record["population"] = population;
+    }
+
+    // flushed every generation, so the stream can be followed while the program runs
+    this->out << record.dump() << std::endl;
+}
+
+void MetricsStream::write_summary(std::vector<PerformanceBenchmark>& benches, const std::vector<double>& total_times, const std::string& engine,
+                                  int rounds, int first_feasible_round, double first_feasible_time, double best_fitness) {
+    if (!this->is_enabled()) {
+        return;
+    }
+
+    json summary;
+    summary["processes"] = benches.size();
+    summary["engine"] = engine;
+    summary["rounds"] = rounds;
+    summary["first_feasible_round"] = first_feasible_round;
+    summary["first_feasible_time"] = first_feasible_time;
+    summary["best_fitness"] = best_fitness;
+
+    double total_time = 0;
+    for (double t : total_times) {
+        if (t > total_time) total_time = t;
+    }
+    summary["total_time"] = total_time;
+
+    // all processes merged, then each of them separately
+    PerformanceBenchmark merged;
+    for (auto& bench : benches) {
+        merged.merge(bench);
+    }
+    summary["probes"] = probes_to_json(merged);
+    summary["peak_memory"] = memory_to_json(merged.get_peak_memory());
+    summary["communication"] = communication_to_json(merged);
+    summary["hardware_counters"] = hardware_counters_to_json(merged);
+
+    json processes = json::array();
+    for (size_t process = 0; process < benches.size(); process++) {
+        json p;
+        p["rank"] = process;
+        p["total_time"] = total_times[process];
+        p["probes"] = probes_to_json(benches[process]);
+        p["peak_memory"] = memory_to_json(benches[process].get_peak_memory());
+        p["communication"] = communication_to_json(benches[process]);
+        p["hardware_counters"] = hardware_counters_to_json(benches[process]);
+        processes.push_back(p);
+    }
+    summary["per_process"] = processes;
+
+    std::ofstream summary_out(summary_file_path(this->directory));
+    summary_out << summary.dump(4) << std::endl;
+}
@@ -0,0 +1,104 @@
+#ifndef INCLUDE_METRICS_H
+#define INCLUDE_METRICS_H
+
+#include "performance.h"
+#include "utils.h"
+#include "genetic/fitness.h"
+#include "genetic/local_search.h"
+
+#include <fstream>
+#include <string>
+#include <vector>
+
+/**
+ * The metrics of a single generation of a single process.
+ */
+struct GenerationMetrics {
+    int round;
+    int population_size;
+
+    // the time since the start of the program when the fitnesses of the generation were known
+    double elapsed_time;
+
+    // fitnesses of the individuals evaluated completely by this process
+    double fitness_min;
+    double fitness_max;
+    double fitness_mean;
+    int feasible_individuals;
+
+    // only the master has the whole population
+    bool has_population_statistics;
+    utils::PopulationStatistics population_statistics;
+
+    // the time the process spent computing and blocked in collectives
+    double compute_time;
+    double blocked_time;
+
+    // only the master has the imbalance between the processes
+    bool has_imbalance;
+    double imbalance;   // max / mean compute time
+    double idle_time;   // sum of the time each process waited for the slowest one
+
+    // the communication of the process since the previous record, indexed by the phase
+    std::vector<PerformanceBenchmark::Traffic> traffic;
+
+    // the hardware counters of the process since the previous record, indexed by the probe
+    std::vector<PerformanceBenchmark::HardwareCounters> hardware_counters;
+
+    // how often the fitness evaluations of the generation used the cached fitness terms of individuals
+    FitnessCore::CacheCounts fitness_cache;
+
+    // the moves of the memetic stage of the generation
+    LocalSearch::Counts local_search;
+
+    GenerationMetrics();
+
+    /**
+     * Computes the fitness metrics of the process from its (unpadded) fitnesses.
+     */
+    void set_process_fitnesses(const std::vector<FitnessPair>& fitnesses);
+
+    /**
+     * Computes the imbalance from the compute times of all processes.
+     */
+    void set_imbalance(const std::vector<double>& compute_times);
+};
+
+/**
+ * A machine-readable stream of metrics. Every process writes one JSON object per generation and line
+ * into its own file, so the output of the processes is never interleaved,
+ * and the master writes a summary of the whole run, merged from the benchmarks of all processes.
+ * The stream is disabled if no directory is given.
+ */
+class MetricsStream {
+private:
+    std::string directory;
+    int rank;
+    std::ofstream out;
+
+public:
+    /**
+     * Opens the file of the process. A resumed run appends to it, so the records of the rounds
+     * between the checkpoint and the interruption appear twice, the later ones are those of the resumed run.
+     */
+    MetricsStream(const std::string& directory, int rank, bool resume);
+
+    bool is_enabled() const;
+
+    static std::string file_path(const std::string& directory, int rank);
+    static std::string summary_file_path(const std::string& directory);
+
+    /**
+     * Writes the record of a generation, with the phase timings of its latest measurements.
+     */
+    void write_generation(const GenerationMetrics& metrics, PerformanceBenchmark& bench);
+
+    /**
+     * Writes the summary of the run. The benchmarks and total times are indexed by the rank.
+     * The rounds and the first feasible round are generations of the genetic engine and chain iterations of the others.
+     */
+    void write_summary(std::vector<PerformanceBenchmark>& benches, const std::vector<double>& total_times, const std::string& engine,
+                       int rounds, int first_feasible_round, double first_feasible_time, double best_fitness);
+};
+
+#endif //INCLUDE_METRICS_H
@@ -0,0 +1,200 @@
+#include "occupancy.h"
+#include "timetable.h"
+
+#include <algorithm>
+
+static const int SLOTS_PER_DAY = ActiveTimetableConfig::slots_per_day;
+static const int DAYS_PER_WEEK = ActiveTimetableConfig::days;
+static const int SLOTS = ActiveTimetableConfig::slots;
+
+template <typename Map>
+static int max_id(Map& map) {
+    int result = -1;
+    for (auto& i : map) {
+        result = std::max(result, i.first);
+    }
+    return result;
+}
+
+OccupancyLayout::OccupancyLayout(std::map<int, import::Professor>& professors,
+                                 std::map<int, import::Classroom>& classrooms,
+                                 std::map<int, import::Subject>& subjects) {
+    this->professors = max_id(professors) + 1;
+    this->classrooms = max_id(classrooms) + 1;
+    this->subjects = max_id(subjects) + 1;
+}
+
+OccupancyIndex::OccupancyIndex(const std::shared_ptr<const OccupancyLayout>& layout) {
+    this->layout = layout;
+    this->classroom_counts = count_grid_t((unsigned long) layout->classrooms * SLOTS, 0);
+    this->professor_counts = count_grid_t((unsigned long) layout->professors * SLOTS, 0);
+    this->lecture_counts = count_grid_t((unsigned long) layout->subjects * SLOTS, 0);
+    this->tutorial_counts = count_grid_t((unsigned long) layout->subjects * SLOTS, 0);
+    this->classroom_days = bitmap_grid_t((unsigned long) layout->classrooms * DAYS_PER_WEEK, 0);
+
+    this->classroom_clashes = 0;
+    this->professor_clashes = 0;
+    this->lecture_clashes = 0;
+    this->lecture_tutorial_clashes = 0;
+}
+
+void* OccupancyIndex::operator new(std::size_t size) {
+    memory::count_allocation(memory::OCCUPANCY, size);
+    return ::operator new(size);
+}
+
+void OccupancyIndex::operator delete(void *p, std::size_t size) {
+    memory::count_deallocation(memory::OCCUPANCY, size);
+    ::operator delete(p);
+}
+
+void OccupancyIndex::add(const TimetableEntry& entry) {
+    update(entry, 1);
+}
+
+void OccupancyIndex::remove(const TimetableEntry& entry) {
+    update(entry, -1);
+}
+
+void OccupancyIndex::update(const TimetableEntry& entry, int delta) {
+    if (entry.day >= DAYS_PER_WEEK) {
+        return;
+    }
+    int end_hour = std::min(entry.end_hour(), SLOTS_PER_DAY);
+    int day_slot = entry.day * SLOTS_PER_DAY;
+
+    // a pair is formed with every entry already in the cell when adding, and with every other one when removing
+    bool has_classroom = entry.classroom < this->layout->classrooms;
+    bool has_subject = entry.subject < this->layout->subjects;
+    for (int hour = entry.hour; hour < end_hour; hour++) {
+        int slot = day_slot + hour;
+
+        if (has_classroom) {
+            count_t& count = this->classroom_counts[entry.classroom * SLOTS + slot];
+            if (delta < 0) {
+                count--;
+            }
+            this->classroom_clashes += delta * count;
+            if (delta > 0) {
+                count++;
+            }
+
+            uint32_t& bitmap = this->classroom_days[entry.classroom * DAYS_PER_WEEK + entry.day];
+            if (count == 0) {
+                bitmap &= ~(1u << hour);
+            } else {
+                bitmap |= 1u << hour;
+            }
+        }
+
+        for (timetable_professor_t p : entry.professors) {
+            if (p >= this->layout->professors) {
+                continue;
+            }
+            count_t& count = this->professor_counts[p * SLOTS + slot];
+            if (delta < 0) {
+                count--;
+            }
+            this->professor_clashes += delta * count;
+            if (delta > 0) {
+                count++;
+            }
+        }
+
+        if (has_subject) {
+            count_t& lectures = this->lecture_counts[entry.subject * SLOTS + slot];
+            count_t& tutorials = this->tutorial_counts[entry.subject * SLOTS + slot];
+            if (entry.lectures) {
+                if (delta < 0) {
+                    lectures--;
+                }
+                this->lecture_clashes += delta * lectures;
+                this->lecture_tutorial_clashes += delta * tutorials;
+                if (delta > 0) {
+                    lectures++;
+                }
+            } else {
+                tutorials += delta;
+                this->lecture_tutorial_clashes += delta * lectures;
+            }
+        }
+    }
+}
+
+uint32_t OccupancyIndex::free_starts(timetable_classroom_t classroom, int day, timetable_hour_t duration) const {
+    // a block can start at hour h if none of the hours h to h + duration - 1 are occupied
+    uint32_t occupied = this->classroom_days[classroom * DAYS_PER_WEEK + day];
+    uint32_t occupied_starts = 0;
+    for (int i = 0; i < duration; i++) {
+        occupied_starts |= occupied >> i;
+    }
+
+    // the block must start and end within the allowed hours
+    int first = ActiveTimetableConfig::earliest_hour;
+    int last = ActiveTimetableConfig::latest_hour - duration + 1;
+    if (last < first) {
+        return 0;
+    }
+    uint32_t allowed = (uint32_t) (((1ull << (last + 1)) - 1) & ~((1ull << first) - 1));
+    return allowed & ~occupied_starts;
+}
+
+bool OccupancyIndex::is_classroom_free(timetable_classroom_t classroom, timetable_day_t day, timetable_hour_t hour, timetable_hour_t duration) const {
+    if (classroom >= this->layout->classrooms || day >= DAYS_PER_WEEK) {
+        return true;
+    }
+    uint32_t block = (uint32_t) (((1ull << duration) - 1) << hour);
+    return (this->classroom_days[classroom * DAYS_PER_WEEK + day] & block) == 0;
+}
+
+bool OccupancyIndex::random_free_start(timetable_classroom_t classroom, timetable_hour_t duration, std::mt19937& rand,
+                                       timetable_day_t& day, timetable_hour_t& hour) const {
+    if (classroom >= this->layout->classrooms) {
+        return false;
+    }
+
+    uint32_t starts[DAYS_PER_WEEK];
+    int total = 0;
+    for (int d = 0; d < DAYS_PER_WEEK; d++) {
+        starts[d] = free_starts(classroom, d, duration);
+        total += __builtin_popcount(starts[d]);
+    }
+    if (total == 0) {
+        return false;
+    }
+
+    // the pick-th free start of the week
+    int pick = std::uniform_int_distribution<int>(0, total - 1)(rand);
+    for (int d = 0; d < DAYS_PER_WEEK; d++) {
+        int count = __builtin_popcount(starts[d]);
+        if (pick >= count) {
+            pick -= count;
+            continue;
+        }
+
+        uint32_t remaining = starts[d];
+        for (int i = 0; i < pick; i++) {
+            remaining &= remaining - 1; // clears the lowest set bit
+        }
+        day = (timetable_day_t) d;
+        hour = (timetable_hour_t) __builtin_ctz(remaining);
+        return true;
+    }
+    return false;
+}
+
+bool OccupancyIndex::random_free_classroom(const std::vector<timetable_classroom_t>& candidates,
+                                           timetable_day_t day, timetable_hour_t hour, timetable_hour_t duration,
+                                           std::mt19937& rand, timetable_classroom_t& classroom) const {
+    // reservoir sampling, so the free candidates don't have to be collected
+    int free_count = 0;
+    for (timetable_classroom_t candidate : candidates) {
+        if (is_classroom_free(candidate, day, hour, duration)) {
+            free_count++;
+            if (std::uniform_int_distribution<int>(0, free_count - 1)(rand) == 0) {
+                classroom = candidate;
+            }
+        }
+    }
+    return free_count > 0;
+}
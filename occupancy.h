@@ -0,0 +1,131 @@
+#ifndef INCLUDE_OCCUPANCY_H
+#define INCLUDE_OCCUPANCY_H
+
+#include "timetable_types.h"
+#include "import.h"
+
+#include <map>
+#include <memory>
+#include <random>
+#include <vector>
+
+// forward declaration
+class TimetableEntry;
+
+/**
+ * The dimensions of the occupancy grids of a problem, shared by the occupancy indexes of all individuals.
+ * Grids are indexed by ID, so they have a row for every ID up to the largest one.
+ */
+class OccupancyLayout {
+public:
+    int classrooms;
+    int professors;
+    int subjects;
+
+    OccupancyLayout(std::map<int, import::Professor>& professors,
+                    std::map<int, import::Classroom>& classrooms,
+                    std::map<int, import::Subject>& subjects);
+};
+
+/**
+ * Occupancy grids of a timetable: the number of entries in each classroom x slot, professor x slot
+ * and subject x slot (lectures and tutorials separately), slots indexed as day * slots_per_day + hour.
+ * The clash counts of the fitness (pairs of entries sharing a classroom, a professor or a subject's lecture slot)
+ * are kept up to date as entries are added and removed, so they can be read without comparing entries.
+ * Every classroom also has a bitmap of its occupied hours for each day, to find free slots and classrooms quickly.
+ *
+ * The index describes the entries that were added, the operators that change an indexed timetable must remove
+ * an entry before changing its placement, classroom or professors and add it again afterwards.
+ * IDs outside the layout and hours after the end of the day are not indexed.
+ */
+class OccupancyIndex {
+private:
+    typedef uint16_t count_t;
+    typedef std::vector<count_t, memory::CountingAllocator<count_t, memory::OCCUPANCY>> count_grid_t;
+    typedef std::vector<uint32_t, memory::CountingAllocator<uint32_t, memory::OCCUPANCY>> bitmap_grid_t;
+
+    std::shared_ptr<const OccupancyLayout> layout;
+
+    count_grid_t classroom_counts;
+    count_grid_t professor_counts;
+    count_grid_t lecture_counts;
+    count_grid_t tutorial_counts;
+
+    // bit h of classroom * days + day is set if the classroom is occupied at hour h of the day
+    bitmap_grid_t classroom_days;
+
+    int classroom_clashes;
+    int professor_clashes;
+    int lecture_clashes;
+    int lecture_tutorial_clashes;
+
+    /**
+     * Adds (delta 1) or removes (delta -1) every hour of the entry, updating the clash counts.
+     */
+    void update(const TimetableEntry& entry, int delta);
+
+    /**
+     * The start hours of the day at which a block of the duration fits into the classroom, as a bitmap.
+     */
+    uint32_t free_starts(timetable_classroom_t classroom, int day, timetable_hour_t duration) const;
+
+public:
+    OccupancyIndex(const std::shared_ptr<const OccupancyLayout>& layout);
+
+    // allocations are counted for memory accounting
+    static void* operator new(std::size_t size);
+    static void operator delete(void* p, std::size_t size);
+
+    void add(const TimetableEntry& entry);
+    void remove(const TimetableEntry& entry);
+
+    /**
+     * The number of pairs of entries in the same classroom at the same time, for each hour they share.
+     */
+    inline int get_classroom_clashes() const {
+        return this->classroom_clashes;
+    }
+
+    /**
+     * The number of pairs of entries with the same professor at the same time, for each professor and hour they share.
+     */
+    inline int get_professor_clashes() const {
+        return this->professor_clashes;
+    }
+
+    /**
+     * The number of pairs of lecture blocks of the same subject at the same time, for each hour they share.
+     */
+    inline int get_lecture_clashes() const {
+        return this->lecture_clashes;
+    }
+
+    /**
+     * The number of pairs of a lecture and a tutorial of the same subject at the same time, for each hour they share.
+     */
+    inline int get_lecture_tutorial_clashes() const {
+        return this->lecture_tutorial_clashes;
+    }
+
+    /**
+     * Whether no entry takes place in the classroom during the block.
+     */
+    bool is_classroom_free(timetable_classroom_t classroom, timetable_day_t day, timetable_hour_t hour, timetable_hour_t duration) const;
+
+    /**
+     * Picks a uniformly random start within the allowed hours at which a block of the duration fits into the classroom.
+     * Returns false (and leaves day and hour as they are) if the classroom has no such slot.
+     */
+    bool random_free_start(timetable_classroom_t classroom, timetable_hour_t duration, std::mt19937& rand,
+                           timetable_day_t& day, timetable_hour_t& hour) const;
+
+    /**
+     * Picks a uniformly random classroom of the candidates that is free during the block.
+     * Returns false (and leaves classroom as it is) if none of them is.
+     */
+    bool random_free_classroom(const std::vector<timetable_classroom_t>& candidates,
+                               timetable_day_t day, timetable_hour_t hour, timetable_hour_t duration,
+                               std::mt19937& rand, timetable_classroom_t& classroom) const;
+};
+
+#endif //INCLUDE_OCCUPANCY_H
@@ -1,5 +1,7 @@
 import subprocess
 import re
+import os
+import json
 from datetime import datetime
 from matplotlib import pylab
 import matplotlib.pyplot as plt
@@ -19,7 +21,7 @@ class GenerationStatistics:
     """
     def __init__(self):
         self.number = None
-        self.time = None
+        self.time = None  # the time it took to create the population: the previous generation or the initial one
         self.min = None
         self.max = None
         self.mean = None
@@ -211,6 +213,85 @@ class Run:
         self.process_statistics.sort(key=lambda s: s.pid)
         self.output_processed = True
 
+    def process_metrics(self, directory):
+        """
+        Processes the metrics stream written when metrics_directory is set in the settings.
+        Generations come from the master's stream, process statistics from the summary.
+        The times have the meaning of the program output: a record holds the time of its own generation,
+        which created the population of the next one, and the first population is the initial generation.
+        """
+        with open(os.path.join(directory, "metrics_summary.json"), "r") as f:
+            summary = json.load(f)
+
+        # a resumed run appends to the stream, the later record of a round replaces the earlier one
+        records = {}
+        with open(os.path.join(directory, "metrics_0.jsonl"), "r") as f:
+            for line in f:
+                if line.strip() == "":
+                    continue
+                record = json.loads(line)
+                records[record["round"]] = record
+
+        master_probes = [p["probes"] for p in summary["per_process"] if p["rank"] == 0][0]
+        for number in sorted(records):
+            gen = GenerationStatistics()
+            gen.number = number
+            if number - 1 in records:
+                gen.time = records[number - 1]["phases"]["Complete generation"]
+            elif number == 0:
+                gen.time = master_probes.get("Initial generation", {}).get("max")
+            population = records[number]["population"]
+            gen.min = population["min"]
+            gen.max = population["max"]
+            gen.mean = population["mean"]
+            gen.median = population["median"]
+            gen.lowerq = population["lower_quartile"]
+            gen.upperq = population["upper_quartile"]
+            self.generations.append(gen)
+
+        def triplet(probes, name):
+            t = MinAvgMaxTriplet()
+            if name in probes:
+                t.min = probes[name]["min"]
+                t.avg = probes[name]["avg"]
+                t.max = probes[name]["max"]
+            return t
+
+        for process in summary["per_process"]:
+            probes = process["probes"]
+            stats = ProcessStatistics()
+            stats.pid = process["rank"]
+            stats.total_time = process["total_time"]
+            stats.initial_generation = probes.get("Initial generation", {}).get("max")
+            stats.prerequisite_initialization = probes.get("Prerequisite initialization", {}).get("max")
+            stats.complete_generation = triplet(probes, "Complete generation")
+            stats.fitness_computation = triplet(probes, "Fitness computation")
+            stats.population_fitness_sending = triplet(probes, "Population fitness sending")
+            stats.selection = triplet(probes, "Selection")
+            stats.survivor_indices_broadcast = triplet(probes, "Survivor indices broadcast")
+            stats.survivor_processing = triplet(probes, "Survivor processing")
+            stats.survivor_allgather = triplet(probes, "Survivor allgather")
+            stats.repopulation = triplet(probes, "Repopulation")
+            stats.population_adjustment = triplet(probes, "Population adjustment")
+            self.process_statistics.append(stats)
+
+        self.process_statistics.sort(key=lambda s: s.pid)
+        self.run_ran = True
+        self.output_processed = True
+
+
+def load_run(path):
+    """
+    Loads a run from a metrics directory or, for older runs, from a file with the captured program output.
+    """
+    run = Run()
+    if os.path.isdir(path):
+        run.process_metrics(path)
+    else:
+        with open(path, "r") as f:
+            run.process_output(f.read())
+    return run
+
 
 def import_memory_data(filename):
     """
@@ -243,16 +324,11 @@ def multi_run_round_times_box(input_filenames, processor_counts):
     The processor count at position i matches the file at position i.
     """
     assert len(input_filenames) == len(processor_counts)
-    files = [open(input_filename, "r") for input_filename in input_filenames]
-    contents_strings = [f.read() for f in files]
-    for f in files:
-        f.close()
 
     means = []
     valueses = []
-    for count, contents in zip(processor_counts, contents_strings):
-        run = Run()
-        run.process_output(contents)
+    for count, input_filename in zip(processor_counts, input_filenames):
+        run = load_run(input_filename)
         values = [g.time for g in run.generations][1:]  # skip the first, as it's initial generation
         means.append(sum(values) / len(values))
         valueses.append(values)
@@ -292,10 +368,7 @@ def round_times_plot(filename):
     """
     Plots a scatter plot of generation times.
     """
-    with open(filename, "r") as f:
-        contents = f.read()
-    run = Run()
-    run.process_output(contents)
+    run = load_run(filename)
 
     times = [g.time for g in run.generations][1:]
 
@@ -309,10 +382,7 @@ def round_fitnesses_plot(filename, pattern, minround=None, maxround=None, ylimit
     """
     Prints a scatter plot with a specific pattern, offers min/max functionality.
     """
-    with open(filename, "r") as f:
-        contents = f.read()
-    run = Run()
-    run.process_output(contents)
+    run = load_run(filename)
 
     fitnesses = [g.max for g in run.generations][1:]
 
@@ -337,15 +407,10 @@ def multi_run_speedup_efficiency(input_filenames, processor_counts):
     Input filenames and processor counts must have the same length, elements correspond.
     """
     assert len(input_filenames) == len(processor_counts)
-    files = [open(input_filename, "r") for input_filename in input_filenames]
-    contents_strings = [f.read() for f in files]
-    for f in files:
-        f.close()
 
     means = []
-    for count, contents in zip(processor_counts, contents_strings):
-        run = Run()
-        run.process_output(contents)
+    for count, input_filename in zip(processor_counts, input_filenames):
+        run = load_run(input_filename)
         values = [g.time for g in run.generations][1:]  # skip the first, as it's initial generation
         means.append(sum(values) / len(values))
 
@@ -374,10 +439,7 @@ def time_ratios_computation(filename):
     """
     Computes time ratios.
     """
-    with open(filename, "r") as f:
-        contents = f.read()
-    run = Run()
-    run.process_output(contents)
+    run = load_run(filename)
 
     sequential_time = 0
     parallel_time = 0
@@ -401,10 +463,7 @@ def time_ratios_computation(filename):
     print("total: {}".format(total))
 
 def analyze_single(filename):
-    with open(filename, "r") as f:
-        contents = f.read()
-    run = Run()
-    run.process_output(contents)
+    run = load_run(filename)
 
     avg_round_time = sum([g.time for g in run.generations]) / len(run.generations)
 
@@ -2,179 +2,652 @@
 
 #include <iostream>
 #include <assert.h>
+#include <algorithm>
 #include <iomanip>
 #include <math.h>
+#include <mutex>
 
 const std::string PerformanceBenchmark::separator = "    ";
 
+const int LatencyHistogram::SUB_BUCKET_BITS;
+const int LatencyHistogram::SUB_BUCKETS;
+const int LatencyHistogram::MAGNITUDES;
+
+LatencyHistogram::LatencyHistogram() {
+    this->counts = std::vector<uint64_t>((unsigned long) (MAGNITUDES * SUB_BUCKETS), 0);
+    this->total = 0;
+}
+
+int LatencyHistogram::index_of(uint64_t value) {
+    // small values are stored exactly in the first magnitude
+    if (value < (uint64_t) SUB_BUCKETS) {
+        return (int) value;
+    }
+
+    // otherwise the highest bits after the leading one select the sub-bucket
+    int highest_bit = 63 - __builtin_clzll(value);
+    int shift = highest_bit - SUB_BUCKET_BITS;
+    int sub_bucket = (int) (value >> shift) - SUB_BUCKETS;
+    return (shift + 1) * SUB_BUCKETS + sub_bucket;
+}
+
+uint64_t LatencyHistogram::value_of(int index) {
+    int magnitude = index / SUB_BUCKETS;
+    uint64_t sub_bucket = (uint64_t) (index % SUB_BUCKETS);
+    if (magnitude == 0) {
+        return sub_bucket;
+    }
+
+    int shift = magnitude - 1;
+    uint64_t lowest = (SUB_BUCKETS + sub_bucket) << shift;
+    return lowest + ((uint64_t) 1 << shift) / 2;
+}
+
+void LatencyHistogram::record(uint64_t value) {
+    this->counts[index_of(value)]++;
+    this->total++;
+}
+
+void LatencyHistogram::merge(const LatencyHistogram& other) {
+    for (size_t i = 0; i < this->counts.size(); i++) {
+        this->counts[i] += other.counts[i];
+    }
+    this->total += other.total;
+}
+
+uint64_t LatencyHistogram::percentile(double share) const {
+    if (this->total == 0) {
+        return 0;
+    }
+
+    uint64_t target = (uint64_t) ceil(share * this->total);
+    if (target < 1) {
+        target = 1;
+    }
+
+    uint64_t seen = 0;
+    for (size_t i = 0; i < this->counts.size(); i++) {
+        seen += this->counts[i];
+        if (seen >= target) {
+            return value_of((int) i);
+        }
+    }
+    return value_of((int) this->counts.size() - 1);
+}
+
+uint64_t LatencyHistogram::count() const {
+    return this->total;
+}
+
+PerformanceBenchmark::Probe::Probe() {
+    this->count = 0;
+    this->sum = 0;
+    this->min = 0;
+    this->max = 0;
+    this->last = 0;
+}
+
+PerformanceBenchmark::MemorySample::MemorySample() {
+    this->resident = 0;
+    this->peak_resident = 0;
+    this->timetable_bytes = 0;
+    this->entry_bytes = 0;
+    this->student_set_bytes = 0;
+    this->occupancy_bytes = 0;
+    this->fitness_terms_bytes = 0;
+    this->individuals = 0;
+    this->bytes_per_individual = 0;
+}
+
+void PerformanceBenchmark::MemorySample::include(const MemorySample& other) {
+    this->resident = std::max(this->resident, other.resident);
+    this->peak_resident = std::max(this->peak_resident, other.peak_resident);
+    this->timetable_bytes = std::max(this->timetable_bytes, other.timetable_bytes);
+    this->entry_bytes = std::max(this->entry_bytes, other.entry_bytes);
+    this->student_set_bytes = std::max(this->student_set_bytes, other.student_set_bytes);
+    this->occupancy_bytes = std::max(this->occupancy_bytes, other.occupancy_bytes);
+    this->fitness_terms_bytes = std::max(this->fitness_terms_bytes, other.fitness_terms_bytes);
+    this->individuals = std::max(this->individuals, other.individuals);
+    this->bytes_per_individual = std::max(this->bytes_per_individual, other.bytes_per_individual);
+}
+
+PerformanceBenchmark::Traffic::Traffic() {
+    this->messages = 0;
+    this->bytes = 0;
+    this->serialized_bytes = 0;
+    this->serialization_time = 0;
+}
+
+void PerformanceBenchmark::Traffic::add(const Traffic& other) {
+    this->messages += other.messages;
+    this->bytes += other.bytes;
+    this->serialized_bytes += other.serialized_bytes;
+    this->serialization_time += other.serialization_time;
+}
+
+PerformanceBenchmark::HardwareCounters::HardwareCounters() {
+    this->measurements = 0;
+    for (uint64_t& value : this->values) {
+        value = 0;
+    }
+    this->available = 0;
+}
+
+void PerformanceBenchmark::HardwareCounters::add(const HardwareCounters& other) {
+    if (other.measurements == 0) {
+        return;
+    }
+
+    // an event is only meaningful if it was counted in every measurement
+    this->available = this->measurements == 0 ? other.available : this->available & other.available;
+    this->measurements += other.measurements;
+    for (int event = 0; event < counters::EVENTS; event++) {
+        this->values[event] += other.values[event];
+    }
+}
+
+bool PerformanceBenchmark::HardwareCounters::is_available(counters::Event event) const {
+    return (this->available & (1u << event)) != 0;
+}
+
+/**
+ * The names of all probes, indexed by their IDs. The built-in probes come first, in the order of their IDs.
+ */
+static std::vector<std::string>& probe_names() {
+    static std::vector<std::string> names = {
+            "Total time taken",
+            "Initial generation",
+            "Prerequisite initialization",
+            "Complete generation",
+            "Fitness computation",
+            "Population fitness sending",
+            "Selection",
+            "Survivor indices broadcast",
+            "Survivor processing",
+            "Survivor allgather",
+            "Repopulation",
+            "Population adjustment",
+            "Checkpoint"
+    };
+    return names;
+}
+
+// whether the measurements of each probe are traced, indexed like the names
+static std::vector<bool>& probe_traced() {
+    static std::vector<bool> traced(probe_names().size(), true);
+    return traced;
+}
+
+// probes may be registered by several threads of a threads-only run
+static std::mutex probe_names_mutex;
+
+static thread_local PerformanceBenchmark *current_bench = nullptr;
+
+int PerformanceBenchmark::probe(const std::string& name, bool traced) {
+    std::lock_guard<std::mutex> lock(probe_names_mutex);
+    std::vector<std::string>& names = probe_names();
+    for (size_t id = 0; id < names.size(); id++) {
+        if (names[id] == name) {
+            return (int) id;
+        }
+    }
+
+    names.push_back(name);
+    probe_traced().push_back(traced);
+    return (int) names.size() - 1;
+}
+
+std::string PerformanceBenchmark::probe_name(int id) {
+    std::lock_guard<std::mutex> lock(probe_names_mutex);
+    return probe_names()[id];
+}
+
+PerformanceBenchmark* PerformanceBenchmark::current() {
+    return current_bench;
+}
+
+void PerformanceBenchmark::set_current(PerformanceBenchmark *bench) {
+    current_bench = bench;
+}
+
 PerformanceBenchmark::PerformanceBenchmark() {
+    this->probes = std::vector<Probe>((unsigned long) (CHECKPOINT + 1));
+    this->blocked = 0;
+    this->elapsed_time_offset = 0;
+    this->tracing = false;
+    this->counting = false;
+}
+
+PerformanceBenchmark::Probe& PerformanceBenchmark::get_probe(int id) {
+    if (id < 0) {
+        std::cerr << "Invalid measurement category. " << std::endl;
+        throw std::exception();
+    }
+    if ((size_t) id >= this->probes.size()) {
+        this->probes.resize((unsigned long) (id + 1));
+    }
+    return this->probes[id];
+}
 
+PerformanceBenchmark::Traffic& PerformanceBenchmark::get_traffic(int phase) {
+    if (phase < 0) {
+        std::cerr << "Invalid communication phase. " << std::endl;
+        throw std::exception();
+    }
+    if ((size_t) phase >= this->traffic.size()) {
+        this->traffic.resize((unsigned long) (phase + 1));
+    }
+    return this->traffic[phase];
+}
+
+PerformanceBenchmark::HardwareCounters& PerformanceBenchmark::get_hardware_counters(int id) {
+    if (id < 0) {
+        std::cerr << "Invalid measurement category. " << std::endl;
+        throw std::exception();
+    }
+    if ((size_t) id >= this->hardware_counters.size()) {
+        this->hardware_counters.resize((unsigned long) (id + 1));
+    }
+    return this->hardware_counters[id];
 }
 
 void PerformanceBenchmark::measure_time(int category, bool startend) {
-    hirez_time_t time = std::chrono::high_resolution_clock::now();
+    hirez_time_t time = hirez_clock_t::now();
 
+    Probe& probe = get_probe(category);
     if (startend == START) {
-        switch (category) {
-            case PROGRAM:
-                this->program_start = time;
-                break;
-            case INITIAL_GENERATION:
-                this->initial_generation_start = time;
-                break;
-            case PREREQ_INIT:
-                this->prerequisite_initialization_start = time;
-                break;
-            case GENERATION:
-                this->generation_starts.push_back(time);
-                break;
-            case FITNESS_COMPUTATION:
-                this->fitness_computation_starts.push_back(time);
-                break;
-            case POPULATION_FITNESS_SENDING:
-                this->population_fitness_sending_starts.push_back(time);
-                break;
-            case SELECTION:
-                this->selection_starts.push_back(time);
-                break;
-            case SURVIVOR_INDICES_BROADCAST:
-                this->survivor_indices_broadcast_starts.push_back(time);
-                break;
-            case SURVIVOR_PROCESSING:
-                this->survivor_processing_starts.push_back(time);
-                break;
-            case SURVIVOR_ALLGATHER:
-                this->survivor_allgather_starts.push_back(time);
-                break;
-            case REPOPULATION:
-                this->repopulation_starts.push_back(time);
-                break;
-            case POPULATION_ADJUSTMENT:
-                this->population_adjustment_starts.push_back(time);
-                break;
-            default:
-                std::cerr << "Invalid measurement category. " << std::endl;
-                throw std::exception();
-        }
+        probe.pending_start = time;
     } else {
-        switch (category) {
-            case PROGRAM:
-                this->program_end = time;
-                break;
-            case INITIAL_GENERATION:
-                this->initial_generation_end = time;
-                break;
-            case PREREQ_INIT:
-                this->prerequisite_initialization_end = time;
-                break;
-            case GENERATION:
-                this->generation_ends.push_back(time);
-                break;
-            case FITNESS_COMPUTATION:
-                this->fitness_computation_ends.push_back(time);
-                break;
-            case POPULATION_FITNESS_SENDING:
-                this->population_fitness_sending_ends.push_back(time);
-                break;
-            case SELECTION:
-                this->selection_ends.push_back(time);
-                break;
-            case SURVIVOR_INDICES_BROADCAST:
-                this->survivor_indices_broadcast_ends.push_back(time);
-                break;
-            case SURVIVOR_PROCESSING:
-                this->survivor_processing_ends.push_back(time);
-                break;
-            case SURVIVOR_ALLGATHER:
-                this->survivor_allgather_ends.push_back(time);
-                break;
-            case REPOPULATION:
-                this->repopulation_ends.push_back(time);
-                break;
-            case POPULATION_ADJUSTMENT:
-                this->population_adjustment_ends.push_back(time);
-                break;
-            default:
-                std::cerr << "Invalid measurement category. " << std::endl;
-                throw std::exception();
+        record(category, probe.pending_start, time);
+    }
+}
+
+void PerformanceBenchmark::record(int id, hirez_time_t start, hirez_time_t end) {
+    Probe& probe = get_probe(id);
+
+    if (this->tracing) {
+        bool traced;
+        {
+            std::lock_guard<std::mutex> lock(probe_names_mutex);
+            traced = probe_traced()[id];
+        }
+        if (traced) {
+            TraceEvent event;
+            event.probe = id;
+            event.start = to_nanoseconds(start);
+            event.end = to_nanoseconds(end);
+            this->trace_events.push_back(event);
+        }
+    }
+
+    long long nanoseconds = std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count();
+    uint64_t value = nanoseconds < 0 ? 0 : (uint64_t) nanoseconds;
+
+    if (probe.count == 0 || value < probe.min) probe.min = value;
+    if (probe.count == 0 || value > probe.max) probe.max = value;
+    probe.count++;
+    probe.sum += value;
+    probe.last = value;
+    probe.histogram.record(value);
+}
+
+void PerformanceBenchmark::sample_memory() {
+    MemorySample sample;
+    sample.resident = memory::resident_set_size();
+    sample.peak_resident = memory::peak_resident_set_size();
+    sample.timetable_bytes = memory::live_bytes(memory::TIMETABLES);
+    sample.entry_bytes = memory::live_bytes(memory::ENTRIES);
+    sample.student_set_bytes = memory::live_bytes(memory::STUDENT_SETS);
+    sample.occupancy_bytes = memory::live_bytes(memory::OCCUPANCY);
+    sample.fitness_terms_bytes = memory::live_bytes(memory::FITNESS_TERMS);
+    sample.individuals = memory::live_allocations(memory::TIMETABLES);
+    if (sample.individuals > 0) {
+        sample.bytes_per_individual = 1.0 * (sample.timetable_bytes + sample.entry_bytes + sample.student_set_bytes
+                                             + sample.occupancy_bytes + sample.fitness_terms_bytes) / sample.individuals;
+    }
+    this->memory_latest = sample;
+    this->memory_peak.include(sample);
+}
+
+PerformanceBenchmark::MemorySample PerformanceBenchmark::get_latest_memory() const {
+    return this->memory_latest;
+}
+
+PerformanceBenchmark::MemorySample PerformanceBenchmark::get_peak_memory() const {
+    return this->memory_peak;
+}
+
+void PerformanceBenchmark::add_blocked_time(hirez_clock_t::duration duration) {
+    this->blocked += std::chrono::duration_cast<std::chrono::nanoseconds>(duration).count();
+}
+
+double PerformanceBenchmark::take_blocked_time() {
+    double result = this->blocked / 1e9;
+    this->blocked = 0;
+    return result;
+}
+
+void PerformanceBenchmark::record_traffic(int phase, const Traffic& communication) {
+    get_traffic(phase).add(communication);
+    if ((size_t) phase >= this->generation_traffic.size()) {
+        this->generation_traffic.resize((unsigned long) (phase + 1));
+    }
+    this->generation_traffic[phase].add(communication);
+}
+
+std::vector<int> PerformanceBenchmark::communication_phases() const {
+    std::vector<int> result;
+    for (size_t phase = 0; phase < this->traffic.size(); phase++) {
+        if (this->traffic[phase].messages > 0) {
+            result.push_back((int) phase);
+        }
+    }
+    return result;
+}
+
+PerformanceBenchmark::Traffic PerformanceBenchmark::get_phase_traffic(int phase) const {
+    if (phase < 0 || (size_t) phase >= this->traffic.size()) {
+        return Traffic();
+    }
+    return this->traffic[phase];
+}
+
+std::vector<PerformanceBenchmark::Traffic> PerformanceBenchmark::take_generation_traffic() {
+    std::vector<Traffic> result;
+    result.swap(this->generation_traffic);
+    return result;
+}
+
+void PerformanceBenchmark::enable_counters() {
+    this->counting = true;
+}
+
+bool PerformanceBenchmark::is_counting() const {
+    return this->counting;
+}
+
+void PerformanceBenchmark::record_counters(int id, const counters::Reading& start, const counters::Reading& end) {
+    HardwareCounters measurement;
+    measurement.measurements = 1;
+    measurement.available = counters::available();
+    for (int event = 0; event < counters::EVENTS; event++) {
+        measurement.values[event] = end.values[event] > start.values[event] ? end.values[event] - start.values[event] : 0;
+    }
+
+    get_hardware_counters(id).add(measurement);
+    if ((size_t) id >= this->generation_hardware_counters.size()) {
+        this->generation_hardware_counters.resize((unsigned long) (id + 1));
+    }
+    this->generation_hardware_counters[id].add(measurement);
+}
+
+std::vector<int> PerformanceBenchmark::counted_probes() const {
+    std::vector<int> result;
+    for (size_t id = 0; id < this->hardware_counters.size(); id++) {
+        if (this->hardware_counters[id].measurements > 0) {
+            result.push_back((int) id);
         }
     }
+    return result;
 }
 
-void PerformanceBenchmark::print_simple_time(const std::string tag, hirez_time_t &start, hirez_time_t& end) {
+PerformanceBenchmark::HardwareCounters PerformanceBenchmark::get_probe_counters(int id) const {
+    if (id < 0 || (size_t) id >= this->hardware_counters.size()) {
+        return HardwareCounters();
+    }
+    return this->hardware_counters[id];
+}
+
+std::vector<PerformanceBenchmark::HardwareCounters> PerformanceBenchmark::take_generation_counters() {
+    std::vector<HardwareCounters> result;
+    result.swap(this->generation_hardware_counters);
+    return result;
+}
+
+void PerformanceBenchmark::enable_tracing() {
+    this->tracing = true;
+}
+
+bool PerformanceBenchmark::is_tracing() const {
+    return this->tracing;
+}
+
+const std::vector<TraceEvent>& PerformanceBenchmark::get_trace_events() const {
+    return this->trace_events;
+}
+
+long long PerformanceBenchmark::to_nanoseconds(hirez_time_t time) {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(time.time_since_epoch()).count();
+}
+
+void PerformanceBenchmark::print_simple_time(int id) {
+    Probe& probe = get_probe(id);
+    std::string tag = probe_name(id);
+
     unsigned long len = tag.length();
     const int target_start = 34;
     int spaces_to_insert = (int) (target_start - len);
 
-    std::chrono::duration<double> total_time = end - start;
     std::cout << PerformanceBenchmark::separator << tag << ":";
     for (int i = 0; i < spaces_to_insert; i++) {
         std::cout << " ";
     }
-    std::cout << total_time.count() << " s" << std::endl;
+    std::cout << probe.last / 1e9 << " s" << std::endl;
 }
 
-void PerformanceBenchmark::print_complex_time(const std::string tag, std::vector<hirez_time_t>& starts, std::vector<hirez_time_t>& ends) {
-    assert(starts.size() == ends.size());
+void PerformanceBenchmark::print_complex_time(int id) {
+    ProbeSummary summary = summarize(id);
 
-    unsigned long len = tag.length();
+    unsigned long len = summary.name.length();
     const int target_start = 34;
     int spaces_to_insert = (int) (target_start - len);
 
-    std::chrono::duration<double> min = ends[0] - starts[0];
-    std::chrono::duration<double> max = min;
-    std::chrono::duration<double> avg = min;
-    for (size_t i = 0; i < starts.size(); i++) {
-        std::chrono::duration<double> now = ends[i] - starts[i];
+    std::cout << PerformanceBenchmark::separator << summary.name << ":";
+    for (int i = 0; i < spaces_to_insert; i++) {
+        std::cout << " ";
+    }
+    std::cout << "min " << summary.min << " s; avg " << summary.avg << " s; max " << summary.max << " s; "
+              << "p50 " << summary.p50 << " s; p90 " << summary.p90 << " s; p99 " << summary.p99 << " s"
+              << std::endl;
+}
+
+void PerformanceBenchmark::print_stats() {
+    std::cout << "Performance benchmark: " << std::setprecision(5) << std::endl;
+
+    print_simple_time(PROGRAM);
+    print_simple_time(INITIAL_GENERATION);
+    print_simple_time(PREREQ_INIT);
 
-        if (now < min) min = now;
-        if (now > max) max = now;
+    for (int id = GENERATION; id <= POPULATION_ADJUSTMENT; id++) {
+        print_complex_time(id);
+    }
 
-        avg += now;
+    // checkpoints are optional and their cost is relative to the generation time
+    Probe& checkpoint = get_probe(CHECKPOINT);
+    if (checkpoint.count > 0) {
+        print_complex_time(CHECKPOINT);
+        std::cout << PerformanceBenchmark::separator << "Checkpoint cost: "
+                  << (100.0 * checkpoint.sum / get_probe(GENERATION).sum) << " % of generation time" << std::endl;
     }
 
-    avg /= starts.size();
+    // probes registered by other modules
+    for (size_t id = CHECKPOINT + 1; id < this->probes.size(); id++) {
+        if (this->probes[id].count > 0) {
+            print_complex_time((int) id);
+        }
+    }
 
-    std::cout << PerformanceBenchmark::separator << tag << ":";
-    for (int i = 0; i < spaces_to_insert; i++) {
-        std::cout << " ";
+    // memory, if it was sampled
+    if (memory_peak.peak_resident > 0) {
+        const double mb = 1024.0 * 1024.0;
+        std::cout << PerformanceBenchmark::separator << "Peak resident memory:              " << memory_peak.peak_resident / mb << " MB" << std::endl;
+        std::cout << PerformanceBenchmark::separator << "Peak population memory:            "
+                  << "timetables " << memory_peak.timetable_bytes / mb << " MB; entries " << memory_peak.entry_bytes / mb
+                  << " MB; student sets " << memory_peak.student_set_bytes / mb << " MB; occupancy indexes "
+                  << memory_peak.occupancy_bytes / mb << " MB; fitness terms " << memory_peak.fitness_terms_bytes / mb << " MB" << std::endl;
+        std::cout << PerformanceBenchmark::separator << "Bytes per individual:              " << memory_latest.bytes_per_individual << std::endl;
+    }
+
+    // communication, by phase
+    std::vector<int> phases = communication_phases();
+    if (!phases.empty()) {
+        const double mb = 1024.0 * 1024.0;
+        std::cout << "Communication: " << std::endl;
+        for (int phase : phases) {
+            Traffic& t = this->traffic[phase];
+            std::string tag = probe_name(phase);
+            std::cout << PerformanceBenchmark::separator << tag << ":";
+            for (int i = 0; i < (int) (34 - tag.length()); i++) {
+                std::cout << " ";
+            }
+            std::cout << t.messages << " messages; " << t.bytes / mb << " MB; " << t.serialized_bytes / mb
+                      << " MB serialized; " << t.serialization_time / 1e9 << " s serializing" << std::endl;
+        }
+    }
+
+    // hardware counters, per measurement and relative to the instructions
+    std::vector<int> counted = counted_probes();
+    if (!counted.empty()) {
+        std::cout << "Hardware counters: " << std::endl;
+        for (int id : counted) {
+            HardwareCounters& c = this->hardware_counters[id];
+            std::string tag = probe_name(id);
+            std::cout << PerformanceBenchmark::separator << tag << ":";
+            for (int i = 0; i < (int) (34 - tag.length()); i++) {
+                std::cout << " ";
+            }
+
+            double instructions = (double) c.values[counters::INSTRUCTIONS];
+            if (c.is_available(counters::CYCLES)) {
+                std::cout << "cycles " << 1.0 * c.values[counters::CYCLES] / c.measurements << "; ";
+                if (c.is_available(counters::INSTRUCTIONS) && c.values[counters::CYCLES] > 0) {
+                    std::cout << "IPC " << instructions / c.values[counters::CYCLES] << "; ";
+                }
+            }
+            if (c.is_available(counters::INSTRUCTIONS) && instructions > 0) {
+                counters::Event misses[] = {counters::L1D_MISSES, counters::LLC_MISSES, counters::BRANCH_MISSES};
+                for (counters::Event event : misses) {
+                    if (c.is_available(event)) {
+                        std::cout << counters::event_name(event) << " " << 1000.0 * c.values[event] / instructions << " per 1k instr.; ";
+                    }
+                }
+            }
+            std::cout << c.measurements << " measurements" << std::endl;
+        }
     }
-    std::cout << "min " << min.count() << " s; avg " << avg.count() << " s; max " << max.count() << " s" << std::endl;
 }
 
-void PerformanceBenchmark::print_stats() {
-    std::cout << "Performance benchmark: " << std::setprecision(5) << std::endl;
+void PerformanceBenchmark::merge(const PerformanceBenchmark& other) {
+    for (size_t id = 0; id < other.probes.size(); id++) {
+        const Probe& theirs = other.probes[id];
+        if (theirs.count == 0) {
+            continue;
+        }
+
+        Probe& ours = get_probe((int) id);
+        if (ours.count == 0 || theirs.min < ours.min) ours.min = theirs.min;
+        if (ours.count == 0 || theirs.max > ours.max) ours.max = theirs.max;
+        ours.count += theirs.count;
+        ours.sum += theirs.sum;
+        ours.last = theirs.last;
+        ours.histogram.merge(theirs.histogram);
+    }
 
-    print_simple_time("Total time taken", program_start, program_end);
-    print_simple_time("Initial generation", initial_generation_start, initial_generation_end);
-    print_simple_time("Prerequisite initialization", prerequisite_initialization_start, prerequisite_initialization_end);
+    // memory is per process, so only the largest values are of interest
+    this->memory_peak.include(other.memory_peak);
 
-    print_complex_time("Complete generation", generation_starts, generation_ends);
-    print_complex_time("Fitness computation", fitness_computation_starts, fitness_computation_ends);
-    print_complex_time("Population fitness sending", population_fitness_sending_starts, population_fitness_sending_ends);
-    print_complex_time("Selection", selection_starts, selection_ends);
-    print_complex_time("Survivor indices broadcast", survivor_indices_broadcast_starts, survivor_indices_broadcast_ends);
-    print_complex_time("Survivor processing", survivor_processing_starts, survivor_processing_ends);
-    print_complex_time("Survivor allgather", survivor_allgather_starts, survivor_allgather_ends);
-    print_complex_time("Repopulation", repopulation_starts, repopulation_ends);
-    print_complex_time("Population adjustment", population_adjustment_starts, population_adjustment_ends);
+    for (int phase : other.communication_phases()) {
+        get_traffic(phase).add(other.traffic[phase]);
+    }
+    for (int id : other.counted_probes()) {
+        get_hardware_counters(id).add(other.hardware_counters[id]);
+    }
 }
 
-double PerformanceBenchmark::get_latest_generation_time() {
-    assert(generation_starts.size() == generation_ends.size());
+PerformanceBenchmark::ProbeSummary PerformanceBenchmark::summarize(int id) {
+    Probe& probe = get_probe(id);
 
-    if (generation_starts.size() == 0) {
-        std::chrono::duration<double> dur = initial_generation_end - initial_generation_start;
-        return dur.count();
+    ProbeSummary summary;
+    summary.name = probe_name(id);
+    summary.count = probe.count;
+    summary.min = probe.min / 1e9;
+    summary.avg = probe.count == 0 ? 0 : probe.sum / 1e9 / probe.count;
+    summary.max = probe.max / 1e9;
+
+    // percentiles are bucketed, clamp them to the exact extremes
+    double percentiles[] = {0.5, 0.9, 0.99};
+    double values[3];
+    for (int i = 0; i < 3; i++) {
+        values[i] = std::min(std::max(probe.histogram.percentile(percentiles[i]), probe.min), probe.max) / 1e9;
     }
+    summary.p50 = values[0];
+    summary.p90 = values[1];
+    summary.p99 = values[2];
 
-    std::chrono::duration<double> dur = generation_ends.back() - generation_starts.back();
-    return dur.count();
+    return summary;
 }
 
-double PerformanceBenchmark::get_latest_round_processing_time() {
-    std::chrono::duration<double> fitcomp = fitness_computation_ends.back() - fitness_computation_starts.back();
-    std::chrono::duration<double> surproc = survivor_processing_ends.back() - survivor_processing_starts.back();
-    std::chrono::duration<double> repop = repopulation_ends.back() - repopulation_starts.back();
-    return fitcomp.count() + surproc.count() + repop.count();
+std::vector<int> PerformanceBenchmark::measured_probes() {
+    std::vector<int> result;
+    for (size_t id = 0; id < this->probes.size(); id++) {
+        if (this->probes[id].count > 0) {
+            result.push_back((int) id);
+        }
+    }
+    return result;
+}
+
+double PerformanceBenchmark::get_latest_time(int id) {
+    return get_probe(id).last / 1e9;
+}
+
+double PerformanceBenchmark::get_latest_generation_time() {
+    if (get_probe(GENERATION).count == 0) {
+        return get_probe(INITIAL_GENERATION).last / 1e9;
+    }
+
+    return get_probe(GENERATION).last / 1e9;
+}
+
+double PerformanceBenchmark::get_elapsed_time() {
+    std::chrono::duration<double> dur = hirez_clock_t::now() - get_probe(PROGRAM).pending_start;
+    return this->elapsed_time_offset + dur.count();
+}
+
+void PerformanceBenchmark::set_elapsed_time_offset(double offset) {
+    this->elapsed_time_offset = offset;
+}
+
+double PerformanceBenchmark::get_elapsed_time_offset() {
+    return this->elapsed_time_offset;
+}
+
+ScopedTimer::ScopedTimer(int id, bool blocking) {
+    this->bench = PerformanceBenchmark::current();
+    this->id = id;
+    this->blocking = blocking;
+    this->counting = false;
+    if (this->bench != nullptr) {
+        this->start = hirez_clock_t::now();
+        if (!blocking && this->bench->is_counting()) {
+            this->counting = counters::read(this->start_counters);
+        }
+    }
+}
+
+ScopedTimer::~ScopedTimer() {
+    if (this->bench != nullptr) {
+        if (this->counting) {
+            counters::Reading end_counters;
+            if (counters::read(end_counters)) {
+                this->bench->record_counters(this->id, this->start_counters, end_counters);
+            }
+        }
+
+        hirez_time_t end = hirez_clock_t::now();
+        this->bench->record(this->id, this->start, end);
+        if (this->blocking) {
+            this->bench->add_blocked_time(end - this->start);
+        }
+    }
 }
@@ -1,70 +1,330 @@
 #ifndef INCLUDE_PERFORMANCE_H
 #define INCLUDE_PERFORMANCE_H
 
+#include <boost/serialization/access.hpp>
+#include <boost/serialization/split_member.hpp>
+#include <boost/serialization/string.hpp>
+#include <boost/serialization/vector.hpp>
+
+#include "counters.h"
+#include "memory.h"
+
 #include <chrono>
+#include <cstdint>
 #include <vector>
 #include <string>
 
-typedef std::chrono::time_point<std::chrono::high_resolution_clock> hirez_time_t;
+// a monotonic clock, so measurements are not affected by adjustments of the system time
+typedef std::chrono::steady_clock hirez_clock_t;
+typedef std::chrono::time_point<hirez_clock_t> hirez_time_t;
+
+/**
+ * A fixed-memory latency histogram, in the manner of HDR histograms.
+ * Values (in nanoseconds) are grouped by their highest set bit and then linearly into SUB_BUCKETS sub-buckets,
+ * so every recorded value is known within a relative error of 1 / SUB_BUCKETS regardless of its magnitude.
+ */
+class LatencyHistogram {
+private:
+    friend class boost::serialization::access;
+
+    template<class Archive>
+    void serialize(Archive& ar, const unsigned int version) {
+        ar & this->counts;
+        ar & this->total;
+    }
+
+    static const int SUB_BUCKET_BITS = 5;
+    static const int SUB_BUCKETS = 1 << SUB_BUCKET_BITS;
+    static const int MAGNITUDES = 64 - SUB_BUCKET_BITS + 1;
+
+    std::vector<uint64_t> counts;
+    uint64_t total;
+
+    static int index_of(uint64_t value);
+
+    /**
+     * The middle of the range of values that fall in the bucket.
+     */
+    static uint64_t value_of(int index);
+
+public:
+    LatencyHistogram();
+
+    void record(uint64_t value);
+
+    /**
+     * Adds the values recorded in another histogram.
+     */
+    void merge(const LatencyHistogram& other);
+
+    /**
+     * Gets the value below which the given share (between 0 and 1) of the recorded values lie.
+     */
+    uint64_t percentile(double share) const;
+
+    uint64_t count() const;
+};
+
+/**
+ * A single measurement of a probe, kept for the timeline trace. Times are in nanoseconds of the process' clock.
+ */
+struct TraceEvent {
+    int probe;
+    long long start;
+    long long end;
+
+    template<class Archive>
+    void serialize(Archive& ar, const unsigned int version) {
+        ar & this->probe;
+        ar & this->start;
+        ar & this->end;
+    }
+};
 
 /**
  * A class to measure performance.
- * Facilitates measuring time, storing those values and computing them in a batch.
+ * Measurements are made with named probes, each of which keeps aggregates and a latency histogram of its
+ * durations instead of every time point, so the memory used does not grow with the number of generations.
+ * The main loop phases are built-in probes, other modules register their own and measure them with ScopedTimer.
  */
 class PerformanceBenchmark {
 private:
-    hirez_time_t program_start;
-    hirez_time_t program_end;
+    friend class boost::serialization::access;
 
-    hirez_time_t initial_generation_start;
-    hirez_time_t initial_generation_end;
+    /**
+     * The measurements of a single probe. Durations are in nanoseconds.
+     */
+    struct Probe {
+        hirez_time_t pending_start;
+        uint64_t count;
+        uint64_t sum;
+        uint64_t min;
+        uint64_t max;
+        uint64_t last;
+        LatencyHistogram histogram;
 
-    hirez_time_t prerequisite_initialization_start;
-    hirez_time_t prerequisite_initialization_end;
+        Probe();
 
-    std::vector<hirez_time_t> generation_starts;
-    std::vector<hirez_time_t> generation_ends;
+        template<class Archive>
+        void serialize(Archive& ar, const unsigned int version) {
+            ar & this->count;
+            ar & this->sum;
+            ar & this->min;
+            ar & this->max;
+            ar & this->last;
+            ar & this->histogram;
+        }
+    };
 
-    std::vector<hirez_time_t> fitness_computation_starts;
-    std::vector<hirez_time_t> fitness_computation_ends;
+public:
+    /**
+     * The memory used by the process at some point. All sizes are in bytes.
+     */
+    struct MemorySample {
+        long long resident;
+        long long peak_resident;
 
-    std::vector<hirez_time_t> population_fitness_sending_starts;
-    std::vector<hirez_time_t> population_fitness_sending_ends;
+        // bytes held by the population, from the allocation hooks
+        long long timetable_bytes;
+        long long entry_bytes;
+        long long student_set_bytes;
+        long long occupancy_bytes;
+        long long fitness_terms_bytes;
+        long long individuals;          // the timetables alive, each one is an individual
+        double bytes_per_individual;
 
-    std::vector<hirez_time_t> selection_starts;
-    std::vector<hirez_time_t> selection_ends;
+        MemorySample();
 
-    std::vector<hirez_time_t> survivor_indices_broadcast_starts;
-    std::vector<hirez_time_t> survivor_indices_broadcast_ends;
+        /**
+         * Raises every field to the other sample's value if it is larger.
+         */
+        void include(const MemorySample& other);
 
-    std::vector<hirez_time_t> survivor_processing_starts;
-    std::vector<hirez_time_t> survivor_processing_ends;
+        template<class Archive>
+        void serialize(Archive& ar, const unsigned int version) {
+            ar & this->resident;
+            ar & this->peak_resident;
+            ar & this->timetable_bytes;
+            ar & this->entry_bytes;
+            ar & this->student_set_bytes;
+            ar & this->occupancy_bytes;
+            ar & this->fitness_terms_bytes;
+            ar & this->individuals;
+            ar & this->bytes_per_individual;
+        }
+    };
 
-    std::vector<hirez_time_t> survivor_allgather_starts;
-    std::vector<hirez_time_t> survivor_allgather_ends;
+    /**
+     * The communication of a phase, as seen by one process.
+     * Bytes are the ones the process sent or received, of which the serialized bytes went through Boost serialization,
+     * and messages are the MPI operations it issued. The serialization time (in nanoseconds) is spent packing and unpacking.
+     */
+    struct Traffic {
+        uint64_t messages;
+        uint64_t bytes;
+        uint64_t serialized_bytes;
+        uint64_t serialization_time;
+
+        Traffic();
+
+        void add(const Traffic& other);
+
+        template<class Archive>
+        void serialize(Archive& ar, const unsigned int version) {
+            ar & this->messages;
+            ar & this->bytes;
+            ar & this->serialized_bytes;
+            ar & this->serialization_time;
+        }
+    };
+
+    /**
+     * The hardware counter totals of a probe. Only the events in the mask were available in all of its measurements.
+     */
+    struct HardwareCounters {
+        uint64_t measurements;
+        uint64_t values[counters::EVENTS];
+        unsigned int available;
+
+        HardwareCounters();
+
+        void add(const HardwareCounters& other);
+
+        bool is_available(counters::Event event) const;
+
+        template<class Archive>
+        void serialize(Archive& ar, const unsigned int version) {
+            ar & this->measurements;
+            ar & this->values;
+            ar & this->available;
+        }
+    };
+
+private:
+    /**
+     * Saves the measurements for checkpointing, by probe name so the probe IDs may differ between runs.
+     * The program probe is not stored, it always belongs to the current run.
+     */
+    template<class Archive>
+    void save(Archive& ar, const unsigned int version) const {
+        std::vector<std::string> names;
+        for (size_t id = 0; id < probes.size(); id++) {
+            if (id != PROGRAM && probes[id].count > 0) {
+                names.push_back(probe_name((int) id));
+            }
+        }
+        ar & names;
+        for (auto& name : names) {
+            ar & probes[probe(name)];
+        }
+        ar & memory_latest;
+        ar & memory_peak;
+
+        std::vector<std::string> phases;
+        for (int id : communication_phases()) {
+            phases.push_back(probe_name(id));
+        }
+        ar & phases;
+        for (auto& name : phases) {
+            ar & traffic[probe(name)];
+        }
+
+        std::vector<std::string> counted;
+        for (int id : counted_probes()) {
+            counted.push_back(probe_name(id));
+        }
+        ar & counted;
+        for (auto& name : counted) {
+            ar & hardware_counters[probe(name)];
+        }
+    }
 
-    std::vector<hirez_time_t> repopulation_starts;
-    std::vector<hirez_time_t> repopulation_ends;
+    template<class Archive>
+    void load(Archive& ar, const unsigned int version) {
+        std::vector<std::string> names;
+        ar & names;
+        for (auto& name : names) {
+            ar & get_probe(probe(name));
+        }
+        ar & memory_latest;
+        ar & memory_peak;
 
-    std::vector<hirez_time_t> population_adjustment_starts;
-    std::vector<hirez_time_t> population_adjustment_ends;
+        std::vector<std::string> phases;
+        ar & phases;
+        for (auto& name : phases) {
+            ar & get_traffic(probe(name));
+        }
+
+        std::vector<std::string> counted;
+        ar & counted;
+        for (auto& name : counted) {
+            ar & get_hardware_counters(probe(name));
+        }
+    }
+
+    BOOST_SERIALIZATION_SPLIT_MEMBER()
+
+    // indexed by the probe ID, grown when a probe registered after the benchmark was created is measured
+    std::vector<Probe> probes;
+
+    // the latest memory sample and the largest values of all samples
+    MemorySample memory_latest;
+    MemorySample memory_peak;
+
+    // the time spent blocked in collectives since it was last taken, in nanoseconds
+    uint64_t blocked;
+
+    // the elapsed time of the runs before a resume, in seconds
+    double elapsed_time_offset;
+
+    // the communication of each phase, indexed by the phase's probe ID, for the whole run and since it was last taken
+    std::vector<Traffic> traffic;
+    std::vector<Traffic> generation_traffic;
+
+    // the hardware counters of each probe, indexed like the traffic, only kept if counting is enabled
+    bool counting;
+    std::vector<HardwareCounters> hardware_counters;
+    std::vector<HardwareCounters> generation_hardware_counters;
+
+    // every measurement of the traced probes, only kept if tracing is enabled
+    bool tracing;
+    std::vector<TraceEvent> trace_events;
 
     static const std::string separator;
 
+    Probe& get_probe(int id);
+    Traffic& get_traffic(int phase);
+    HardwareCounters& get_hardware_counters(int id);
+
     /**
-     * Prints data about a single time.
+     * Prints the duration of a probe that is measured once.
      */
-    static void print_simple_time(const std::string tag, hirez_time_t& start, hirez_time_t& end);
+    void print_simple_time(int id);
 
     /**
-     * Prints data about a series of times, including min, max and avg calculations.
+     * Prints min, avg and max and the percentiles of a probe's durations.
      */
-    static void print_complex_time(const std::string tag, std::vector<hirez_time_t>& starts, std::vector<hirez_time_t>& ends);
+    void print_complex_time(int id);
 
 public:
+    /**
+     * The aggregated durations of a probe, in seconds.
+     */
+    struct ProbeSummary {
+        std::string name;
+        uint64_t count;
+        double min;
+        double avg;
+        double max;
+        double p50;
+        double p90;
+        double p99;
+    };
+
     static const bool START = true;
     static const bool END   = false;
 
+    // built-in probes, registered under their printed names before any other probe
     static const int PROGRAM = 0;
     static const int INITIAL_GENERATION = 1;
     static const int PREREQ_INIT = 2;
@@ -77,20 +337,159 @@ public:
     static const int SURVIVOR_ALLGATHER = 9;
     static const int REPOPULATION = 10;
     static const int POPULATION_ADJUSTMENT = 11;
+    static const int CHECKPOINT = 12;
+
+    /**
+     * Gets the ID of the probe with the given name, registering it if it doesn't exist yet.
+     * IDs are shared by all benchmarks of the program, so they can be kept in static variables.
+     * Probes measured many times per generation (e.g. per individual) should not be traced.
+     */
+    static int probe(const std::string& name, bool traced = true);
+
+    static std::string probe_name(int id);
+
+    /**
+     * The benchmark of the calling thread, used by scoped timers. Null if none was set.
+     */
+    static PerformanceBenchmark* current();
+    static void set_current(PerformanceBenchmark* bench);
 
     PerformanceBenchmark();
 
     void measure_time(int category, bool startend);
 
+    /**
+     * Records a duration measured elsewhere.
+     */
+    void record(int id, hirez_time_t start, hirez_time_t end);
+
+    /**
+     * Samples the resident set size and the bytes held by the population.
+     */
+    void sample_memory();
+
+    MemorySample get_latest_memory() const;
+
+    /**
+     * Gets the largest value of each field over all samples.
+     */
+    MemorySample get_peak_memory() const;
+
+    /**
+     * Adds to the time the process spent blocked in collectives.
+     */
+    void add_blocked_time(hirez_clock_t::duration duration);
+
+    /**
+     * Gets the time spent blocked in collectives since the last call.
+     */
+    double take_blocked_time();
+
+    /**
+     * Adds communication to a phase. Phases are named by probes, which need not be measured.
+     */
+    void record_traffic(int phase, const Traffic& communication);
+
+    /**
+     * Gets the phases that have communicated at least once, in the order of their IDs.
+     */
+    std::vector<int> communication_phases() const;
+
+    Traffic get_phase_traffic(int phase) const;
+
+    /**
+     * Gets the communication of each phase since the last call, indexed by the phase.
+     */
+    std::vector<Traffic> take_generation_traffic();
+
+    /**
+     * Starts counting the hardware events of the probes measured with scoped timers.
+     * The counters of the calling thread must have been opened.
+     */
+    void enable_counters();
+    bool is_counting() const;
+
+    /**
+     * Adds the difference of two counter readings to a probe.
+     */
+    void record_counters(int id, const counters::Reading& start, const counters::Reading& end);
+
+    /**
+     * Gets the probes with hardware counters, in the order of their IDs.
+     */
+    std::vector<int> counted_probes() const;
+
+    HardwareCounters get_probe_counters(int id) const;
+
+    /**
+     * Gets the hardware counters of each probe since the last call, indexed by the probe.
+     */
+    std::vector<HardwareCounters> take_generation_counters();
+
+    /**
+     * Starts keeping a trace event for every measurement of a traced probe.
+     */
+    void enable_tracing();
+    bool is_tracing() const;
+    const std::vector<TraceEvent>& get_trace_events() const;
+
+    static long long to_nanoseconds(hirez_time_t time);
+
     void print_stats();
 
+    /**
+     * Adds the measurements of another benchmark, e.g. to combine the benchmarks of all processes.
+     */
+    void merge(const PerformanceBenchmark& other);
+
+    ProbeSummary summarize(int id);
+
+    /**
+     * Gets the IDs of the probes that have been measured at least once.
+     */
+    std::vector<int> measured_probes();
+
+    /**
+     * Gets the last measured duration of a probe.
+     */
+    double get_latest_time(int id);
+
     double get_latest_generation_time();
 
     /**
-     * Gets the time spent on dynamic workloads in the last round.
-     * Dynamic content is the content that can be modified by modifying the node population size.
+     * Gets the time elapsed since the program start was measured, including the runs before a resume.
      */
-    double get_latest_round_processing_time();
+    double get_elapsed_time();
+
+    /**
+     * Sets the time elapsed in the runs before a resume (see Checkpoint), added to the elapsed time.
+     */
+    void set_elapsed_time_offset(double offset);
+
+    double get_elapsed_time_offset();
+};
+
+/**
+ * Measures the time until the end of the scope into a probe of the current thread's benchmark.
+ * Does nothing if the thread has no benchmark.
+ * Collectives are measured as blocking, their time is also added to the benchmark's blocked time.
+ * If the benchmark counts hardware events, they are read around everything but collectives, which mostly wait.
+ */
+class ScopedTimer {
+private:
+    PerformanceBenchmark *bench;
+    int id;
+    bool blocking;
+    hirez_time_t start;
+    bool counting;
+    counters::Reading start_counters;
+
+public:
+    ScopedTimer(int id, bool blocking = false);
+    ~ScopedTimer();
+
+    ScopedTimer(const ScopedTimer&) = delete;
+    ScopedTimer& operator=(const ScopedTimer&) = delete;
 };
 
 
@@ -0,0 +1,224 @@
+#include "problem_generator.h"
+#include "timetable.h"
+
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <limits>
+#include <set>
+
+static const int WEEK_HOURS = ActiveTimetableConfig::days * (ActiveTimetableConfig::latest_hour - ActiveTimetableConfig::earliest_hour + 1);
+
+// the derived number of classrooms leaves this much room for the search
+static const double CLASSROOM_SLACK = 1.5;
+
+// the subjects get the smallest fitting lecture classrooms and random tutorial classrooms, at most this many of each
+static const int CLASSROOMS_PER_SUBJECT = 8;
+
+ProblemParameters::ProblemParameters() {
+    this->students = 1000;
+    this->subjects = 40;
+    this->classrooms = 0;
+    this->subjects_per_student = 5;
+    this->assistants = 0;
+    this->assistants_per_subject = 1;
+    this->assistant_hours = 20;
+    this->tutorial_size = 30;
+    this->overlap_density = 0.8;
+    this->capacity_tightness = 0.8;
+    this->seed = 1;
+}
+
+/**
+ * Fails if the largest ID of an entity doesn't fit its ID type.
+ */
+template <typename T>
+static void check_ids(long long count, const char *entity) {
+    if (count - 1 > (long long) std::numeric_limits<T>::max()) {
+        std::cerr << "The " << count << " " << entity << " don't fit the configured ID width, build with TIMETABLE_WIDE_IDS. " << std::endl;
+        throw std::exception();
+    }
+}
+
+ProblemGenerator::ProblemGenerator(const ProblemParameters& parameters) {
+    this->parameters = parameters;
+}
+
+import::Problem ProblemGenerator::generate() {
+    ProblemParameters& p = this->parameters;
+    if (p.students < 1 || p.subjects < 1 || p.subjects_per_student < 1 || p.subjects_per_student > p.subjects
+            || p.tutorial_size < 1 || p.capacity_tightness <= 0) {
+        std::cerr << "Invalid problem parameters. " << std::endl;
+        throw std::exception();
+    }
+    if (p.assistants <= 0) {
+        p.assistants = std::max(1, p.subjects / 2);
+    }
+    p.assistants_per_subject = std::max(1, std::min(p.assistants_per_subject, p.assistants));
+
+    check_ids<timetable_student_t>(p.students, "students");
+    check_ids<timetable_subject_t>(p.subjects, "subjects");
+    check_ids<timetable_professor_t>(p.subjects + p.assistants, "professors and TAs");
+
+    std::mt19937 rand(p.seed);
+    import::Problem problem;
+
+    generate_students(problem, rand);
+
+    std::vector<int> enrollments((unsigned long) p.subjects, 0);
+    for (auto& s : problem.students) {
+        for (timetable_subject_t subject : s.second.subjects) {
+            enrollments[subject]++;
+        }
+    }
+
+    generate_classrooms(problem, enrollments);
+    generate_subjects(problem, enrollments, rand);
+
+    // every subject has its own professor, the TAs are a shared pool
+    for (int i = 0; i < p.subjects + p.assistants; i++) {
+        import::Professor professor;
+        professor.id = (timetable_professor_t) i;
+        if (i < p.subjects) {
+            professor.name = "prof " + std::to_string(i);
+            professor.available_hours = 0; // professors don't need this limitation
+        } else {
+            professor.name = "assistant " + std::to_string(i - p.subjects);
+            professor.available_hours = (unsigned int) p.assistant_hours;
+        }
+        problem.professors[i] = professor;
+    }
+
+    return problem;
+}
+
+void ProblemGenerator::generate_students(import::Problem& problem, std::mt19937& rand) {
+    const ProblemParameters& p = this->parameters;
+
+    // consecutive students form cohorts, each with its own block of subjects
+    int block = std::min(p.subjects, 2 * p.subjects_per_student);
+    int cohorts = std::max(1, p.subjects / block);
+
+    std::uniform_real_distribution<double> zero_one(0, 1);
+    std::uniform_int_distribution<int> any_subject(0, p.subjects - 1);
+
+    for (int i = 0; i < p.students; i++) {
+        int cohort = (int) ((long long) i * cohorts / p.students);
+        int block_start = cohort * block;
+        int block_end = cohort == cohorts - 1 ? p.subjects : block_start + block;
+        std::uniform_int_distribution<int> block_subject(block_start, block_end - 1);
+
+        std::set<int> taken;
+        while ((int) taken.size() < p.subjects_per_student) {
+            // the cohort's block may have fewer subjects than a student takes
+            bool from_block = zero_one(rand) < p.overlap_density && (int) taken.size() < block_end - block_start;
+            taken.insert(from_block ? block_subject(rand) : any_subject(rand));
+        }
+
+        import::Student student;
+        student.id = (timetable_student_t) i;
+        for (int subject : taken) {
+            student.subjects.push_back((timetable_subject_t) subject);
+        }
+        problem.students[i] = student;
+    }
+}
+
+void ProblemGenerator::generate_classrooms(import::Problem& problem, const std::vector<int>& enrollments) {
+    ProblemParameters& p = this->parameters;
+
+    long long tutorial_groups = 0;
+    for (int e : enrollments) {
+        tutorial_groups += (e + p.tutorial_size - 1) / p.tutorial_size;
+    }
+
+    // lecture and tutorial classrooms in the ratio of the hours they are needed for
+    double lecture_hours = (double) p.subjects * TimetableEntry::LECTURE_DURATION;
+    double tutorial_hours = (double) tutorial_groups * TimetableEntry::TUTORIAL_DURATION;
+    if (p.classrooms <= 0) {
+        p.classrooms = std::max(7, (int) ceil((lecture_hours + tutorial_hours) * CLASSROOM_SLACK / WEEK_HOURS));
+    }
+    check_ids<timetable_classroom_t>(p.classrooms, "classrooms");
+
+    int lecture_classrooms = (int) round(p.classrooms * lecture_hours / (lecture_hours + tutorial_hours));
+    lecture_classrooms = std::max(1, std::min(lecture_classrooms, p.classrooms - 1));
+
+    // lecture capacities fall geometrically from the one that fits the largest subject with the requested tightness
+    // to the one that fits a median subject
+    std::vector<int> sorted_enrollments = enrollments;
+    std::sort(sorted_enrollments.begin(), sorted_enrollments.end());
+    double largest = std::max(1.0, ceil(sorted_enrollments.back() / p.capacity_tightness));
+    double smallest = std::max((double) p.tutorial_size, ceil(sorted_enrollments[sorted_enrollments.size() / 2] / p.capacity_tightness));
+    smallest = std::min(smallest, largest);
+
+    for (int i = 0; i < p.classrooms; i++) {
+        import::Classroom classroom;
+        classroom.id = (timetable_classroom_t) i;
+        if (i < lecture_classrooms) {
+            double progress = lecture_classrooms == 1 ? 0 : 1.0 * i / (lecture_classrooms - 1);
+            classroom.lecture_capacity = (unsigned int) ceil(largest * pow(smallest / largest, progress));
+            classroom.tutorial_capacity = 0;
+        } else {
+            // tutorial classrooms can also take small lectures
+            classroom.lecture_capacity = (unsigned int) p.tutorial_size;
+            classroom.tutorial_capacity = (unsigned int) p.tutorial_size;
+        }
+        problem.classrooms[i] = classroom;
+    }
+}
+
+void ProblemGenerator::generate_subjects(import::Problem& problem, const std::vector<int>& enrollments, std::mt19937& rand) {
+    const ProblemParameters& p = this->parameters;
+
+    // classrooms from the smallest lecture capacity up
+    std::vector<import::Classroom> by_capacity;
+    std::vector<timetable_classroom_t> tutorial_classrooms;
+    for (auto& c : problem.classrooms) {
+        by_capacity.push_back(c.second);
+        if (c.second.tutorial_capacity > 0) {
+            tutorial_classrooms.push_back(c.second.id);
+        }
+    }
+    std::sort(by_capacity.begin(), by_capacity.end(), [](const import::Classroom& a, const import::Classroom& b) {
+        return a.lecture_capacity < b.lecture_capacity;
+    });
+
+    std::uniform_int_distribution<int> any_assistant(0, p.assistants - 1);
+
+    for (int i = 0; i < p.subjects; i++) {
+        import::Subject subject;
+        subject.id = (timetable_subject_t) i;
+
+        // the smallest classrooms that fit the subject with the same slack as the largest one, or the largest one
+        double needed = enrollments[i] / p.capacity_tightness;
+        for (auto& c : by_capacity) {
+            if (c.lecture_capacity >= needed && (int) subject.lecture_classrooms.size() < CLASSROOMS_PER_SUBJECT) {
+                subject.lecture_classrooms.push_back(c.id);
+            }
+        }
+        if (subject.lecture_classrooms.empty()) {
+            subject.lecture_classrooms.push_back(by_capacity.back().id);
+        }
+
+        std::vector<timetable_classroom_t> tutorials = tutorial_classrooms;
+        std::shuffle(tutorials.begin(), tutorials.end(), rand);
+        tutorials.resize(std::min(tutorials.size(), (size_t) CLASSROOMS_PER_SUBJECT));
+        std::sort(tutorials.begin(), tutorials.end());
+        subject.tutorial_classrooms = tutorials;
+
+        subject.professors.push_back((timetable_professor_t) i);
+
+        // every TA gets a subject before any gets a second one, the others are random
+        std::set<int> assistants;
+        assistants.insert(i % p.assistants);
+        while ((int) assistants.size() < p.assistants_per_subject) {
+            assistants.insert(any_assistant(rand));
+        }
+        for (int a : assistants) {
+            subject.teaching_assistants.push_back((timetable_professor_t) (p.subjects + a));
+            subject.teaching_assistant_weights.push_back(1.0 / assistants.size());
+        }
+
+        problem.subjects[i] = subject;
+    }
+}
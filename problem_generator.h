@@ -0,0 +1,59 @@
+#ifndef INCLUDE_PROBLEM_GENERATOR_H
+#define INCLUDE_PROBLEM_GENERATOR_H
+
+#include "import.h"
+
+#include <random>
+#include <vector>
+
+/**
+ * The shape of a generated problem.
+ */
+struct ProblemParameters {
+    int students;
+    int subjects;
+    int classrooms;              // 0 to derive it from the number of subjects
+    int subjects_per_student;
+    int assistants;              // the TA pool, 0 to derive it from the number of subjects
+    int assistants_per_subject;
+    int assistant_hours;         // the hours every TA is available
+    int tutorial_size;           // the capacity of tutorial classrooms
+
+    // the share of a student's subjects taken from the block of subjects of the student's cohort,
+    // the rest are taken uniformly from all subjects: 1 gives few subjects with many common students,
+    // 0 spreads the overlaps over all pairs of subjects
+    double overlap_density;
+
+    // the largest enrollment of a subject divided by the largest lecture capacity
+    // also limits the lecture classrooms of each subject to the ones that fit it with the same slack,
+    // so values close to (or over) 1 leave few classrooms per subject
+    double capacity_tightness;
+
+    unsigned int seed;
+
+    ProblemParameters();
+};
+
+/**
+ * Generates synthetic problems of any size, deterministically for a seed.
+ * Like input_generator.py, every subject has its own professor and lecture, and students are grouped into cohorts
+ * (similar to years) that share a block of subjects, but the sizes and the structure are parameters.
+ */
+class ProblemGenerator {
+private:
+    ProblemParameters parameters;
+
+    void generate_students(import::Problem& problem, std::mt19937& rand);
+    void generate_classrooms(import::Problem& problem, const std::vector<int>& enrollments);
+    void generate_subjects(import::Problem& problem, const std::vector<int>& enrollments, std::mt19937& rand);
+
+public:
+    ProblemGenerator(const ProblemParameters& parameters);
+
+    /**
+     * Generates the problem. Fails if the IDs don't fit the configured ID types (see TIMETABLE_WIDE_IDS).
+     */
+    import::Problem generate();
+};
+
+#endif //INCLUDE_PROBLEM_GENERATOR_H
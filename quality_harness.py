@@ -0,0 +1,210 @@
+"""
+A time-to-quality harness: runs every configuration with a number of seeds and measures how long (in wall time and
+generations) each run takes to reach a set of fitness targets, then reports the distributions per configuration.
+
+Usage: python3 quality_harness.py experiment.json [output.json]
+
+The experiment file describes the configurations as settings that override the ones in xml/settings.xml:
+{
+    "seeds": 10,
+    "threads": 2,
+    "targets": [0.5, 0.9, 0.99],
+    "best_known": null,
+    "configurations": {
+        "baseline": {},
+        "more mutations": {"mutation_probability": 0.3}
+    }
+}
+
+Besides the first hard-feasible generation, a target q is reached when the best fitness is within (1 - q) * |best known|
+of the best known fitness. Unless it's given, the best known fitness is the best one any run reached.
+The program is run from out/ (main_threads, or main_launch with mpirun if "mpi" is true), every run with its own
+settings file, random_seed and metrics directory under out/quality/, where the per-generation metrics are read from.
+"""
+import json
+import os
+import re
+import subprocess
+import sys
+from datetime import datetime
+
+SETTINGS_FILE_LOCATION = "xml/settings.xml"
+OUTPUT_DIRECTORY = "out/quality"
+
+FEASIBLE_TARGET = "feasible"
+
+
+def print_timestamp(string):
+    print("[" + str(datetime.now().strftime("%Y-%m-%d %H:%M:%S")) + "] " + str(string))
+
+
+def write_settings(base_contents, overrides, path):
+    """
+    Writes a settings file with the given elements replaced, or added if the base file doesn't have them.
+    """
+    contents = base_contents
+    for name, value in overrides.items():
+        element = "<{0}>{1}</{0}>".format(name, value)
+        pattern = r"<{0}>.*?</{0}>".format(name)
+        if re.search(pattern, contents, re.DOTALL):
+            contents = re.sub(pattern, element, contents, flags=re.DOTALL)
+        else:
+            # optional settings go after the required ones, so they can simply be appended
+            contents = contents.replace("</settings>", "    " + element + "\n</settings>")
+
+    with open(path, "w") as f:
+        f.write(contents)
+
+
+class QualityRun:
+    """
+    The convergence of a single run: the best fitness and the number of feasible individuals of each generation.
+    """
+    def __init__(self, configuration, seed):
+        self.configuration = configuration
+        self.seed = seed
+        self.rounds = []
+        self.times = []
+        self.best = []
+        self.feasible = []
+
+    def load_metrics(self, directory):
+        with open(os.path.join(directory, "metrics_0.jsonl"), "r") as f:
+            for line in f:
+                if line.strip() == "":
+                    continue
+                record = json.loads(line)
+                self.rounds.append(record["round"])
+                self.times.append(record["elapsed_time"])
+                self.best.append(record["population"]["max"])
+                self.feasible.append(record["population"]["feasible"])
+
+    def final_best(self):
+        return max(self.best) if self.best else None
+
+    def time_to(self, target, best_known):
+        """
+        Returns the generation and the time at which the target was first reached, or None if it never was.
+        """
+        for i in range(len(self.rounds)):
+            if target == FEASIBLE_TARGET:
+                reached = self.feasible[i] > 0
+            else:
+                reached = self.best[i] >= best_known - (1 - target) * abs(best_known)
+            if reached:
+                return self.rounds[i], self.times[i]
+        return None
+
+
+def run_experiment(experiment):
+    seeds = experiment.get("seeds", 10)
+    threads = experiment.get("threads", 2)
+    mpi = experiment.get("mpi", False)
+
+    with open(SETTINGS_FILE_LOCATION, "r") as f:
+        base_contents = f.read()
+
+    runs = []
+    for name, overrides in experiment["configurations"].items():
+        for seed in range(1, seeds + 1):
+            directory = os.path.abspath(os.path.join(OUTPUT_DIRECTORY, re.sub(r"\W+", "_", name), str(seed)))
+            os.makedirs(directory, exist_ok=True)
+
+            settings = dict(overrides)
+            settings["random_seed"] = seed
+            settings["metrics_directory"] = directory
+            settings_path = os.path.join(directory, "settings.xml")
+            write_settings(base_contents, settings, settings_path)
+
+            if mpi:
+                command = ["mpirun", "-np", str(threads), "./main_launch", "--settings", settings_path]
+            else:
+                command = ["./main_threads", str(threads), "--settings", settings_path]
+
+            print_timestamp("Running {} with seed {}. ".format(name, seed))
+            with open(os.path.join(directory, "output.txt"), "w") as output:
+                subprocess.check_call(command, cwd="out/", stdout=output, stderr=subprocess.STDOUT)
+
+            run = QualityRun(name, seed)
+            run.load_metrics(directory)
+            runs.append(run)
+
+    return runs
+
+
+def distribution(values):
+    """
+    Summarizes values (generations or times) with quantiles of the sorted list.
+    """
+    values = sorted(values)
+    if not values:
+        return None
+
+    def quantile(q):
+        return values[min(len(values) - 1, int(q * len(values)))]
+
+    return {
+        "min": values[0],
+        "p25": quantile(0.25),
+        "median": quantile(0.5),
+        "p75": quantile(0.75),
+        "max": values[-1],
+        "mean": sum(values) / len(values),
+        "values": values,
+    }
+
+
+def time_to_quality(runs, targets, best_known=None):
+    """
+    Computes the time-to-target distributions of every configuration.
+    Runs that never reach a target only count in its success rate.
+    """
+    if best_known is None:
+        best_known = max(run.final_best() for run in runs)
+
+    report = {"best_known": best_known, "configurations": {}}
+    for configuration in sorted(set(run.configuration for run in runs)):
+        configuration_runs = [run for run in runs if run.configuration == configuration]
+        result = {"runs": len(configuration_runs), "final_best": distribution([run.final_best() for run in configuration_runs]), "targets": {}}
+
+        for target in [FEASIBLE_TARGET] + targets:
+            reached = [run.time_to(target, best_known) for run in configuration_runs]
+            reached = [r for r in reached if r is not None]
+            result["targets"][str(target)] = {
+                "success_rate": len(reached) / len(configuration_runs),
+                "generations": distribution([r[0] for r in reached]),
+                "time": distribution([r[1] for r in reached]),
+            }
+        report["configurations"][configuration] = result
+    return report
+
+
+def print_report(report):
+    print("Best known fitness: {}".format(report["best_known"]))
+    print("{:24} | {:8} | {:>7} | {:>12} | {:>12}".format("configuration", "target", "success", "median gens", "median time"))
+    print("-" * 76)
+    for configuration, result in report["configurations"].items():
+        for target, t in result["targets"].items():
+            generations = t["generations"]["median"] if t["generations"] else "-"
+            time = "{:.3f} s".format(t["time"]["median"]) if t["time"] else "-"
+            print("{:24} | {:8} | {:6.0f}% | {:>12} | {:>12}".format(configuration[:24], target, t["success_rate"] * 100, generations, time))
+
+
+if __name__ == "__main__":
+    if len(sys.argv) < 2:
+        print(__doc__)
+        sys.exit(1)
+
+    with open(sys.argv[1], "r") as f:
+        experiment = json.load(f)
+
+    runs = run_experiment(experiment)
+    report = time_to_quality(runs, experiment.get("targets", [0.5, 0.9, 0.99]), experiment.get("best_known"))
+    report["seeds"] = experiment.get("seeds", 10)
+    report["threads"] = experiment.get("threads", 2)
+    print_report(report)
+
+    output_path = sys.argv[2] if len(sys.argv) > 2 else os.path.join(OUTPUT_DIRECTORY, "time_to_quality.json")
+    with open(output_path, "w") as f:
+        json.dump(report, f, indent=4)
+    print_timestamp("Report written to {}. ".format(output_path))
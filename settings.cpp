@@ -2,6 +2,41 @@
 #include "tinyxml2/tinyxml2.h"
 
 #include <iostream>
+#include <sstream>
+
+/**
+ * Optional settings are looked up by name so they can be omitted from the file.
+ */
+static double optional_double(tinyxml2::XMLElement *root, const char *name, double default_value) {
+    auto *el = root->FirstChildElement(name);
+    return el == nullptr || el->GetText() == nullptr ? default_value : atof(el->GetText());
+}
+
+static int optional_int(tinyxml2::XMLElement *root, const char *name, int default_value) {
+    auto *el = root->FirstChildElement(name);
+    return el == nullptr || el->GetText() == nullptr ? default_value : atoi(el->GetText());
+}
+
+static std::string optional_string(tinyxml2::XMLElement *root, const char *name, std::string default_value) {
+    auto *el = root->FirstChildElement(name);
+    return el == nullptr || el->GetText() == nullptr ? default_value : std::string(el->GetText());
+}
+
+/**
+ * A whitespace-separated list of numbers, empty if omitted.
+ */
+static std::vector<double> optional_doubles(tinyxml2::XMLElement *root, const char *name) {
+    std::vector<double> result;
+    auto *el = root->FirstChildElement(name);
+    if (el != nullptr && el->GetText() != nullptr) {
+        std::istringstream values(el->GetText());
+        double value;
+        while (values >> value) {
+            result.push_back(value);
+        }
+    }
+    return result;
+}
 
 Settings Settings::import_from_file(std::string file_path) {
     Settings result = Settings();
@@ -23,6 +58,30 @@ Settings Settings::import_from_file(std::string file_path) {
     result.crossover_probability = 1 - result.mutation_probability;
     result.stats_round_divisor   = atoi(stats_round_divisor_el->GetText());
 
+    result.constructive_ratio = optional_double(root, "constructive_ratio", 0.0);
+    result.warm_start_file = optional_string(root, "warm_start_file", "");
+    result.warm_start_ratio = optional_double(root, "warm_start_ratio", 1.0);
+    result.warm_start_mutations = optional_int(root, "warm_start_mutations", 3);
+    result.deviation_penalty = optional_double(root, "deviation_penalty", 0.0);
+    result.checkpoint_interval = optional_int(root, "checkpoint_interval", 0);
+    result.checkpoint_directory = optional_string(root, "checkpoint_directory", ".");
+    result.metrics_directory = optional_string(root, "metrics_directory", "");
+    result.trace_file = optional_string(root, "trace_file", "");
+    result.hardware_counters = optional_int(root, "hardware_counters", 0);
+    result.random_seed = optional_int(root, "random_seed", 0);
+    result.problem_file = optional_string(root, "problem_file", "");
+    result.occupancy_index = optional_int(root, "occupancy_index", 0);
+    result.early_exit_fitness = optional_int(root, "early_exit_fitness", 0);
+    result.local_search_individuals = optional_int(root, "local_search_individuals", 0);
+    result.local_search_moves = optional_int(root, "local_search_moves", 20);
+    result.engine = optional_string(root, "engine", "genetic");
+    result.annealing_iterations = optional_int(root, "annealing_iterations", 10000);
+    result.annealing_initial_temperature = optional_double(root, "annealing_initial_temperature", 1000.0);
+    result.annealing_final_temperature = optional_double(root, "annealing_final_temperature", 1.0);
+    result.tabu_tenure = optional_int(root, "tabu_tenure", 0);
+    result.tempering_exchange_interval = optional_int(root, "tempering_exchange_interval", 100);
+    result.mutation_weights = optional_doubles(root, "mutation_weights");
+
     return result;
 }
 
@@ -34,4 +93,31 @@ void Settings::print_settings() {
     std::cout << "    " << "Mutation probability:  " << this->mutation_probability << std::endl;
     std::cout << "    " << "Crossover probability: " << this->crossover_probability << std::endl;
     std::cout << "    " << "Stats round divisor:   " << this->stats_round_divisor << std::endl;
+    std::cout << "    " << "Constructive ratio:    " << this->constructive_ratio << std::endl;
+    std::cout << "    " << "Warm start file:       " << this->warm_start_file << std::endl;
+    std::cout << "    " << "Warm start ratio:      " << this->warm_start_ratio << std::endl;
+    std::cout << "    " << "Warm start mutations:  " << this->warm_start_mutations << std::endl;
+    std::cout << "    " << "Deviation penalty:     " << this->deviation_penalty << std::endl;
+    std::cout << "    " << "Checkpoint interval:   " << this->checkpoint_interval << std::endl;
+    std::cout << "    " << "Checkpoint directory:  " << this->checkpoint_directory << std::endl;
+    std::cout << "    " << "Metrics directory:     " << this->metrics_directory << std::endl;
+    std::cout << "    " << "Trace file:            " << this->trace_file << std::endl;
+    std::cout << "    " << "Hardware counters:     " << this->hardware_counters << std::endl;
+    std::cout << "    " << "Random seed:           " << this->random_seed << std::endl;
+    std::cout << "    " << "Problem file:          " << this->problem_file << std::endl;
+    std::cout << "    " << "Occupancy index:       " << this->occupancy_index << std::endl;
+    std::cout << "    " << "Early exit fitness:    " << this->early_exit_fitness << std::endl;
+    std::cout << "    " << "Local search individuals: " << this->local_search_individuals << std::endl;
+    std::cout << "    " << "Local search moves:    " << this->local_search_moves << std::endl;
+    std::cout << "    " << "Engine:                " << this->engine << std::endl;
+    std::cout << "    " << "Annealing iterations:  " << this->annealing_iterations << std::endl;
+    std::cout << "    " << "Initial temperature:   " << this->annealing_initial_temperature << std::endl;
+    std::cout << "    " << "Final temperature:     " << this->annealing_final_temperature << std::endl;
+    std::cout << "    " << "Tabu tenure:           " << this->tabu_tenure << std::endl;
+    std::cout << "    " << "Exchange interval:     " << this->tempering_exchange_interval << std::endl;
+    std::cout << "    " << "Mutation weights:     ";
+    for (double weight : this->mutation_weights) {
+        std::cout << " " << weight;
+    }
+    std::cout << (this->mutation_weights.empty() ? " default" : "") << std::endl;
 }
@@ -2,7 +2,10 @@
 #define INCLUDE_SETTINGS_H
 
 #include <boost/serialization/access.hpp>
+#include <boost/serialization/string.hpp>
+#include <boost/serialization/vector.hpp>
 #include <string>
+#include <vector>
 
 class Settings {
 private:
@@ -16,6 +19,29 @@ private:
         ar & this->mutation_probability;
         ar & this->crossover_probability;
         ar & this->stats_round_divisor;
+        ar & this->constructive_ratio;
+        ar & this->warm_start_file;
+        ar & this->warm_start_ratio;
+        ar & this->warm_start_mutations;
+        ar & this->deviation_penalty;
+        ar & this->checkpoint_interval;
+        ar & this->checkpoint_directory;
+        ar & this->metrics_directory;
+        ar & this->trace_file;
+        ar & this->hardware_counters;
+        ar & this->random_seed;
+        ar & this->problem_file;
+        ar & this->occupancy_index;
+        ar & this->early_exit_fitness;
+        ar & this->local_search_individuals;
+        ar & this->local_search_moves;
+        ar & this->engine;
+        ar & this->annealing_iterations;
+        ar & this->annealing_initial_temperature;
+        ar & this->annealing_final_temperature;
+        ar & this->tabu_tenure;
+        ar & this->tempering_exchange_interval;
+        ar & this->mutation_weights;
     }
 
 public:
@@ -26,6 +52,34 @@ public:
     double crossover_probability;
     int stats_round_divisor;
 
+    // optional settings, these have defaults if they are not present in the file
+    double constructive_ratio; // the share of the initial population seeded by the constructive generator
+    std::string warm_start_file; // a previously exported timetable to start from, empty for none
+    double warm_start_ratio;     // the share of the initial population seeded with perturbations of the warm start
+    int warm_start_mutations;    // the maximum number of mutations applied to each warm start individual
+    double deviation_penalty;    // the penalty for each entry placed differently than in the warm start timetable
+    int checkpoint_interval;          // checkpoint every this many rounds, 0 to disable
+    std::string checkpoint_directory; // where each process writes its checkpoint, resume with --resume
+    std::string metrics_directory;    // where the per-generation metrics are written, empty to disable
+    std::string trace_file;           // the timeline trace of all processes (Chrome trace-event format), empty to disable
+    int hardware_counters;            // 1 to count cycles, instructions, cache and branch misses of the kernels, 0 to disable
+    int random_seed;                  // a fixed seed for repeatable runs, 0 to seed by the clock
+    std::string problem_file;         // a problem in the binary format (see generate_problem), empty to import ../gen/*.xml
+    int occupancy_index;              // 1 to keep classroom, professor and subject occupancy grids in every individual, 0 to disable
+    int early_exit_fitness;           // 1 to skip the soft constraints of individuals with more hard violations than the best one, 0 to disable
+                                      // (which ones are skipped depends on the evaluation order, so all individuals with more hard violations
+                                      //  than the best of the population are then ranked by their hard violations only)
+    int local_search_individuals;     // the number of best offspring of each process improved by a hill climb every generation, 0 to disable
+    int local_search_moves;           // the number of moves the hill climb tries on each of them
+    std::string engine;                   // "genetic", "annealing" for a simulated annealing chain on each process
+                                          // or "tempering" for parallel tempering between the chains
+    int annealing_iterations;             // the number of moves of each chain
+    double annealing_initial_temperature; // the temperature falls geometrically from the initial to the final one
+    double annealing_final_temperature;
+    int tabu_tenure;                      // the number of recently left placements a block can't move back to, 0 to disable
+    int tempering_exchange_interval;      // the number of moves between swap attempts of neighbouring chains
+    std::vector<double> mutation_weights; // the relative probabilities of the mutation types, the compound moves are off if omitted
+
     static Settings import_from_file(std::string file_path);
 
     void print_settings();
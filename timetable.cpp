@@ -1,17 +1,38 @@
 #include "json/json.hpp"
 #include "timetable.h"
+#include "performance.h"
 #include "utils.h"
 
+#include <algorithm>
+#include <iostream>
 #include <fstream>
 #include <sstream>
 
 using json = nlohmann::json;
 
+// the constructive generator indexes occupancy grids by day * SLOTS_PER_DAY + hour
+static const int SLOTS_PER_DAY = ActiveTimetableConfig::slots_per_day;
+static const int DAYS_PER_WEEK = ActiveTimetableConfig::days;
+
+const timetable_hour_t TimetableEntry::LECTURE_DURATION;
+const timetable_hour_t TimetableEntry::TUTORIAL_DURATION;
+
 TimetableEntry::TimetableEntry() {
-    this->students = std::set<timetable_student_t>();
+    this->duration = 1;
+    this->students = timetable_student_set_t();
     this->professors = std::set<timetable_professor_t>();
 }
 
+void* TimetableEntry::operator new(std::size_t size) {
+    memory::count_allocation(memory::ENTRIES, size);
+    return ::operator new(size);
+}
+
+void TimetableEntry::operator delete(void *p, std::size_t size) {
+    memory::count_deallocation(memory::ENTRIES, size);
+    ::operator delete(p);
+}
+
 bool TimetableEntry::compare_subject_lectures_classroom_time(const std::shared_ptr<TimetableEntry>& a,
                                                              const std::shared_ptr<TimetableEntry>& b) {
     if (a->subject != b->subject) {
@@ -46,39 +67,18 @@ std::shared_ptr<TimetableEntry> TimetableEntry::clone() {
 
     result->day = this->day;
     result->hour = this->hour;
+    result->duration = this->duration;
     result->subject = this->subject;
     result->lectures = this->lectures;
     result->classroom = this->classroom;
-    result->students = std::set<timetable_student_t>(this->students);
+    result->students = timetable_student_set_t(this->students);
     result->professors = std::set<timetable_professor_t >(this->professors);
 
     return result;
 }
 
-bool TimetableEntry::is_matching_lecture(std::shared_ptr<TimetableEntry>& other) {
-    return    this->lectures && other->lectures
-           && this->subject == other->subject
-           && this->day == other->day
-           && this->hour != other->hour   // prevents comparing with oneself
-           && abs(this->hour - other->hour) <= 2;
-}
-
-bool TimetableEntry::is_matching_lecture_strict(std::shared_ptr<TimetableEntry>& other) {
-    return    this->lectures && other->lectures
-           && this->subject == other->subject
-           && this->day == other->day
-           && this->hour != other->hour   // prevents comparing with oneself
-           && abs(this->hour - other->hour) <= 1;
-}
-
-bool TimetableEntry::is_matching_tutorial(std::shared_ptr<TimetableEntry>& other) {
-    return   !this->lectures && !other->lectures
-           && this->subject == other->subject
-           && this->day == other->day
-           && this->hour != other->hour
-           && this->classroom == other->classroom
-           && abs(this->hour - other->hour) <= 1
-           && this->students == other->students;
+timetable_hour_t TimetableEntry::duration_of(bool lectures) {
+    return lectures ? LECTURE_DURATION : TUTORIAL_DURATION;
 }
 
 void TimetableEntry::print() {
@@ -87,6 +87,7 @@ void TimetableEntry::print() {
         << "\t" << "lectures: " << (this->lectures ? "true" : "false") << std::endl
         << "\t" << "day: " << ((int) this->day) << std::endl
         << "\t" << "hour: " << ((int) this->hour) << std::endl
+        << "\t" << "duration: " << ((int) this->duration) << std::endl
         << "\t" << "classroom: " << ((int) this->classroom) << std::endl
         << "\t" << "students: ";
 
@@ -108,6 +109,16 @@ Timetable::Timetable() {
     this->sorted = false;
 }
 
+void* Timetable::operator new(std::size_t size) {
+    memory::count_allocation(memory::TIMETABLES, size);
+    return ::operator new(size);
+}
+
+void Timetable::operator delete(void *p, std::size_t size) {
+    memory::count_deallocation(memory::TIMETABLES, size);
+    ::operator delete(p);
+}
+
 std::shared_ptr<Timetable> Timetable::clone() {
     std::shared_ptr<Timetable> result = std::shared_ptr<Timetable>(new Timetable());
 
@@ -115,12 +126,28 @@ std::shared_ptr<Timetable> Timetable::clone() {
     for (std::shared_ptr<TimetableEntry>& te : this->timetable_entries) {
         result->timetable_entries.push_back(te->clone());
     }
+    if (this->occupancy != nullptr) {
+        result->occupancy = std::shared_ptr<OccupancyIndex>(new OccupancyIndex(*this->occupancy));
+    }
 
     return result;
 }
 
+void Timetable::index_occupancy(const std::shared_ptr<const OccupancyLayout>& layout) {
+    static const int probe = PerformanceBenchmark::probe("Occupancy indexing", false);
+    ScopedTimer timer(probe);
+
+    this->occupancy = std::shared_ptr<OccupancyIndex>(new OccupancyIndex(layout));
+    for (std::shared_ptr<TimetableEntry>& te : this->timetable_entries) {
+        this->occupancy->add(*te);
+    }
+}
+
 void Timetable::sort() {
     if (!this->sorted) {
+        static const int probe = PerformanceBenchmark::probe("Timetable sort", false);
+        ScopedTimer timer(probe);
+
         std::sort(this->timetable_entries.begin(), this->timetable_entries.end(), TimetableEntry::compare_subject_lectures_classroom_time);
         this->sorted = true;
     }
@@ -148,14 +175,20 @@ TimetableGenerator::TimetableGenerator(std::map<int, import::Professor>& profess
     this->subject_list = utils::map_to_vector<std::map<int, import::Subject>, import::Subject>(subjects);
 
     this->rand = std::mt19937(utils::get_random_seed());
-    this->day_distribution = std::uniform_int_distribution<timetable_day_t>(0, 4);
-    this->contiguous_hour_distribution_lectures = std::uniform_int_distribution<timetable_hour_t>(EARLIEST_HOUR, LATEST_HOUR - 2);
-    this->contiguous_hour_distribution_tutorials = std::uniform_int_distribution<timetable_hour_t>(EARLIEST_HOUR, LATEST_HOUR - 1);
+    this->day_distribution = std::uniform_int_distribution<timetable_day_t>(0, DAYS_PER_WEEK - 1);
+    this->contiguous_hour_distribution_lectures = std::uniform_int_distribution<timetable_hour_t>(EARLIEST_HOUR, LATEST_HOUR - TimetableEntry::LECTURE_DURATION + 1);
+    this->contiguous_hour_distribution_tutorials = std::uniform_int_distribution<timetable_hour_t>(EARLIEST_HOUR, LATEST_HOUR - TimetableEntry::TUTORIAL_DURATION + 1);
 
     // additional precomputation
     for (auto i = subject_list.begin(); i != subject_list.end(); i++) {
         i->populate_students(students);
     }
+
+    for (auto& p : this->professor_list) {
+        this->professor_available_hours[p.id] = p.available_hours;
+    }
+
+    this->subject_conflicts = import::SubjectConflicts(students, subjects);
 }
 
 void Timetable::export_json(std::string file_path) {
@@ -164,7 +197,6 @@ void Timetable::export_json(std::string file_path) {
     for (std::shared_ptr<TimetableEntry>& te : timetable_entries) {
         json te_json;
         te_json["day"] = te->day;
-        te_json["hour"] = te->hour;
         te_json["subject"] = te->subject;
         te_json["lectures"] = te->lectures;
         te_json["classroom"] = te->classroom;
@@ -181,7 +213,10 @@ void Timetable::export_json(std::string file_path) {
         }
         te_json["professors"] = professors_array;
 
-        timetable_entries_array.push_back(te_json);
+        for (int hour = te->hour; hour < te->end_hour(); hour++) {
+            te_json["hour"] = hour;
+            timetable_entries_array.push_back(te_json);
+        }
     }
     result["timetable_entries"] = timetable_entries_array;
 
@@ -191,6 +226,60 @@ void Timetable::export_json(std::string file_path) {
     out_file.close();
 }
 
+std::shared_ptr<Timetable> Timetable::import_json(std::string file_path) {
+    std::ifstream in_file(file_path);
+    if (!in_file.is_open()) {
+        return nullptr;
+    }
+
+    json source;
+    try {
+        in_file >> source;
+    } catch (std::exception& e) {
+        std::cerr << "Could not parse " << file_path << ": " << e.what() << std::endl;
+        return nullptr;
+    }
+
+    std::shared_ptr<Timetable> result = std::shared_ptr<Timetable>(new Timetable());
+    for (json& te_json : source["timetable_entries"]) {
+        std::shared_ptr<TimetableEntry> te(new TimetableEntry());
+        te->day = te_json["day"].get<timetable_day_t>();
+        te->hour = te_json["hour"].get<timetable_hour_t>();
+        te->subject = te_json["subject"].get<timetable_subject_t>();
+        te->lectures = te_json["lectures"].get<bool>();
+        te->classroom = te_json["classroom"].get<timetable_classroom_t>();
+
+        for (json& stud : te_json["students"]) {
+            te->students.insert(stud.get<timetable_student_t>());
+        }
+        for (json& prof : te_json["professors"]) {
+            te->professors.insert(prof.get<timetable_professor_t>());
+        }
+
+        result->timetable_entries.push_back(te);
+    }
+
+    // merge the hours back into blocks: after sorting, the hours of a block are next to each other
+    std::sort(result->timetable_entries.begin(), result->timetable_entries.end(), TimetableEntry::compare_subject_lectures_classroom_time);
+    std::vector<std::shared_ptr<TimetableEntry>> blocks;
+    for (std::shared_ptr<TimetableEntry>& te : result->timetable_entries) {
+        if (!blocks.empty()) {
+            std::shared_ptr<TimetableEntry>& block = blocks.back();
+            if (block->subject == te->subject && block->lectures == te->lectures && block->classroom == te->classroom
+                    && block->day == te->day && block->end_hour() == te->hour
+                    && block->duration < TimetableEntry::duration_of(te->lectures)
+                    && block->students == te->students && block->professors == te->professors) {
+                block->duration++;
+                continue;
+            }
+        }
+        blocks.push_back(te);
+    }
+    result->timetable_entries = blocks;
+
+    return result;
+}
+
 timetable_student_t Timetable::validate_students(timetable_student_t max_student_id) {
     for (std::shared_ptr<TimetableEntry>& te : this->timetable_entries) {
         for (timetable_student_t stud : te->students) {
@@ -202,6 +291,66 @@ timetable_student_t Timetable::validate_students(timetable_student_t max_student
     return 0;
 }
 
+void TimetableGenerator::generate_lectures(import::Subject& s, std::shared_ptr<Timetable>& timetable) {
+    std::vector<import::Classroom> lecture_classrooms = s.get_possible_classrooms(this->classroom_list, true);
+    std::uniform_int_distribution<timetable_classroom_t> lecture_classroom_index_distribution(0, (timetable_classroom_t) (lecture_classrooms.size() - 1));
+
+    timetable_day_t day = this->day_distribution(rand);
+    timetable_hour_t start_hour = this->contiguous_hour_distribution_lectures(rand);
+    timetable_classroom_t lec_clrm = lecture_classrooms[lecture_classroom_index_distribution(rand)].id;
+
+    std::shared_ptr<TimetableEntry> te(new TimetableEntry());
+    te->day = day;
+    te->hour = start_hour;
+    te->duration = TimetableEntry::LECTURE_DURATION;
+    te->subject = s.id;
+    te->lectures = true;
+    te->classroom = lec_clrm;
+    te->students.insert(s.students.begin(), s.students.end());
+    te->professors.insert(s.professors.begin(), s.professors.end());
+
+    timetable->timetable_entries.push_back(te);
+}
+
+void TimetableGenerator::generate_tutorials(import::Subject& s, std::vector<timetable_student_t>& students, std::shared_ptr<Timetable>& timetable) {
+    std::vector<import::Classroom> tutorial_classrooms = s.get_possible_classrooms(this->classroom_list, false);
+    std::uniform_int_distribution<timetable_classroom_t> tutorial_classroom_index_distribution(0, (timetable_classroom_t) (tutorial_classrooms.size() - 1));
+    std::uniform_int_distribution<timetable_professor_t> assistant_index_distribution(0, (timetable_professor_t) (s.teaching_assistants.size() - 1));
+
+    // generate enough tutorial entries for each subject to cover all students
+    int student_count = (int) students.size();
+    int processed_students = 0;
+
+    while (student_count > 0) {
+        timetable_day_t tutorial_day = this->day_distribution(rand);
+        timetable_hour_t tutorial_start_hour = this->contiguous_hour_distribution_tutorials(rand);
+        import::Classroom& tut_clrm = tutorial_classrooms[tutorial_classroom_index_distribution(rand)];
+
+        std::shared_ptr<TimetableEntry> te(new TimetableEntry());
+
+        te->day = tutorial_day;
+        te->hour = tutorial_start_hour;
+        te->duration = TimetableEntry::TUTORIAL_DURATION;
+        te->subject = s.id;
+        te->lectures = false;
+        te->classroom = tut_clrm.id;
+
+        std::vector<timetable_student_t>::const_iterator from = students.begin() + processed_students;
+        std::vector<timetable_student_t>::const_iterator to =
+                                        (tut_clrm.tutorial_capacity >= (students.size() - processed_students)
+                                              ? students.end()
+                                              : students.begin() + processed_students + tut_clrm.tutorial_capacity);
+        te->students.insert(from, to);
+
+        te->professors.insert(s.teaching_assistants[assistant_index_distribution(rand)]);
+
+        timetable->timetable_entries.push_back(te);
+
+        processed_students += tut_clrm.tutorial_capacity;
+        student_count -= tut_clrm.tutorial_capacity;
+    }
+}
+
 std::shared_ptr<Timetable> TimetableGenerator::generate() {
     std::shared_ptr<Timetable> timetable = std::shared_ptr<Timetable>(new Timetable());
 
@@ -215,71 +364,383 @@ std::shared_ptr<Timetable> TimetableGenerator::generate() {
     // generation
     for (auto s : this->subject_list) {
         // generate a lectures entry for each subject
+        generate_lectures(s, timetable);
 
+        // shuffle students in each subject
+        std::shuffle(s.students.begin(), s.students.end(), rand);
+        generate_tutorials(s, s.students, timetable);
+    }
+
+    return timetable;
+}
+
+void TimetableGenerator::place_in_grid(std::shared_ptr<TimetableEntry>& te, std::uniform_int_distribution<timetable_hour_t>& hour_distribution) {
+    if (te->day >= DAYS_PER_WEEK) {
+        te->day = this->day_distribution(rand);
+        te->hour = hour_distribution(rand);
+        return;
+    }
+
+    te->hour = std::max(te->hour, (timetable_hour_t) EARLIEST_HOUR);
+    te->hour = std::min(te->hour, (timetable_hour_t) (LATEST_HOUR - te->duration + 1));
+}
+
+std::shared_ptr<Timetable> TimetableGenerator::repair(std::shared_ptr<Timetable>& previous) {
+    std::shared_ptr<Timetable> timetable = std::shared_ptr<Timetable>(new Timetable());
+
+    std::map<int, std::vector<std::shared_ptr<TimetableEntry>>> previous_lectures;
+    std::map<int, std::vector<std::shared_ptr<TimetableEntry>>> previous_tutorials;
+    for (std::shared_ptr<TimetableEntry>& te : previous->timetable_entries) {
+        if (te->lectures) {
+            previous_lectures[te->subject].push_back(te);
+        } else {
+            previous_tutorials[te->subject].push_back(te);
+        }
+    }
+
+    std::map<timetable_classroom_t, import::Classroom> classrooms;
+    for (auto& c : this->classroom_list) {
+        classrooms[c.id] = c;
+    }
+
+    for (auto s : this->subject_list) {
         std::vector<import::Classroom> lecture_classrooms = s.get_possible_classrooms(this->classroom_list, true);
         std::vector<import::Classroom> tutorial_classrooms = s.get_possible_classrooms(this->classroom_list, false);
-
         std::uniform_int_distribution<timetable_classroom_t> lecture_classroom_index_distribution(0, (timetable_classroom_t) (lecture_classrooms.size() - 1));
         std::uniform_int_distribution<timetable_classroom_t> tutorial_classroom_index_distribution(0, (timetable_classroom_t) (tutorial_classrooms.size() - 1));
         std::uniform_int_distribution<timetable_professor_t> assistant_index_distribution(0, (timetable_professor_t) (s.teaching_assistants.size() - 1));
+        std::set<timetable_student_t> subject_students(s.students.begin(), s.students.end());
 
-
-        timetable_day_t day = this->day_distribution(rand);
-        timetable_hour_t start_hour = this->contiguous_hour_distribution_lectures(rand);
-        timetable_classroom_t lec_clrm = lecture_classrooms[lecture_classroom_index_distribution(rand)].id;
-        for (timetable_hour_t j = 0; j < 3; j++) {
+        // lectures: keep the earliest block, extending it to a whole block if it was cut short
+        std::vector<std::shared_ptr<TimetableEntry>>& lectures = previous_lectures[s.id];
+        if (lectures.empty()) {
+            generate_lectures(s, timetable);
+        } else {
+            std::sort(lectures.begin(), lectures.end(), TimetableEntry::compare_time);
             std::shared_ptr<TimetableEntry> te(new TimetableEntry());
 
-            te->day = day;
-            te->hour = start_hour + j;
+            te->day = lectures.front()->day;
+            te->hour = lectures.front()->hour;
+            te->duration = TimetableEntry::LECTURE_DURATION;
+            place_in_grid(te, this->contiguous_hour_distribution_lectures);
             te->subject = s.id;
             te->lectures = true;
-            te->classroom = lec_clrm;
+            te->classroom = lectures.front()->classroom;
+            if (std::find(s.lecture_classrooms.begin(), s.lecture_classrooms.end(), te->classroom) == s.lecture_classrooms.end()) {
+                te->classroom = lecture_classrooms[lecture_classroom_index_distribution(rand)].id;
+            }
             te->students.insert(s.students.begin(), s.students.end());
             te->professors.insert(s.professors.begin(), s.professors.end());
 
             timetable->timetable_entries.push_back(te);
         }
 
-        // generate enough tutorial entries for each subject to cover all students
-        int student_count = (int) s.students.size();
-        int processed_students = 0;
+        // tutorials: every block is a group, keeping only students that still take the subject
+        std::vector<std::shared_ptr<TimetableEntry>>& tutorials = previous_tutorials[s.id];
+        std::vector<std::shared_ptr<TimetableEntry>> groups;
+        std::set<timetable_student_t> assigned_students;
+        for (size_t i = 0; i < tutorials.size(); i++) {
+            std::shared_ptr<TimetableEntry> start = tutorials[i]->clone();
+            start->duration = TimetableEntry::TUTORIAL_DURATION;
+            place_in_grid(start, this->contiguous_hour_distribution_tutorials);
+
+            if (std::find(s.tutorial_classrooms.begin(), s.tutorial_classrooms.end(), start->classroom) == s.tutorial_classrooms.end()) {
+                start->classroom = tutorial_classrooms[tutorial_classroom_index_distribution(rand)].id;
+            }
 
-        // shuffle students in each subject
+            std::set<timetable_professor_t> assistants;
+            for (timetable_professor_t p : start->professors) {
+                if (std::find(s.teaching_assistants.begin(), s.teaching_assistants.end(), p) != s.teaching_assistants.end()) {
+                    assistants.insert(p);
+                }
+            }
+            if (assistants.empty()) {
+                assistants.insert(s.teaching_assistants[assistant_index_distribution(rand)]);
+            }
+            start->professors = assistants;
+
+            // students can only be in a single group and over-full groups are trimmed
+            timetable_student_set_t group_students;
+            for (timetable_student_t stud : start->students) {
+                if (group_students.size() >= classrooms[start->classroom].tutorial_capacity) {
+                    break;
+                }
+                if (subject_students.count(stud) == 1 && assigned_students.count(stud) == 0) {
+                    group_students.insert(stud);
+                    assigned_students.insert(stud);
+                }
+            }
+            start->students = group_students;
+
+            if (!start->students.empty()) {
+                groups.push_back(start);
+            }
+        }
+
+        // new students first fill up free capacity in existing groups
+        std::vector<timetable_student_t> unassigned_students;
+        for (timetable_student_t stud : s.students) {
+            if (assigned_students.count(stud) == 0) {
+                unassigned_students.push_back(stud);
+            }
+        }
+        std::shuffle(unassigned_students.begin(), unassigned_students.end(), rand);
+        for (auto& group : groups) {
+            while (!unassigned_students.empty() && group->students.size() < classrooms[group->classroom].tutorial_capacity) {
+                group->students.insert(unassigned_students.back());
+                unassigned_students.pop_back();
+            }
+        }
+
+        for (auto& group : groups) {
+            timetable->timetable_entries.push_back(group);
+        }
+        generate_tutorials(s, unassigned_students, timetable);
+    }
+
+    return timetable;
+}
+
+std::shared_ptr<Timetable> TimetableGenerator::generate_constructive() {
+    std::shared_ptr<Timetable> timetable = std::shared_ptr<Timetable>(new Timetable());
+
+    std::shuffle(this->classroom_list.begin(), this->classroom_list.end(), rand);
+    std::shuffle(this->subject_list.begin(), this->subject_list.end(), rand);
+
+    // graph colouring order: the most conflicted subjects are placed first, the shuffle above randomizes ties
+    std::vector<import::Subject> subject_order = this->subject_list;
+    std::map<timetable_subject_t, int> subject_degrees;
+    for (auto& subj : subject_order) {
+        subject_degrees[subj.id] = this->subject_conflicts.degree(subj.id);
+    }
+    std::stable_sort(subject_order.begin(), subject_order.end(), [&subject_degrees](const import::Subject& a, const import::Subject& b) {
+        return subject_degrees[a.id] > subject_degrees[b.id];
+    });
+
+    // occupancy grids
+    const int num_slots = DAYS_PER_WEEK * SLOTS_PER_DAY;
+    std::map<timetable_classroom_t, std::vector<bool>> classroom_occupancy;
+    std::map<timetable_professor_t, std::vector<bool>> professor_occupancy;
+    std::map<timetable_professor_t, unsigned int> professor_loads;
+    std::vector<std::set<timetable_subject_t>> slot_lecture_subjects((unsigned long) num_slots);
+    for (auto& c : this->classroom_list) {
+        classroom_occupancy[c.id] = std::vector<bool>((unsigned long) num_slots, false);
+    }
+    for (auto& p : this->professor_list) {
+        professor_occupancy[p.id] = std::vector<bool>((unsigned long) num_slots, false);
+        professor_loads[p.id] = 0;
+    }
+
+    // lectures are free if no professor or classroom is busy, soft-free if additionally no conflicting subject has lectures
+    auto professor_free = [&professor_occupancy](timetable_professor_t p, int slot) {
+        auto it = professor_occupancy.find(p);
+        return it == professor_occupancy.end() || !it->second[slot];
+    };
+    auto conflict_free = [this, &slot_lecture_subjects](timetable_subject_t subject, int slot) {
+        for (timetable_subject_t other : slot_lecture_subjects[slot]) {
+            if (other != subject && this->subject_conflicts.shared(subject, other) > 0) {
+                return false;
+            }
+        }
+        return true;
+    };
+
+    std::vector<std::pair<timetable_day_t, timetable_hour_t>> lecture_starts;
+    std::vector<std::pair<timetable_day_t, timetable_hour_t>> tutorial_starts;
+    for (timetable_day_t day = 0; day < DAYS_PER_WEEK; day++) {
+        for (timetable_hour_t hour = EARLIEST_HOUR; hour <= LATEST_HOUR - TimetableEntry::LECTURE_DURATION + 1; hour++) {
+            lecture_starts.push_back(std::make_pair(day, hour));
+        }
+        for (timetable_hour_t hour = EARLIEST_HOUR; hour <= LATEST_HOUR - TimetableEntry::TUTORIAL_DURATION + 1; hour++) {
+            tutorial_starts.push_back(std::make_pair(day, hour));
+        }
+    }
+
+    for (auto s : subject_order) {
+        std::vector<import::Classroom> lecture_classrooms = s.get_possible_classrooms(this->classroom_list, true);
+        std::vector<import::Classroom> tutorial_classrooms = s.get_possible_classrooms(this->classroom_list, false);
+
+        // lectures: one contiguous block
+        bool lecture_placed = false;
+        timetable_day_t lecture_day = 0;
+        timetable_hour_t lecture_start = 0;
+        timetable_classroom_t lecture_classroom = 0;
+        std::shuffle(lecture_starts.begin(), lecture_starts.end(), rand);
+        for (int pass = 0; pass < 2 && !lecture_placed; pass++) {
+            for (auto& start : lecture_starts) {
+                int first_slot = start.first * SLOTS_PER_DAY + start.second;
+
+                bool slots_free = true;
+                for (int j = 0; j < TimetableEntry::LECTURE_DURATION && slots_free; j++) {
+                    for (timetable_professor_t p : s.professors) {
+                        slots_free = slots_free && professor_free(p, first_slot + j);
+                    }
+                    // the first pass also avoids student conflicts
+                    slots_free = slots_free && (pass == 1 || conflict_free(s.id, first_slot + j));
+                }
+                if (!slots_free) {
+                    continue;
+                }
+
+                for (auto& c : lecture_classrooms) {
+                    std::vector<bool>& occupancy = classroom_occupancy[c.id];
+                    bool classroom_free = c.lecture_capacity >= s.students.size();
+                    for (int j = 0; j < TimetableEntry::LECTURE_DURATION && classroom_free; j++) {
+                        classroom_free = !occupancy[first_slot + j];
+                    }
+                    if (!classroom_free) {
+                        continue;
+                    }
+
+                    lecture_placed = true;
+                    lecture_day = start.first;
+                    lecture_start = start.second;
+                    lecture_classroom = c.id;
+                    break;
+                }
+
+                if (lecture_placed) {
+                    break;
+                }
+            }
+        }
+
+        if (!lecture_placed) {
+            std::uniform_int_distribution<timetable_classroom_t> lecture_classroom_index_distribution(0, (timetable_classroom_t) (lecture_classrooms.size() - 1));
+            lecture_day = this->day_distribution(rand);
+            lecture_start = this->contiguous_hour_distribution_lectures(rand);
+            lecture_classroom = lecture_classrooms[lecture_classroom_index_distribution(rand)].id;
+        }
+
+        std::shared_ptr<TimetableEntry> lecture(new TimetableEntry());
+        lecture->day = lecture_day;
+        lecture->hour = lecture_start;
+        lecture->duration = TimetableEntry::LECTURE_DURATION;
+        lecture->subject = s.id;
+        lecture->lectures = true;
+        lecture->classroom = lecture_classroom;
+        lecture->students.insert(s.students.begin(), s.students.end());
+        lecture->professors.insert(s.professors.begin(), s.professors.end());
+        timetable->timetable_entries.push_back(lecture);
+
+        int lecture_first_slot = lecture_day * SLOTS_PER_DAY + lecture_start;
+        for (int j = 0; j < TimetableEntry::LECTURE_DURATION; j++) {
+            classroom_occupancy[lecture_classroom][lecture_first_slot + j] = true;
+            for (timetable_professor_t p : s.professors) {
+                if (professor_occupancy.count(p) == 1) {
+                    professor_occupancy[p][lecture_first_slot + j] = true;
+                }
+            }
+            slot_lecture_subjects[lecture_first_slot + j].insert(s.id);
+        }
+
+        // tutorials: double cycles, each group is as large as the chosen classroom allows
         std::shuffle(s.students.begin(), s.students.end(), rand);
+        std::vector<timetable_professor_t> assistants = s.teaching_assistants;
+        int processed_students = 0;
+        while (processed_students < (int) s.students.size()) {
+            bool tutorial_placed = false;
+            timetable_day_t tutorial_day = 0;
+            timetable_hour_t tutorial_start = 0;
+            import::Classroom tutorial_classroom;
+            timetable_professor_t assistant = 0;
+
+            std::shuffle(tutorial_starts.begin(), tutorial_starts.end(), rand);
+            std::shuffle(tutorial_classrooms.begin(), tutorial_classrooms.end(), rand);
+            std::shuffle(assistants.begin(), assistants.end(), rand);
+            for (int pass = 0; pass < 2 && !tutorial_placed; pass++) {
+                for (auto& start : tutorial_starts) {
+                    int first_slot = start.first * SLOTS_PER_DAY + start.second;
+
+                    // tutorials can't overlap the subject's own lectures
+                    if (start.first == lecture_day && start.second + TimetableEntry::TUTORIAL_DURATION > lecture_start
+                            && start.second < lecture_start + TimetableEntry::LECTURE_DURATION) {
+                        continue;
+                    }
+                    bool slots_free = true;
+                    for (int j = 0; j < TimetableEntry::TUTORIAL_DURATION && slots_free; j++) {
+                        slots_free = pass == 1 || conflict_free(s.id, first_slot + j);
+                    }
+                    if (!slots_free) {
+                        continue;
+                    }
+
+                    for (auto& c : tutorial_classrooms) {
+                        std::vector<bool>& occupancy = classroom_occupancy[c.id];
+                        bool classroom_free = c.tutorial_capacity > 0;
+                        for (int j = 0; j < TimetableEntry::TUTORIAL_DURATION && classroom_free; j++) {
+                            classroom_free = !occupancy[first_slot + j];
+                        }
+                        if (!classroom_free) {
+                            continue;
+                        }
+
+                        for (timetable_professor_t a : assistants) {
+                            bool assistant_free = professor_loads[a] + TimetableEntry::TUTORIAL_DURATION <= this->professor_available_hours[a];
+                            for (int j = 0; j < TimetableEntry::TUTORIAL_DURATION && assistant_free; j++) {
+                                assistant_free = professor_free(a, first_slot + j);
+                            }
+                            if (!assistant_free) {
+                                continue;
+                            }
+
+                            tutorial_placed = true;
+                            tutorial_day = start.first;
+                            tutorial_start = start.second;
+                            tutorial_classroom = c;
+                            assistant = a;
+                            break;
+                        }
+
+                        if (tutorial_placed) {
+                            break;
+                        }
+                    }
+
+                    if (tutorial_placed) {
+                        break;
+                    }
+                }
+            }
 
-        while (student_count > 0) {
-            timetable_day_t tutorial_day = this->day_distribution(rand);
-            timetable_hour_t tutorial_start_hour = this->contiguous_hour_distribution_tutorials(rand);
-            import::Classroom& tut_clrm = tutorial_classrooms[tutorial_classroom_index_distribution(rand)];
+            if (!tutorial_placed) {
+                std::uniform_int_distribution<timetable_classroom_t> tutorial_classroom_index_distribution(0, (timetable_classroom_t) (tutorial_classrooms.size() - 1));
+                std::uniform_int_distribution<timetable_professor_t> assistant_index_distribution(0, (timetable_professor_t) (assistants.size() - 1));
+                tutorial_day = this->day_distribution(rand);
+                tutorial_start = this->contiguous_hour_distribution_tutorials(rand);
+                tutorial_classroom = tutorial_classrooms[tutorial_classroom_index_distribution(rand)];
+                assistant = assistants[assistant_index_distribution(rand)];
+            }
 
             std::shared_ptr<TimetableEntry> te(new TimetableEntry());
 
             te->day = tutorial_day;
-            te->hour = tutorial_start_hour;
+            te->hour = tutorial_start;
+            te->duration = TimetableEntry::TUTORIAL_DURATION;
             te->subject = s.id;
             te->lectures = false;
-            te->classroom = tut_clrm.id;
+            te->classroom = tutorial_classroom.id;
 
             std::vector<timetable_student_t>::const_iterator from = s.students.begin() + processed_students;
             std::vector<timetable_student_t>::const_iterator to =
-                                            (tut_clrm.tutorial_capacity >= (s.students.size() - processed_students)
+                                            (tutorial_classroom.tutorial_capacity >= (s.students.size() - processed_students)
                                                   ? s.students.end()
-                                                  : s.students.begin() + processed_students + tut_clrm.tutorial_capacity);
+                                                  : s.students.begin() + processed_students + tutorial_classroom.tutorial_capacity);
             te->students.insert(from, to);
-
-            te->professors.insert(s.teaching_assistants[assistant_index_distribution(rand)]);
-
-            // another (must be double)
-            std::shared_ptr<TimetableEntry> matching = te->clone();
-            matching->hour += 1;
+            te->professors.insert(assistant);
 
             timetable->timetable_entries.push_back(te);
-            timetable->timetable_entries.push_back(matching);
 
+            int first_slot = tutorial_day * SLOTS_PER_DAY + tutorial_start;
+            for (int j = 0; j < TimetableEntry::TUTORIAL_DURATION; j++) {
+                classroom_occupancy[tutorial_classroom.id][first_slot + j] = true;
+                if (professor_occupancy.count(assistant) == 1) {
+                    professor_occupancy[assistant][first_slot + j] = true;
+                }
+            }
+            professor_loads[assistant] += TimetableEntry::TUTORIAL_DURATION;
 
-            processed_students += tut_clrm.tutorial_capacity;
-            student_count -= tut_clrm.tutorial_capacity;
+            processed_students += tutorial_classroom.tutorial_capacity;
         }
     }
 
@@ -3,16 +3,21 @@
 
 #include "timetable_types.h"
 #include "import.h"
+#include "occupancy.h"
 #include "genetic/fitness.h"
 
 #include <boost/serialization/set.hpp>
 #include <boost/serialization/shared_ptr.hpp>
 
+#include <algorithm>
 #include <set>
 #include <vector>
 #include <memory>
 #include <random>
 
+// forward declaration
+class FitnessTerms;
+
 //////////////////////
 // TYPE DEFINITIONS //
 //////////////////////
@@ -25,6 +30,7 @@ private:
     void serialize(Archive& ar, const unsigned int version) {
         ar & this->day;
         ar & this->hour;
+        ar & this->duration;
         ar & this->subject;
         ar & this->lectures;
         ar & this->classroom;
@@ -33,15 +39,24 @@ private:
     }
 
 public:
+    // lectures are a single block of three hours a week, tutorials a double cycle of two hours
+    static const timetable_hour_t LECTURE_DURATION = 3;
+    static const timetable_hour_t TUTORIAL_DURATION = 2;
+
     TimetableEntry();
     timetable_day_t day;    // 0 - 6 where 0 is monday
-    timetable_hour_t hour;   // 0 - 23 where 0 is midnight
+    timetable_hour_t hour;   // 0 - 23 where 0 is midnight, the first hour of the block
+    timetable_hour_t duration; // the number of contiguous hours, see LECTURE_DURATION and TUTORIAL_DURATION
     timetable_subject_t subject;
-    bool lectures; // true: lectures (3h per week), false: tutorials (2h per week)
+    bool lectures; // true: lectures, false: tutorials
     timetable_classroom_t classroom;
-    std::set<timetable_student_t> students;
+    timetable_student_set_t students;
     std::set<timetable_professor_t> professors;
 
+    // allocations are counted for memory accounting
+    static void* operator new(std::size_t size);
+    static void operator delete(void* p, std::size_t size);
+
     /**
      * Compares two timetable entries: sorting by subject, then by whether these are lectures,
      * then by classroom, then by time. This is required for crossover alignment.
@@ -58,22 +73,25 @@ public:
      */
     std::shared_ptr<TimetableEntry> clone();
 
-    /**
-     * Whether the two entries match each other as lectures - they are within range of each other.
-     * Does not return true when comparing with oneself.
-     */
-    bool is_matching_lecture(std::shared_ptr<TimetableEntry>& other);
+    static timetable_hour_t duration_of(bool lectures);
 
     /**
-     * Similar to the above, but limits to neighbouring lectures (no gap).
+     * The hour after the last hour of the block.
      */
-    bool is_matching_lecture_strict(std::shared_ptr<TimetableEntry>& other);
+    inline int end_hour() const {
+        return this->hour + this->duration;
+    }
 
     /**
-     * Whether the two entries match each other as tutorials - they are the same double cycle.
-     * Does not return true when comparing with oneself.
+     * The number of hours both entries take place in, 0 if they don't overlap.
      */
-    bool is_matching_tutorial(std::shared_ptr<TimetableEntry>& other);
+    inline int overlapping_hours(const std::shared_ptr<TimetableEntry>& other) const {
+        if (this->day != other->day) {
+            return 0;
+        }
+        int overlap = std::min(this->end_hour(), other->end_hour()) - std::max((int) this->hour, (int) other->hour);
+        return overlap > 0 ? overlap : 0;
+    }
 
     void print();
 };
@@ -94,17 +112,39 @@ public:
     bool sorted;
 
     // timetable entries sorted by subject, then by time (efficiency, other sorting orders as needed)
+    // every subject has a lecture block and a tutorial block (double cycle) for each group of students
     std::vector<std::shared_ptr<TimetableEntry>> timetable_entries;
 
+    /**
+     * The occupancy grids of the entries, nullptr unless the timetable has been indexed (see index_occupancy).
+     * It isn't serialized, individuals that are received or loaded are indexed again when needed.
+     */
+    std::shared_ptr<OccupancyIndex> occupancy;
+
+    /**
+     * The fitness and local subject terms of the last evaluation, nullptr if the timetable hasn't been evaluated
+     * and isn't the offspring of an evaluated parent. It isn't serialized or cloned.
+     */
+    std::shared_ptr<FitnessTerms> fitness_terms;
+
     Timetable();
 
+    // allocations are counted for memory accounting
+    static void* operator new(std::size_t size);
+    static void operator delete(void* p, std::size_t size);
+
     /**
      * Clones this object and creates a new standalone instance. Deep copy.
-     * Actually only copies all timetable entries, no computed properties.
+     * Actually only copies all timetable entries and the occupancy index, no computed properties.
      * Only clones basic references, not the sorted ones.
      */
     std::shared_ptr<Timetable> clone();
 
+    /**
+     * Builds the occupancy index of the current entries, replacing any previous one.
+     */
+    void index_occupancy(const std::shared_ptr<const OccupancyLayout>& layout);
+
     /**
      * Sorts the timetable. Currently there is only one sorting order - the default.
      */
@@ -113,10 +153,18 @@ public:
     void print();
 
     /**
-     * Serialize the JSON object to a file.
+     * Serialize the JSON object to a file. Blocks are written as an entry for each hour, as the viewer expects.
      */
     void export_json(std::string file_path);
 
+    /**
+     * Deserialize a timetable from a JSON file in the format export_json writes.
+     * Consecutive hours of the same subject, type, classroom, students and professors are merged back into blocks
+     * of at most the type's duration (shorter blocks are left for repair).
+     * Returns nullptr if the file can't be read or parsed.
+     */
+    static std::shared_ptr<Timetable> import_json(std::string file_path);
+
     /**
      * Validates students in this timetable.
      * Used to figure out what is causing IDs to be brokd.
@@ -137,17 +185,59 @@ private:
     std::vector<import::Student> student_list;
     std::vector<import::Subject> subject_list;
 
+    // constructive generation precomputation
+    // the subject conflict graph: an edge exists between two subjects if they share at least one student
+    import::SubjectConflicts subject_conflicts;
+    std::map<timetable_professor_t, unsigned int> professor_available_hours;
+
     std::mt19937 rand;
     std::uniform_int_distribution<timetable_day_t> day_distribution;
     std::uniform_int_distribution<timetable_hour_t> contiguous_hour_distribution_lectures;
     std::uniform_int_distribution<timetable_hour_t> contiguous_hour_distribution_tutorials;
+
+    /**
+     * Appends a randomly placed three hour lecture block for the subject.
+     */
+    void generate_lectures(import::Subject& s, std::shared_ptr<Timetable>& timetable);
+
+    /**
+     * Appends randomly placed tutorial double cycles that cover the given (already shuffled) students of the subject.
+     */
+    void generate_tutorials(import::Subject& s, std::vector<timetable_student_t>& students, std::shared_ptr<Timetable>& timetable);
+
+    /**
+     * Moves a block (with its duration already set) into the day and hour grid: a block on a day outside the week
+     * is placed randomly, a block that starts too early or ends too late on a valid day is moved to the closest hours.
+     */
+    void place_in_grid(std::shared_ptr<TimetableEntry>& te, std::uniform_int_distribution<timetable_hour_t>& hour_distribution);
 public:
     TimetableGenerator(std::map<int, import::Professor>& professors,
                        std::map<int, import::Classroom>& classrooms,
                        std::map<int, import::Student>& students,
                        std::map<int, import::Subject>& subjects);
 
+    /**
+     * Generates a timetable with uniformly random placement.
+     */
     std::shared_ptr<Timetable> generate();
+
+    /**
+     * Generates a timetable with a randomized greedy placement over room x slot and professor x slot occupancy grids.
+     * Subjects are coloured in order of their conflict graph degree and each lecture or tutorial is placed into
+     * a random slot that violates no prohibitive constraint, preferring slots without lectures of conflicting subjects.
+     * If no such slot exists for an entry, it is placed randomly like in generate().
+     */
+    std::shared_ptr<Timetable> generate_constructive();
+
+    /**
+     * Remaps a previously generated timetable (possibly for different inputs) to the current inputs.
+     * Entries of removed subjects are dropped, students, professors, classrooms and TAs that are no longer valid
+     * are removed or replaced, blocks that are too short are extended, blocks outside the grid are moved into it
+     * and students that are not in any tutorial group are added to groups with free capacity or to new,
+     * randomly placed ones.
+     * Subjects that are missing from the previous timetable are generated randomly.
+     */
+    std::shared_ptr<Timetable> repair(std::shared_ptr<Timetable>& previous);
 };
 
 #endif //INCLUDE_TIMETABLE_H
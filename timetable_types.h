@@ -1,14 +1,75 @@
 #ifndef INCLUDE_TIMETABLETYPES_H
 #define INCLUDE_TIMETABLETYPES_H
 
+#include "memory.h"
+
+#include <functional>
+#include <set>
 #include <stdint.h>
 
+// select the wide configuration by setting this as a compiler option (see CMakeLists.txt)
+#ifndef TIMETABLE_WIDE_IDS
+#define TIMETABLE_WIDE_IDS 0
+#endif
+
+/**
+ * The compile-time configuration of the weekly slot grid and of the entity ID widths.
+ * Entries are stored with the narrowest types that fit the instance, which keeps them small and dense,
+ * so the ID widths should be chosen per instance size. Imports refuse IDs that do not fit instead of truncating them.
+ */
+template <int Days, int EarliestHour, int LatestHour,
+          typename SubjectId, typename ClassroomId, typename StudentId, typename ProfessorId>
+struct TimetableConfig {
+    // the grid: days of the week (0 is monday) and the allowed hours of each day (inclusive)
+    static const int days = Days;
+    static const int earliest_hour = EarliestHour;
+    static const int latest_hour = LatestHour;
+
+    // slots are indexed as day * slots_per_day + hour, so every hour of the day has a slot
+    static const int slots_per_day = 24;
+    static const int slots = Days * slots_per_day;
+
+    typedef uint8_t day_t;
+    typedef uint8_t hour_t;
+    typedef SubjectId subject_t;
+    typedef ClassroomId classroom_t;
+    typedef StudentId student_t;
+    typedef ProfessorId professor_t;
+};
+
+template <int D, int E, int L, typename Sub, typename C, typename Stu, typename P>
+const int TimetableConfig<D, E, L, Sub, C, Stu, P>::days;
+template <int D, int E, int L, typename Sub, typename C, typename Stu, typename P>
+const int TimetableConfig<D, E, L, Sub, C, Stu, P>::earliest_hour;
+template <int D, int E, int L, typename Sub, typename C, typename Stu, typename P>
+const int TimetableConfig<D, E, L, Sub, C, Stu, P>::latest_hour;
+template <int D, int E, int L, typename Sub, typename C, typename Stu, typename P>
+const int TimetableConfig<D, E, L, Sub, C, Stu, P>::slots_per_day;
+template <int D, int E, int L, typename Sub, typename C, typename Stu, typename P>
+const int TimetableConfig<D, E, L, Sub, C, Stu, P>::slots;
+
+// a faculty: up to 256 subjects, classrooms and professors and 65536 students
+typedef TimetableConfig<5, 7, 19, uint8_t, uint8_t, uint16_t, uint8_t> CompactTimetableConfig;
+
+// the whole university: up to 65536 subjects, classrooms and professors and 2^32 students
+typedef TimetableConfig<5, 7, 19, uint16_t, uint16_t, uint32_t, uint16_t> WideTimetableConfig;
+
+#if TIMETABLE_WIDE_IDS
+typedef WideTimetableConfig ActiveTimetableConfig;
+#else
+typedef CompactTimetableConfig ActiveTimetableConfig;
+#endif
+
 // define special types to conserve space
-typedef uint8_t timetable_day_t;
-typedef uint8_t timetable_hour_t;
-typedef uint8_t timetable_subject_t;
-typedef uint8_t timetable_classroom_t;
-typedef uint16_t timetable_student_t;
-typedef uint8_t timetable_professor_t;
+typedef ActiveTimetableConfig::day_t timetable_day_t;
+typedef ActiveTimetableConfig::hour_t timetable_hour_t;
+typedef ActiveTimetableConfig::subject_t timetable_subject_t;
+typedef ActiveTimetableConfig::classroom_t timetable_classroom_t;
+typedef ActiveTimetableConfig::student_t timetable_student_t;
+typedef ActiveTimetableConfig::professor_t timetable_professor_t;
+
+// the students of an entry make up most of an individual's memory, so their allocations are counted
+typedef std::set<timetable_student_t, std::less<timetable_student_t>,
+                 memory::CountingAllocator<timetable_student_t, memory::STUDENT_SETS>> timetable_student_set_t;
 
 #endif //INCLUDE_TIMETABLETYPES_H
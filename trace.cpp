@@ -0,0 +1,126 @@
+#include "json/json.hpp"
+#include "trace.h"
+
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+
+#define MPI_MASTER 0
+
+using json = nlohmann::json;
+
+static const int CLOCK_SAMPLES = 9;
+
+ClockOffset trace::estimate_clock_offset(const Communicator& world) {
+    int rank = world.rank();
+    int size = world.size();
+
+    // differences to the master's clock for every process and sample
+    std::vector<std::vector<long long>> differences((unsigned long) size);
+    long long middle_sample = 0;
+
+    std::vector<long long> samples;
+    for (int i = 0; i < CLOCK_SAMPLES; i++) {
+        world.barrier();
+        long long now = PerformanceBenchmark::to_nanoseconds(hirez_clock_t::now());
+        if (i == CLOCK_SAMPLES / 2) {
+            middle_sample = now;
+        }
+
+        comm::gather(world, now, samples, MPI_MASTER);
+        if (rank == MPI_MASTER) {
+            for (int process = 0; process < size; process++) {
+                differences[process].push_back(samples[MPI_MASTER] - samples[process]);
+            }
+        }
+    }
+
+    std::vector<long long> offsets;
+    if (rank == MPI_MASTER) {
+        for (auto& d : differences) {
+            std::sort(d.begin(), d.end());
+            offsets.push_back(d[d.size() / 2]);
+        }
+    }
+    comm::broadcast(world, offsets, MPI_MASTER);
+
+    ClockOffset result;
+    result.local_time = middle_sample;
+    result.offset = offsets[rank];
+    return result;
+}
+
+/**
+ * Converts a time of a process' clock to the master's clock.
+ */
+static long long correct_time(long long time, const ClockOffset& start, const ClockOffset& end) {
+    if (end.local_time == start.local_time) {
+        return time + start.offset;
+    }
+
+    double progress = 1.0 * (time - start.local_time) / (end.local_time - start.local_time);
+    return time + start.offset + (long long) (progress * (end.offset - start.offset));
+}
+
+void trace::export_trace(const Communicator& world, PerformanceBenchmark& bench,
+                         const ClockOffset& start_offset, const ClockOffset& end_offset, const std::string& file_path) {
+    // correct the times before sending, so the master only has to merge them
+    std::vector<TraceEvent> events = bench.get_trace_events();
+    for (TraceEvent& event : events) {
+        event.start = correct_time(event.start, start_offset, end_offset);
+        event.end = correct_time(event.end, start_offset, end_offset);
+    }
+
+    std::vector<std::vector<TraceEvent>> process_events;
+    comm::gather(world, events, process_events, MPI_MASTER);
+
+    if (world.rank() != MPI_MASTER) {
+        return;
+    }
+
+    // the timeline starts with the earliest event
+    long long origin = 0;
+    bool first = true;
+    for (auto& pe : process_events) {
+        for (TraceEvent& event : pe) {
+            if (first || event.start < origin) {
+                origin = event.start;
+                first = false;
+            }
+        }
+    }
+
+    json trace_events = json::array();
+    for (size_t process = 0; process < process_events.size(); process++) {
+        json name;
+        name["name"] = "thread_name";
+        name["ph"] = "M";
+        name["pid"] = 0;
+        name["tid"] = process;
+        name["args"]["name"] = "Process " + std::to_string(process);
+        trace_events.push_back(name);
+
+        for (TraceEvent& event : process_events[process]) {
+            // complete events, with times in microseconds
+            json e;
+            e["name"] = PerformanceBenchmark::probe_name(event.probe);
+            e["ph"] = "X";
+            e["pid"] = 0;
+            e["tid"] = process;
+            e["ts"] = (event.start - origin) / 1000.0;
+            e["dur"] = (event.end - event.start) / 1000.0;
+            trace_events.push_back(e);
+        }
+    }
+
+    json trace;
+    trace["traceEvents"] = trace_events;
+    trace["displayTimeUnit"] = "ms";
+
+    std::ofstream out(file_path);
+    if (!out.is_open()) {
+        std::cerr << "Could not write the trace to " << file_path << ". " << std::endl;
+        return;
+    }
+    out << trace.dump() << std::endl;
+}
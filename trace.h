@@ -0,0 +1,41 @@
+#ifndef INCLUDE_TRACE_H
+#define INCLUDE_TRACE_H
+
+#include "communicator.h"
+#include "performance.h"
+
+#include <string>
+
+/**
+ * The offset of a process' clock to the master's clock, measured at a point in time of the process' clock.
+ * Both are in nanoseconds.
+ */
+struct ClockOffset {
+    long long local_time;
+    long long offset;
+};
+
+/**
+ * Exports the trace events of all processes as a single timeline in the Chrome trace-event format,
+ * which can be opened with Perfetto or chrome://tracing. Every process is shown as a row.
+ *
+ * The clocks of processes on different machines are unrelated, so their offsets to the master's clock are measured
+ * at the start and at the end of the run and interpolated between, which also corrects a linear drift.
+ */
+namespace trace {
+    /**
+     * Estimates the offset of the calling process' clock to the master's. Must be called by all processes.
+     * The clocks are sampled right after several barriers and the median difference is used,
+     * so the offset is precise to about the time it takes a barrier to release all processes.
+     */
+    ClockOffset estimate_clock_offset(const Communicator& world);
+
+    /**
+     * Gathers the trace events of all processes to the master, which writes them to the file.
+     * Must be called by all processes.
+     */
+    void export_trace(const Communicator& world, PerformanceBenchmark& bench,
+                      const ClockOffset& start_offset, const ClockOffset& end_offset, const std::string& file_path);
+}
+
+#endif //INCLUDE_TRACE_H
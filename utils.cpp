@@ -1,10 +1,20 @@
 #include "utils.h"
 
+#include <algorithm>
+#include <iostream>
 #include <iomanip>
 #include <chrono>
 
 int utils::PopulationStatistics::global_index = 0;
 
+// thread local so every thread of the threads-only build has its own
+static thread_local int process_rank = 0;
+
+// a fixed seed makes runs repeatable, every call derives a different seed from it (0 if seeded by the clock)
+// per thread like the rank, as every thread of the threads-only build sets it
+static thread_local unsigned int fixed_seed = 0;
+static thread_local unsigned int seeds_taken = 0;
+
 double utils::PopulationStatistics::kahan_sum(std::vector<FitnessPair>& values) {
     double sum = 0;
     double c = 0;
@@ -24,16 +34,44 @@ utils::PopulationStatistics utils::PopulationStatistics::compute(std::vector<Fit
     utils::PopulationStatistics::global_index++;
     utils::PopulationStatistics result = utils::PopulationStatistics();
 
+    result.feasible = 0;
+    result.incomplete = 0;
+    for (FitnessPair& fp : fitnesses) {
+        if (fp.hard_violations == 0) {
+            result.feasible++;
+        }
+        if (!fp.is_complete()) {
+            result.incomplete++;
+        }
+    }
+
+    // the scalar fitness of an incomplete evaluation lacks the soft constraints, it only counts in the number above
+    // (there is always a complete one with early exits, the best individual of each process is evaluated completely)
+    std::vector<FitnessPair> complete;
+    for (FitnessPair& fp : fitnesses) {
+        if (fp.is_complete()) {
+            complete.push_back(fp);
+        }
+    }
+    if (complete.empty()) {
+        complete = fitnesses;
+    }
+
     // median and quartile calculation depends on the data being sorted
-    std::sort(fitnesses.begin(), fitnesses.end(), [](FitnessPair& a, FitnessPair&b) { return a.fitness < b.fitness; });
+    std::sort(complete.begin(), complete.end(), [](FitnessPair& a, FitnessPair&b) { return a.fitness < b.fitness; });
 
-    unsigned int num_elements = (unsigned int) fitnesses.size();
-    result.min = fitnesses.front().fitness;
-    result.max = fitnesses.back().fitness;
-    result.mean = kahan_sum(fitnesses) / num_elements;
-    result.median = num_elements % 2 == 0 ? ((fitnesses[num_elements / 2].fitness + fitnesses[num_elements / 2 + 1].fitness) / 2.0) : (fitnesses[num_elements / 2].fitness);
-    result.lower_quartile = fitnesses[num_elements / 4].fitness;
-    result.upper_quartile = fitnesses[(3 * num_elements) / 4].fitness;
+    unsigned int num_elements = (unsigned int) complete.size();
+    result.min = complete.front().fitness;
+    result.max = complete.back().fitness;
+    result.mean = kahan_sum(complete) / num_elements;
+    result.median = num_elements % 2 == 0 ? ((complete[num_elements / 2 - 1].fitness + complete[num_elements / 2].fitness) / 2.0) : (complete[num_elements / 2].fitness);
+    result.lower_quartile = complete[num_elements / 4].fitness;
+    result.upper_quartile = complete[(3 * num_elements) / 4].fitness;
+
+    // the scalar fitness above weighs the tiers, the best individual is the lexicographic one
+    FitnessPair& best = *std::min_element(fitnesses.begin(), fitnesses.end(), FitnessPair::compare_fitness);
+    result.best_hard_violations = best.hard_violations;
+    result.best_soft_fitness = best.soft_fitness;
 
     return result;
 }
@@ -47,11 +85,14 @@ void utils::PopulationStatistics::print() {
     std::cout << "\t" << "median" << ": "  << this->median << std::endl;
     std::cout << "\t" << "lower quartile" << ": "  << this->lower_quartile << std::endl;
     std::cout << "\t" << "upper quartile" << ": "  << this->upper_quartile << std::endl;
+    std::cout << "\t" << "best hard violations" << ": "  << this->best_hard_violations << std::endl;
+    std::cout << "\t" << "best soft fitness" << ": "  << this->best_soft_fitness << std::endl;
+    std::cout << "\t" << "incomplete" << ": "  << this->incomplete << std::endl;
 
     std::cout << std::flush;
 }
 
-int utils::count_overlaps(std::set<timetable_student_t> v1, std::set<timetable_student_t> v2) {
+int utils::count_overlaps(const timetable_student_set_t& v1, const timetable_student_set_t& v2) {
     int count = 0;
     for (auto i1 = v1.begin(); i1 != v1.end(); i1++) {
         for (auto i2 = v2.begin(); i2 != v2.end(); i2++) {
@@ -64,7 +105,7 @@ int utils::count_overlaps(std::set<timetable_student_t> v1, std::set<timetable_s
     return count;
 }
 
-int utils::count_overlaps(std::set<timetable_professor_t> v1, std::set<timetable_professor_t> v2) {
+int utils::count_overlaps(const std::set<timetable_professor_t>& v1, const std::set<timetable_professor_t>& v2) {
     int count = 0;
     for (auto i1 = v1.begin(); i1 != v1.end(); i1++) {
         for (auto i2 = v2.begin(); i2 != v2.end(); i2++) {
@@ -95,8 +136,17 @@ int utils::get_packed_slot_time(timetable_day_t day, timetable_hour_t hour, time
     return (day * (latest_hour - earliest_hour)) + (hour - earliest_hour);
 }
 
+void utils::set_process_rank(int rank) {
+    process_rank = rank;
+}
+
+void utils::set_random_seed(unsigned int seed) {
+    fixed_seed = seed;
+}
+
 unsigned int utils::get_random_seed() {
-    int rank;
-    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
-    return (unsigned int) (std::chrono::high_resolution_clock::now().time_since_epoch().count() + (rank * 42));
+    if (fixed_seed != 0) {
+        return fixed_seed + (process_rank * 42) + (seeds_taken++ * 7919);
+    }
+    return (unsigned int) (std::chrono::high_resolution_clock::now().time_since_epoch().count() + (process_rank * 42));
 }
@@ -29,6 +29,12 @@ namespace utils {
         double median;
         double lower_quartile;
         double upper_quartile;
+        int feasible;       // the individuals without prohibitive (hard) violations
+
+        // the two tiers of the best individual (see FitnessPair::compare_fitness)
+        int best_hard_violations;
+        double best_soft_fitness;
+        int incomplete;     // the individuals whose evaluation stopped after the hard constraints
 
         /**
          * Compute and return an object of statistics from a list of fitnesses.
@@ -38,8 +44,8 @@ namespace utils {
         void print();
     };
 
-    int count_overlaps(std::set<timetable_student_t> v1, std::set<timetable_student_t> v2);
-    int count_overlaps(std::set<timetable_professor_t> v1, std::set<timetable_professor_t> v2);
+    int count_overlaps(const timetable_student_set_t& v1, const timetable_student_set_t& v2);
+    int count_overlaps(const std::set<timetable_professor_t>& v1, const std::set<timetable_professor_t>& v2);
 
     /**
      * A template function that converts map values to a vector.
@@ -63,6 +69,17 @@ namespace utils {
      */
     int get_packed_slot_time(timetable_day_t day, timetable_hour_t hour, timetable_hour_t earliest_hour, timetable_hour_t latest_hour);
 
+    /**
+     * Sets the rank of the calling process (or thread in the threads-only build), used to differentiate random seeds.
+     */
+    void set_process_rank(int rank);
+
+    /**
+     * Fixes the seed the random seeds of the calling thread are derived from, so runs with the same number of processes are repeatable.
+     * Must be set before any random engine is created. 0 restores seeding by the clock.
+     */
+    void set_random_seed(unsigned int seed);
+
     unsigned int get_random_seed();
 }
 